@@ -18,6 +18,8 @@ const size_t imu_packet_bytes = 48;
 
 struct client;
 
+struct poller;
+
 enum client_state {
     TIMEOUT = 0,
     ERROR = 1,
@@ -60,6 +62,35 @@ inline bool operator<=(const version& u, const version& v) {
     return u < v || u == v;
 }
 
+enum timestamp_mode {
+    TIMESTAMP_NONE = 0,
+    TIMESTAMP_SOFTWARE,
+    TIMESTAMP_HARDWARE
+};
+
+/**
+ * Backend of the event loop created by init_poller
+ */
+enum poller_mode { POLLER_AUTO = 0, POLLER_EPOLL, POLLER_IO_URING };
+
+/**
+ * Tuning options for the udp data sockets and the thread reading them. Values
+ * of zero (or -1 for recv_cpu) keep the system defaults
+ */
+struct client_options {
+    // kernel receive buffer size (SO_RCVBUF) in bytes
+    int rcvbuf_bytes = 0;
+    // busy-poll the device queue for up to this long on reads (SO_BUSY_POLL)
+    int busy_poll_us = 0;
+    // source of the receive timestamps reported by read_lidar_packets.
+    // Hardware timestamps also need to be enabled on the network interface
+    timestamp_mode timestamps = TIMESTAMP_SOFTWARE;
+    // cpu to which pin_receive_thread pins the receiving thread
+    int recv_cpu = -1;
+    // SCHED_FIFO priority pin_receive_thread gives the receiving thread
+    int recv_priority = 0;
+};
+
 struct sensor_info {
     std::string hostname;
     std::string sn;
@@ -110,9 +141,12 @@ int n_cols_of_lidar_mode(lidar_mode mode);
  * Listen for OS1 data on the specified ports
  * @param lidar_port port on which the sensor will send lidar data
  * @param imu_port port on which the sensor will send imu data
+ * @param opts socket tuning options
  * @return pointer owning the resources associated with the connection
  */
-std::shared_ptr<client> init_client(int lidar_port = 7502, int imu_port = 7503);
+std::shared_ptr<client> init_client(
+    int lidar_port = 7502, int imu_port = 7503,
+    const client_options& opts = client_options{});
 
 /**
  * Connect to and configure the sensor and start listening for data
@@ -120,12 +154,54 @@ std::shared_ptr<client> init_client(int lidar_port = 7502, int imu_port = 7503);
  * @param udp_dest_host hostname or ip where the sensor should send data
  * @param lidar_port port on which the sensor will send lidar data
  * @param imu_port port on which the sensor will send imu data
+ * @param opts socket tuning options
  * @return pointer owning the resources associated with the connection
  */
-std::shared_ptr<client> init_client(const std::string& hostname,
-                                    const std::string& udp_dest_host,
-                                    lidar_mode mode = MODE_1024x10,
-                                    int lidar_port = 7502, int imu_port = 7503);
+std::shared_ptr<client> init_client(
+    const std::string& hostname, const std::string& udp_dest_host,
+    lidar_mode mode = MODE_1024x10, int lidar_port = 7502, int imu_port = 7503,
+    const client_options& opts = client_options{});
+
+/**
+ * Connect to the sensor and start listening for data like init_client, but
+ * only set config parameters and reinitialize the sensor when its active
+ * configuration differs from the requested one. Commands are sent together in
+ * two round trips over one connection, and intrinsics are taken from cached
+ * metadata when it has the serial number and firmware revision of the sensor
+ * @param hostname hostname or ip of the sensor
+ * @param udp_dest_host hostname or ip where the sensor should send data; a
+ * hostname is resolved to its ipv4 address before comparing it with the
+ * active udp_ip
+ * @param cached_metadata text blob returned by get_metadata on a previous
+ * connection, usually saved to a file, or empty
+ * @param mode lidar mode the sensor should be configured with
+ * @param lidar_port port on which the sensor will send lidar data
+ * @param imu_port port on which the sensor will send imu data
+ * @param opts socket tuning options
+ * @return pointer owning the resources associated with the connection
+ */
+std::shared_ptr<client> init_client_fast(
+    const std::string& hostname, const std::string& udp_dest_host,
+    const std::string& cached_metadata, lidar_mode mode = MODE_1024x10,
+    int lidar_port = 7502, int imu_port = 7503,
+    const client_options& opts = client_options{});
+
+/**
+ * Pin the calling thread to the cpu given by client_options::recv_cpu and
+ * give it the SCHED_FIFO priority client_options::recv_priority. Call from the
+ * thread that will poll and read from the client.
+ * @param cli client returned by init_client associated with the connection
+ * @return false if pinning or setting the priority was requested but failed
+ */
+bool pin_receive_thread(const client& cli);
+
+/**
+ * Get the number of packets dropped by the kernel because the socket receive
+ * buffers were full (SO_RXQ_OVFL). Updated as packets are read.
+ * @param cli client returned by init_client associated with the connection
+ * @return total packets dropped on the lidar and imu sockets
+ */
+uint64_t get_dropped_packets(const client& cli);
 
 /**
  * Block for up to timeout_sec until either data is ready or an error occurs.
@@ -137,6 +213,56 @@ std::shared_ptr<client> init_client(const std::string& hostname,
  */
 client_state poll_client(const client& cli, int timeout_sec = 1);
 
+/**
+ * Create an edge-triggered event loop that waits on any number of clients from
+ * a single thread.
+ *
+ * With io_uring, every data socket of a registered client keeps a multishot
+ * receive into a ring of buffers registered with the kernel, so datagrams are
+ * received as they arrive and read_lidar_packets and read_imu_packet copy them
+ * out of the completed buffers without a system call. poll_clients only enters
+ * the kernel when no completion is pending. The client must then only be read
+ * from the thread calling poll_clients, and not waited on with poll_client.
+ * @param mode POLLER_AUTO uses io_uring if the kernel supports it (linux 6.0
+ * or later, not disabled by the kernel.io_uring_disabled sysctl or seccomp)
+ * and epoll otherwise; POLLER_IO_URING fails rather than fall back
+ * @return pointer owning the resources associated with the event loop, or null
+ * on error
+ */
+std::shared_ptr<poller> init_poller(poller_mode mode = POLLER_AUTO);
+
+/**
+ * Get the backend an event loop uses
+ * @param p poller returned by init_poller
+ * @return POLLER_EPOLL or POLLER_IO_URING
+ */
+poller_mode get_poller_mode(const poller& p);
+
+/**
+ * Register a client with an event loop. The client must outlive the poller,
+ * and can only be registered with one io_uring poller at a time
+ * @param p poller returned by init_poller
+ * @param cli client returned by init_client associated with the connection
+ * @return index of the client in the states reported by poll_clients, or -1 on
+ * error
+ */
+int add_client(poller& p, const client& cli);
+
+/**
+ * Block for up to timeout_ms until data is ready on any registered client or
+ * an error occurs. Readiness is edge-triggered: a client is only reported
+ * again once new data arrives, so every client reported with LIDAR_DATA or
+ * IMU_DATA must be drained: call read_lidar_packets until it receives fewer
+ * datagrams than requested, and read_imu_packet until it returns false.
+ * @param p poller returned by init_poller
+ * @param states resized to the number of registered clients and populated with
+ * the state of each, in order of registration
+ * @param timeout_ms milliseconds to block while waiting for data
+ * @return bitwise or of all states, EXIT if interrupted by a signal, or ERROR
+ */
+client_state poll_clients(poller& p, std::vector<client_state>& states,
+                          int timeout_ms = 100);
+
 /**
  * Read lidar data from the sensor. Will not block.
  * @param cli client returned by init_client associated with the connection
@@ -146,14 +272,40 @@ client_state poll_client(const client& cli, int timeout_sec = 1);
  */
 bool read_lidar_packet(const client& cli, uint8_t* buf);
 
+/**
+ * Read all available lidar packets, up to max_n, with a single system call,
+ * or none once the client is registered with an io_uring poller. Will not
+ * block. Use after poll_client or poll_clients reports LIDAR_DATA to drain
+ * the socket on one wakeup.
+ * @param cli client returned by init_client associated with the connection
+ * @param bufs buffer of max_n consecutive slots of lidar_packet_bytes each to
+ * which to write lidar data. Packets are written to the first slots in the
+ * order they were received
+ * @param max_n maximum number of packets to read
+ * @param ts_ns optional array of at least max_n entries to which to write the
+ * kernel receive timestamp of each packet (ns since the epoch), or 0 when the
+ * kernel did not provide one
+ * @param n_received optional, set to the number of datagrams taken from the
+ * socket including malformed ones, which are counted and skipped. Fewer than
+ * max_n means the socket is drained; 0 if no data was available or on error
+ * @return the number of valid packets read, which may be 0 even though data
+ * was available if every datagram was malformed
+ */
+size_t read_lidar_packets(const client& cli, uint8_t* bufs, size_t max_n,
+                          uint64_t* ts_ns = nullptr,
+                          size_t* n_received = nullptr);
+
 /**
  * Read imu data from the sensor. Will not block.
  * @param cli client returned by init_client associated with the connection
  * @param buf buffer to which to write imu data. Must be at least
  * imu_packet_bytes + 1 bytes
+ * @param ts_ns optional, set to the kernel receive timestamp of the packet
+ * like those of read_lidar_packets, or 0 when the kernel did not provide one
  * @return true if an imu packet was successfully read
  */
-bool read_imu_packet(const client& cli, uint8_t* buf);
+bool read_imu_packet(const client& cli, uint8_t* buf,
+                     uint64_t* ts_ns = nullptr);
 
 /**
  * Get metadata text blob from the sensor
@@ -0,0 +1,79 @@
+/**
+ * @file
+ * @brief Reordering of lidar packets into whole frames
+ *
+ * batch_to_iter expects packets in order: a packet arriving after a later one
+ * of the same frame is written in place after its columns were counted as
+ * missing, and a packet arriving after the next frame started is dropped. A
+ * frame assembler sits in front of a batcher and passes it packets in order
+ * of frame and measurement id. Packets arriving in order are passed on
+ * immediately without a copy; packets following a gap are copied and held,
+ * for at most a latency budget, until the gap is filled. Packets of at most
+ * two frames are held, so a packet of the frame after next closes both. Only
+ * packets of the frame before are dropped as late; a packet of any other
+ * frame, e.g. once frame ids restart, closes both frames and starts over.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace ouster {
+namespace OS1 {
+
+/**
+ * Completeness of a frame, reported when the assembler closes it
+ */
+struct frame_stats {
+    uint16_t frame_id;
+    uint64_t scan_ts;       // timestamp of the first column passed on, or 0
+    int n_cols;             // columns per frame
+    int cols_received;      // valid columns passed on
+    int reordered_packets;  // passed on after a later packet had arrived
+    // packets dropped since the previous frame was closed because they
+    // arrived after the assembler stopped waiting for them, or were received
+    // twice
+    int late_packets;
+    int duplicate_packets;
+    std::vector<uint8_t> received;  // n_cols flags, nonzero if received
+};
+
+struct frame_assembler;
+
+/**
+ * Create a frame assembler. Storage for two frames of packets is allocated up
+ * front.
+ * @param W number of columns in a frame. One of 512, 1024, or 2048.
+ * @param max_wait_ns longest a packet is held waiting for earlier ones, in ns
+ * of sensor time measured by the column timestamps of the packets received
+ * since; 0 never holds packets, passing them on in order of arrival and
+ * dropping any that arrive after a later packet
+ * @param p called with each packet in order, valid until p returns
+ * @param f called with the stats of each frame, after its last packet was
+ * passed to p and before the first packet of the next frame; the stats are
+ * only valid until f returns
+ * @return pointer owning the assembler state
+ */
+std::shared_ptr<frame_assembler> init_frame_assembler(
+    int W, uint64_t max_wait_ns, std::function<void(const uint8_t*)> p,
+    std::function<void(const frame_stats&)> f);
+
+/**
+ * Add a lidar packet, passing it and any held packets it completes to the
+ * packet callback of the assembler
+ * @param a assembler returned by init_frame_assembler
+ * @param buf lidar packet of lidar_packet_bytes bytes
+ */
+void add_lidar_packet(frame_assembler& a, const uint8_t* buf);
+
+/**
+ * Stop waiting for missing packets: pass on every held packet and close the
+ * frames they belong to, e.g. at the end of a recording
+ * @param a assembler returned by init_frame_assembler
+ */
+void flush_frames(frame_assembler& a);
+}
+}
@@ -0,0 +1,138 @@
+/**
+ * @file
+ * @brief Recording and indexed replay of raw sensor packets
+ *
+ * A capture file starts with a header holding the sensor metadata returned by
+ * get_metadata, followed by lidar and imu packets in the order they were
+ * received, each with its receive timestamp. Files are written in native byte
+ * order and are read back through a read-only memory mapping, so replayed
+ * packets are never copied.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ouster {
+namespace OS1 {
+
+struct capture_writer;
+struct capture_reader;
+
+enum packet_type { LIDAR_PACKET = 1, IMU_PACKET = 2 };
+
+/**
+ * A packet stored in a capture. buf points into the memory mapping and stays
+ * valid as long as the reader it came from
+ */
+struct capture_packet {
+    packet_type type;
+    uint64_t ts;
+    const uint8_t* buf;
+};
+
+/**
+ * Index entry of a frame (revolution) in a capture. Lidar packets of a frame
+ * and the imu packets received with them are consecutive in the capture. A
+ * frame starts at the first packet whose first valid column has a new frame
+ * id; late packets of the previous frame are kept with the current one
+ */
+struct capture_frame {
+    uint16_t frame_id;    // col_frame_id of the frame
+    uint64_t ts;          // col_timestamp of the first valid column
+    size_t first_packet;  // index of the first packet of the frame
+    size_t n_packets;     // number of lidar and imu packets in the frame
+};
+
+/**
+ * Create a capture file, replacing any existing file
+ * @param path the file to write
+ * @param metadata sensor metadata returned by get_metadata
+ * @return pointer owning the file, or null on error
+ */
+std::shared_ptr<capture_writer> open_capture_writer(
+    const std::string& path, const std::string& metadata);
+
+/**
+ * Append a lidar packet to a capture
+ * @param w writer returned by open_capture_writer
+ * @param buf buffer of lidar_packet_bytes
+ * @param ts receive timestamp in ns, or 0 to use the current time
+ * @return true if the packet was written
+ */
+bool write_lidar_packet(capture_writer& w, const uint8_t* buf,
+                        uint64_t ts = 0);
+
+/**
+ * Append an imu packet to a capture
+ * @param w writer returned by open_capture_writer
+ * @param buf buffer of imu_packet_bytes
+ * @param ts receive timestamp in ns, or 0 to use the current time
+ * @return true if the packet was written
+ */
+bool write_imu_packet(capture_writer& w, const uint8_t* buf, uint64_t ts = 0);
+
+/**
+ * Map a capture file and index its packets and frames. A truncated last
+ * packet, e.g. from an interrupted recording, is ignored
+ * @param path the file to read
+ * @return pointer owning the mapping, or null on error
+ */
+std::shared_ptr<capture_reader> open_capture(const std::string& path);
+
+/**
+ * Get the sensor metadata stored in a capture
+ * @param r reader returned by open_capture
+ * @return metadata to use with parse_metadata
+ */
+const std::string& capture_metadata(const capture_reader& r);
+
+/**
+ * Get the number of packets in a capture
+ * @param r reader returned by open_capture
+ */
+size_t capture_size(const capture_reader& r);
+
+/**
+ * Get a packet of a capture
+ * @param r reader returned by open_capture
+ * @param i index of the packet, less than capture_size
+ * @return the packet, pointing into the mapped file
+ */
+capture_packet capture_packet_at(const capture_reader& r, size_t i);
+
+/**
+ * Get the frame index of a capture, in file order
+ * @param r reader returned by open_capture
+ */
+const std::vector<capture_frame>& capture_frames(const capture_reader& r);
+
+/**
+ * Find the first frame starting at or after a sensor timestamp, in file order.
+ * Takes logarithmic time, or linear time if frame timestamps jump back in the
+ * capture, e.g. because the sensor was restarted while recording
+ * @param r reader returned by open_capture
+ * @param ts timestamp in ns to seek to, comparable to col_timestamp
+ * @return index into capture_frames, or its size if there is no such frame
+ */
+size_t find_frame(const capture_reader& r, uint64_t ts);
+
+/**
+ * Replay a range of packets of a capture, paced by their receive timestamps
+ * @param r reader returned by open_capture
+ * @param first index of the first packet to replay
+ * @param last index past the last packet to replay
+ * @param rate replay speed relative to real time, or 0 for as fast as possible
+ * @param f callback invoked with each packet; return false to stop replaying
+ * @return the number of packets replayed
+ */
+size_t replay_capture(const capture_reader& r, size_t first, size_t last,
+                      double rate,
+                      const std::function<bool(const capture_packet&)>& f);
+}
+}
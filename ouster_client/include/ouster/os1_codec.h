@@ -0,0 +1,85 @@
+/**
+ * @file
+ * @brief Lossless compression of scans for transport to remote consumers
+ *
+ * Cartesian coordinates can be recomputed from ranges with the lookup table of
+ * the sensor, so only the channels of a scan are encoded: ranges at their
+ * native 20 bits and optionally signal, reflectivity and noise. Each channel
+ * is destaggered so that consecutive pixels of a row are neighbors in azimuth,
+ * delta coded along rows, split into byte planes and compressed with deflate.
+ *
+ * An encoded scan starts with a little-endian header:
+ *   bytes 0-3: magic "OS1Z"
+ *   byte 4: format version
+ *   byte 5: codec_channel flags of the encoded channels
+ *   bytes 6-9: W and H, 16 bits each
+ *   bytes 10-17: timestamp of the first column of the scan
+ *   bytes 18-21: size of the payload before compression
+ *   bytes 22-29: earliest column timestamp, which column timestamps in the
+ *     payload are relative to
+ * followed by the deflated payload.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ouster/os1_util.h"
+
+namespace ouster {
+namespace OS1 {
+
+/**
+ * Channels encoded in addition to ranges and column data
+ */
+enum codec_channel : uint8_t {
+    CODEC_SIGNAL = 1,
+    CODEC_REFLECTIVITY = 2,
+    CODEC_NOISE = 4,
+    CODEC_ALL = 7
+};
+
+struct scan_codec;
+
+/**
+ * Create an encoder and decoder for scans of the given dimensions. All scratch
+ * storage is allocated up front.
+ * @param W number of columns of a scan: 512, 1024 or 2048
+ * @param H number of pixels per column, at most pixels_per_column
+ * @param channels combination of codec_channel flags to encode
+ * @param level deflate compression level from 1 (fastest) to 9 (smallest)
+ * @return pointer owning the codec state, or an empty pointer on failure
+ */
+std::shared_ptr<scan_codec> init_codec(int W, int H, uint8_t channels,
+                                       int level);
+
+/**
+ * Encode a scan batched by batch_to_channels
+ * @param c codec returned by init_codec for scans of the same dimensions
+ * @param scan the scan to encode
+ * @param scan_ts timestamp of the first column of the scan
+ * @param buf receives the encoded scan, reusing its storage
+ * @return true if the scan was encoded, false if its dimensions differ from
+ * the codec or its column timestamps span 2^32 - 1 ns or more
+ */
+bool encode_scan(scan_codec& c, const scan_channels& scan, uint64_t scan_ts,
+                 std::vector<uint8_t>& buf);
+
+/**
+ * Decode a scan encoded by encode_scan. Channels that were not encoded are
+ * zero, as are missing pixels and columns
+ * @param c codec returned by init_codec for scans of the same dimensions
+ * @param buf the encoded scan
+ * @param size size of the encoded scan in bytes
+ * @param scan receives the channels of the scan
+ * @param scan_ts receives the timestamp of the first column of the scan
+ * @return true if the scan was decoded, false if it is malformed or its
+ * dimensions differ from the codec
+ */
+bool decode_scan(scan_codec& c, const uint8_t* buf, size_t size,
+                 scan_channels& scan, uint64_t& scan_ts);
+}
+}
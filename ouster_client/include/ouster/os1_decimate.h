@@ -0,0 +1,97 @@
+/**
+ * @file
+ * @brief Reduce the points of a scan as its columns are decoded
+ *
+ * A decimator builds a reduced copy of a scan from the decoded columns passed
+ * to the column function of batch_to_iter, while they are still in cache.
+ * Columns and rings are first selected by a column stride and a ring subset.
+ * The selected pixels are then optionally reduced, either to the nearest or
+ * farthest return of each k x k block of the range image, or to the centroid of
+ * the points in each cell of a voxel grid kept in a preallocated hash table.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ouster/os1_decode.h"
+
+namespace ouster {
+namespace OS1 {
+
+enum decimate_reduction {
+    REDUCE_NONE = 0,
+    REDUCE_BLOCK_MIN = 1,
+    REDUCE_BLOCK_MAX = 2,
+    REDUCE_VOXEL = 3
+};
+
+/**
+ * Parameters of a decimator
+ */
+struct decimate_config {
+    int col_stride;                // keep every col_stride-th column
+    std::vector<int> rings;        // rings to keep in order; all if empty
+    decimate_reduction reduction;  // how to reduce the selected pixels
+    int block;                     // block size k of REDUCE_BLOCK_*
+    float voxel_size;              // voxel edge length in m of REDUCE_VOXEL
+    size_t max_voxels;             // capacity of the voxel hash table
+};
+
+/**
+ * Points of a reduced scan, in the same column-major order as a scan. With
+ * REDUCE_VOXEL the scan is unorganized: W is the number of occupied voxels
+ * and H is 1. Missing pixels are zero. Only the first W * H values of each
+ * plane are valid.
+ */
+struct decimated_scan {
+    int W;
+    int H;
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<uint16_t> signal;
+    std::vector<uint32_t> t;  // ns since the start of the scan
+    std::vector<uint16_t> reflectivity;
+    std::vector<uint8_t> ring;
+    std::vector<uint16_t> noise;
+    std::vector<uint32_t> range;
+    size_t dropped;  // returns not stored because the voxel table was full
+};
+
+struct decimator;
+
+/**
+ * Create a decimator for scans of the given dimensions. All storage is
+ * allocated up front.
+ * @param W number of columns of a scan
+ * @param H number of pixels per column
+ * @param config decimation parameters
+ * @return pointer owning the decimator state, or an empty pointer if the
+ * parameters are invalid
+ */
+std::shared_ptr<decimator> init_decimator(int W, int H,
+                                          const decimate_config& config);
+
+/**
+ * Add a decoded column to the reduced scan
+ * @param d decimator returned by init_decimator
+ * @param scan_ts timestamp of the first column of the scan
+ * @param ts timestamp of the column
+ * @param m_id measurement id of the column
+ * @param px decoded column with xyz in m
+ */
+void decimate_column(decimator& d, uint64_t scan_ts, uint64_t ts, int m_id,
+                     const px_column& px);
+
+/**
+ * Complete the reduced scan. Columns added afterwards start the next scan
+ * @param d decimator returned by init_decimator
+ * @return the reduced scan, valid until the next column is added
+ */
+const decimated_scan& finish_decimated(decimator& d);
+}
+}
@@ -0,0 +1,99 @@
+/**
+ * @file
+ * @brief Vectorized decoding of lidar packet columns
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "ouster/os1_packet.h"
+
+namespace ouster {
+namespace OS1 {
+
+/**
+ * Destination of decoded pixels, one plane per channel. Each non-null plane
+ * receives pixels_per_column values in pixel order. Set any plane to null to
+ * skip decoding it; xyz are only computed if x, y and z are all set.
+ */
+struct px_planes {
+    float* x;
+    float* y;
+    float* z;
+    uint32_t* range;
+    uint16_t* signal;
+    uint16_t* reflectivity;
+    uint16_t* noise;
+};
+
+/**
+ * Storage for the channels of a single decoded column
+ */
+struct px_column {
+    float x[pixels_per_column];
+    float y[pixels_per_column];
+    float z[pixels_per_column];
+    uint32_t range[pixels_per_column];
+    uint16_t signal[pixels_per_column];
+    uint16_t reflectivity[pixels_per_column];
+    uint16_t noise[pixels_per_column];
+
+    px_planes planes() {
+        return {x, y, z, range, signal, reflectivity, noise};
+    }
+};
+
+/**
+ * Decode all pixels of a lidar packet column, using AVX2 or NEON when the cpu
+ * supports it. Results are identical to decode_column_scalar.
+ *
+ * Cartesian coordinates are computed as range (mm) times the lookup table
+ * value, so the table should already include any scaling to the desired
+ * units. If an offset is given, it is added to the coordinates of every pixel
+ * with a non-zero range; pixels without a return are left at the origin.
+ *
+ * @param col_buf column returned by nth_col
+ * @param lut_x x component of the lookup table for the pixels of the column
+ * @param lut_y y component of the lookup table for the pixels of the column
+ * @param lut_z z component of the lookup table for the pixels of the column
+ * @param offset null, or x, y, z offset to add to every return
+ * @param dst planes to which to write decoded pixels
+ */
+void decode_column(const uint8_t* col_buf, const float* lut_x,
+                   const float* lut_y, const float* lut_z, const float* offset,
+                   const px_planes& dst);
+
+/**
+ * Portable reference implementation of decode_column
+ */
+void decode_column_scalar(const uint8_t* col_buf, const float* lut_x,
+                          const float* lut_y, const float* lut_z,
+                          const float* offset, const px_planes& dst);
+
+/**
+ * Compute cartesian coordinates from previously decoded ranges, with the same
+ * results as decode_column would have given for them. Uses AVX2 or NEON when
+ * the cpu supports it
+ *
+ * @param range n ranges in mm
+ * @param lut_x x component of the lookup table for the n pixels
+ * @param lut_y y component of the lookup table for the n pixels
+ * @param lut_z z component of the lookup table for the n pixels
+ * @param offset null, or x, y, z offset to add to every return
+ * @param n number of pixels
+ * @param x receives the n x coordinates
+ * @param y receives the n y coordinates
+ * @param z receives the n z coordinates
+ */
+void project_pixels(const uint32_t* range, const float* lut_x,
+                    const float* lut_y, const float* lut_z, const float* offset,
+                    int n, float* x, float* y, float* z);
+
+/**
+ * Get the instruction set used by decode_column and project_pixels
+ * @return one of "avx2", "neon" or "scalar"
+ */
+const char* decode_isa();
+}
+}
@@ -0,0 +1,86 @@
+/**
+ * @file
+ * @brief Motion compensation of lidar scans using the sensor imu
+ *
+ * Columns of a scan are measured over a full revolution, so a moving sensor
+ * distorts the scan. The deskewer integrates imu packets into the pose of the
+ * lidar at the timestamp of each column relative to its pose at the start of
+ * the scan, and moves the points of the column into the frame of the scan
+ * start. Gyro rates are integrated into orientation; optionally, accelerations
+ * are double integrated into translation. The accelerometer cannot tell a
+ * constant velocity from standing still, so translation only accounts for
+ * changes of velocity since the start of the scan, and the acceleration at the
+ * start of a scan is taken as gravity.
+ *
+ * A deskewer is not thread safe; adding imu samples and deskewing from
+ * different threads needs external locking.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ouster/os1_decode.h"
+
+namespace ouster {
+namespace OS1 {
+
+struct deskewer;
+
+enum deskew_mode { DESKEW_ROTATION = 1, DESKEW_FULL = 2 };
+
+/**
+ * Create a deskewer. Imu samples are kept in a fixed-size history, so adding
+ * samples and deskewing never allocate.
+ * @param imu_to_sensor_transform 4x4 row-major transform from the sensor info
+ * @param lidar_to_sensor_transform 4x4 row-major transform from the sensor info
+ * @param mode whether to compensate rotation only or rotation and translation
+ * @return pointer owning the deskewer state
+ */
+std::shared_ptr<deskewer> init_deskewer(
+    const std::vector<double>& imu_to_sensor_transform,
+    const std::vector<double>& lidar_to_sensor_transform, deskew_mode mode);
+
+/**
+ * Add an imu sample to the history. Samples older than the newest sample
+ * already added are ignored
+ * @param d deskewer returned by init_deskewer
+ * @param imu_buf imu packet buffer
+ */
+void add_imu_packet(deskewer& d, const uint8_t* imu_buf);
+
+/**
+ * Get the pose of the lidar when a column was measured, relative to the
+ * lidar frame at the start of the scan. Beyond the newest imu sample, its
+ * rates are extrapolated. Cheapest when called with increasing timestamps
+ * for each scan, as when batching.
+ * @param d deskewer returned by init_deskewer
+ * @param scan_ts timestamp of the first column of the scan
+ * @param ts timestamp of the column
+ * @param pose receives the 3x4 row-major transform [R | t] taking points
+ * measured at ts to the frame at scan_ts, with t in m
+ */
+void column_pose(deskewer& d, uint64_t scan_ts, uint64_t ts, float pose[12]);
+
+/**
+ * Transform the decoded points of a column by a pose. Pixels without a return
+ * stay at the origin.
+ * @param pose 3x4 row-major transform returned by column_pose
+ * @param px decoded column with xyz in m
+ */
+void transform_column(const float pose[12], px_column& px);
+
+/**
+ * Deskew the decoded points of a column measured at ts, e.g. from the column
+ * function of batch_to_iter
+ * @param d deskewer returned by init_deskewer
+ * @param scan_ts timestamp of the first column of the scan
+ * @param ts timestamp of the column
+ * @param px decoded column with xyz in m
+ */
+void deskew_column(deskewer& d, uint64_t scan_ts, uint64_t ts,
+                   px_column& px);
+}
+}
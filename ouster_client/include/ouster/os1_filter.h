@@ -0,0 +1,65 @@
+/**
+ * @file
+ * @brief Range and outlier filtering of organized scans in image space
+ *
+ * The pixels of a destaggered range image are neighbors in azimuth and
+ * elevation, so outliers can be found by comparing each return to the eight
+ * pixels around it instead of searching a KD-tree. Each row of the image is
+ * processed in branchless passes over contiguous, padded rows that the
+ * compiler can vectorize; columns wrap around at 360 degrees.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ouster {
+namespace OS1 {
+
+enum filter_flag : uint8_t {
+    FILTER_RANGE = 1,     // closer than min_range or farther than max_range
+    FILTER_ISOLATED = 2,  // fewer than min_neighbors similar neighbors
+    FILTER_EDGE = 4       // farther than a neighbor by more than edge_jump
+};
+
+/**
+ * Parameters of a scan filter. Ranges are in mm; checks with a zero
+ * threshold are disabled
+ */
+struct filter_config {
+    uint32_t min_range;       // flag returns closer than this
+    uint32_t max_range;       // flag returns farther than this
+    int min_neighbors;        // flag returns with fewer similar neighbors
+    uint32_t neighbor_range;  // maximum range difference of similar neighbors
+    uint32_t edge_jump;       // flag returns farther than a neighbor by more
+};
+
+struct scan_filter;
+
+/**
+ * Create a filter for scans of the given dimensions. All storage is allocated
+ * up front.
+ * @param W number of columns of a scan
+ * @param H number of pixels per column
+ * @param px_offset pixel offsets generated by get_px_offset
+ * @param config filter parameters
+ * @return pointer owning the filter state
+ */
+std::shared_ptr<scan_filter> init_filter(int W, int H,
+                                         const std::vector<int>& px_offset,
+                                         const filter_config& config);
+
+/**
+ * Flag the returns of a scan. Returns flagged as out of range do not count as
+ * neighbors of other returns
+ * @param f filter returned by init_filter
+ * @param range W * H ranges in mm indexed like the lookup table returned by
+ * make_xyz_lut
+ * @return W * H combinations of filter_flag, indexed like range and zero for
+ * pixels that pass or have no return; valid until the next call
+ */
+const std::vector<uint8_t>& filter_scan(scan_filter& f, const uint32_t* range);
+}
+}
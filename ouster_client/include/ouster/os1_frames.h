@@ -0,0 +1,111 @@
+/**
+ * @file
+ * @brief Frame-parallel batching of recorded scans
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "ouster/os1_capture.h"
+#include "ouster/os1_util.h"
+
+namespace ouster {
+namespace OS1 {
+
+/**
+ * Process n independent items on a pool of threads and deliver the results in
+ * order. Items are dealt round-robin to per-worker queues; a worker takes the
+ * lowest item of its own queue and, once that is empty, steals the lowest item
+ * of another worker's queue. After processing an item, a worker waits until
+ * all lower items are delivered, then delivers its own, so each worker only
+ * needs storage for the result of one item.
+ *
+ * @param n number of items
+ * @param n_threads number of workers, or 0 for one per hardware thread
+ * @param work called concurrently with the worker index and the item index
+ * @param deliver called with the worker index and the item index after work()
+ * returned for that item, one at a time in increasing item order
+ */
+void run_ordered(size_t n, int n_threads,
+                 const std::function<void(int, size_t)>& work,
+                 const std::function<void(int, size_t)>& deliver);
+
+/**
+ * Batch every scan of a capture like batch_to_iter, decoding several frames
+ * in parallel. Each worker batches a frame starting from the packet given by
+ * the frame index into its own scan buffer of W * H values, so the scans and
+ * timestamps passed to f are identical to those batch_to_iter produces when
+ * fed all lidar packets of the capture in order, including the fill of
+ * missing columns with empty. As with batch_to_iter, the last frame of the
+ * capture is never complete and is not delivered.
+ *
+ * @param r reader returned by open_capture
+ * @param lut a lookup table generated from make_xyz_lut
+ * @param empty value to insert for missing data
+ * @param c function to construct a value from x, y, z (m), i, ts, reflectivity,
+ * ring, noise, range (mm); called concurrently from all workers
+ * @param n_threads number of workers, or 0 for one per hardware thread
+ * @param f callback invoked with the index of the frame in capture_frames, the
+ * scan timestamp and the scan, one frame at a time in capture order. The scan
+ * is only valid until f returns
+ */
+template <typename T, typename C>
+void batch_frames(
+    const capture_reader& r, const xyz_lut& lut, const T& empty, C&& c,
+    int n_threads,
+    const std::function<void(size_t, uint64_t, const std::vector<T>&)>& f) {
+    using iterator_type = typename std::vector<T>::iterator;
+
+    // a frame with its scan timestamp, per worker
+    struct worker_scan {
+        std::vector<T> scan;
+        std::vector<T> scratch;
+        uint64_t scan_ts;
+        bool done;
+    };
+
+    const auto& frames = capture_frames(r);
+    const size_t n_packets = capture_size(r);
+    if (n_threads <= 0) n_threads = std::thread::hardware_concurrency();
+    n_threads = std::max(n_threads, 1);
+    std::vector<worker_scan> scans(n_threads);
+
+    auto work = [&](int w, size_t i) {
+        worker_scan& ws = scans[w];
+        ws.scan.resize(lut.W * lut.H);
+        ws.scratch.resize(lut.W * lut.H);
+        ws.done = false;
+
+        iterator_type it = ws.scan.begin();
+
+        // the frame is complete when the following one starts; packets of
+        // the next frame are written to scratch like a serial batcher would
+        // write them to the next scan
+        auto batch = batch_to_iter<iterator_type>(
+            lut, empty, c, [&](uint64_t scan_ts) {
+                ws.scan_ts = scan_ts;
+                ws.done = true;
+                it = ws.scratch.begin();
+            });
+
+        for (size_t p = frames[i].first_packet; p < n_packets && !ws.done;
+             p++) {
+            const capture_packet packet = capture_packet_at(r, p);
+            if (packet.type == LIDAR_PACKET) batch(packet.buf, it);
+        }
+    };
+
+    auto deliver = [&](int w, size_t i) {
+        if (scans[w].done) f(i, scans[w].scan_ts, scans[w].scan);
+    };
+
+    run_ordered(frames.size(), n_threads, work, deliver);
+}
+}
+}
@@ -0,0 +1,195 @@
+/**
+ * @file
+ * @brief Process-wide counters, latency and queue depth histograms
+ *
+ * Metrics are updated with relaxed atomic operations only, so they are cheap
+ * enough to leave on and safe to update from any thread. Latencies are kept in
+ * log-linear histograms like HdrHistogram: values are bucketed by their most
+ * significant bits with 16 buckets per power of two, bounding the error of
+ * reported percentiles to about 6%.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace ouster {
+namespace OS1 {
+
+enum metric_counter {
+    METRIC_LIDAR_PACKETS = 0,  // lidar packets read from sockets
+    METRIC_IMU_PACKETS,        // imu packets read from sockets
+    METRIC_DROPPED_PACKETS,    // dropped by the kernel or by full packet rings
+    METRIC_MALFORMED_PACKETS,  // read with an unexpected length
+    METRIC_MISSING_COLUMNS,    // zero-filled by batch_to_iter
+    METRIC_FRAMES,             // scans completed by batch_to_iter
+    METRIC_POOL_ALLOCATIONS,   // messages allocated when a pool was empty
+    METRIC_REORDERED_PACKETS,  // passed on by frame_assembler after a gap
+    METRIC_LATE_PACKETS,       // dropped by frame_assembler as late or twice
+    METRIC_QUEUE_DROPS,        // items dropped by full bounded_queues
+    METRIC_HEAP_ALLOCATIONS,   // operator new calls, if counted by the program
+    n_metric_counters
+};
+
+enum metric_latency {
+    // time a scan waits between decoding its last packet and its completion,
+    // which happens on the first packet of the next scan; this includes the
+    // idle time until that packet arrives
+    METRIC_FRAME_WAIT = 0,
+    // time batch_to_iter spends on a packet, excluding its callbacks
+    METRIC_DECODE_TIME,
+    // time to publish a scan
+    METRIC_PUBLISH_TIME,
+    // time from receiving the last packet of a scan, by its receive timestamp
+    // if any, to the completion of the scan
+    METRIC_FRAME_LATENCY,
+    // time from receiving the last packet of a scan to having published it
+    METRIC_PUBLISH_LATENCY,
+    n_metric_latencies
+};
+
+// numbers of items waiting between the stages of a pipeline
+enum metric_depth {
+    // lidar packets in the ring of a receiver when its consumer wakes up
+    METRIC_RECEIVE_QUEUE_DEPTH = 0,
+    // packet messages waiting to be assembled and decoded
+    METRIC_DECODE_QUEUE_DEPTH,
+    // scans waiting to be published
+    METRIC_PUBLISH_QUEUE_DEPTH,
+    n_metric_depths
+};
+
+/**
+ * Summary of a latency histogram, in ns, or of a queue depth histogram
+ */
+struct latency_summary {
+    uint64_t count;
+    uint64_t mean;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t max;
+};
+
+/**
+ * Lock-free log-linear histogram of non-negative values
+ */
+class latency_histogram {
+   public:
+    static const int sub_bits = 4;
+    static const int max_shift = 36;  // 2^41 ns and up share a bucket
+    static const size_t n_buckets = (max_shift + 2) << sub_bits;
+
+    latency_histogram() { reset(); }
+
+    latency_histogram(const latency_histogram&) = delete;
+    latency_histogram& operator=(const latency_histogram&) = delete;
+
+    /** Record a value. Larger values than supported go in the last bucket */
+    void record(uint64_t v) {
+        buckets_[bucket_of(v)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(v, std::memory_order_relaxed);
+
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (v > max && !max_.compare_exchange_weak(
+                              max, v, std::memory_order_relaxed)) {
+        }
+    }
+
+    /** Summarize the recorded values; percentiles are bucket midpoints */
+    latency_summary summary() const;
+
+    /** Clear all recorded values. Not atomic with concurrent updates */
+    void reset();
+
+    static size_t bucket_of(uint64_t v) {
+        const int msb = 63 - __builtin_clzll(v | 1);
+        if (msb < sub_bits) return v;
+        const int shift = msb - sub_bits;
+        if (shift > max_shift) return n_buckets - 1;
+        return ((shift + 1) << sub_bits) + ((v >> shift) - (1 << sub_bits));
+    }
+
+   private:
+    std::atomic<uint64_t> buckets_[n_buckets];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+/**
+ * Point-in-time copy of all metrics
+ */
+struct metrics_snapshot {
+    uint64_t counters[n_metric_counters];
+    latency_summary latencies[n_metric_latencies];
+    latency_summary depths[n_metric_depths];
+};
+
+/**
+ * Get the counter of a metric, to update it directly
+ */
+std::atomic<uint64_t>& metric(metric_counter c);
+
+/**
+ * Get the histogram of a latency metric, to record to it directly
+ */
+latency_histogram& metric(metric_latency l);
+
+/**
+ * Get the histogram of a queue depth metric, to record to it directly
+ */
+latency_histogram& metric(metric_depth d);
+
+/** Add n to a counter */
+inline void count_metric(metric_counter c, uint64_t n = 1) {
+    metric(c).fetch_add(n, std::memory_order_relaxed);
+}
+
+/** Record a latency in ns */
+inline void record_latency(metric_latency l, uint64_t ns) {
+    metric(l).record(ns);
+}
+
+/** Record the number of items in a queue */
+inline void record_depth(metric_depth d, uint64_t n) { metric(d).record(n); }
+
+/** Monotonic time in ns for measuring latencies */
+inline uint64_t metrics_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * Get the current values of all metrics
+ * @return copy of the counters and summaries of the latency and queue depth
+ * histograms
+ */
+metrics_snapshot get_metrics();
+
+/**
+ * Reset all metrics to zero
+ */
+void reset_metrics();
+
+/**
+ * Get the name of a counter, e.g. "lidar_packets"
+ */
+const char* to_string(metric_counter c);
+
+/**
+ * Get the name of a latency metric, e.g. "decode_time"
+ */
+const char* to_string(metric_latency l);
+
+/**
+ * Get the name of a queue depth metric, e.g. "decode_queue_depth"
+ */
+const char* to_string(metric_depth d);
+}
+}
@@ -0,0 +1,131 @@
+/**
+ * @file
+ * @brief Receive, decode and fuse the scans of several sensors
+ *
+ * A single event loop thread drains the sockets of all sensors into per-sensor
+ * packet rings. Each sensor has its own decode thread batching its packets
+ * into preallocated scan buffers, with the sensor's extrinsic transform folded
+ * into its lookup table so points come out in the common frame. Completed
+ * scans are handed to a fusion thread through triple buffers, so slow
+ * consumers never stall decoding; a scan that is not fused before the next
+ * one completes is dropped.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "ouster/os1.h"
+
+namespace ouster {
+namespace OS1 {
+
+/**
+ * A point of a fused scan
+ */
+struct fused_point {
+    float x;  // m, in the common frame
+    float y;
+    float z;
+    uint32_t t;  // ns since the start of the scan
+    uint32_t range;
+    uint16_t signal;
+    uint16_t reflectivity;
+    uint16_t noise;
+    uint8_t ring;
+    uint8_t sensor;  // index of the sensor in the list passed to start_multi
+};
+
+/**
+ * A sensor streamed by start_multi
+ */
+struct multi_sensor {
+    std::shared_ptr<client> cli;
+    sensor_info info;
+    // 4x4 row-major transform from the sensor frame to the common frame, with
+    // the translation in m; identity if empty
+    std::vector<double> extrinsic;
+    // cpu to pin the decode thread of the sensor to; -1 to not pin
+    int decode_cpu;
+};
+
+/**
+ * When start_multi emits fused frames. Both conditions may be combined
+ */
+struct multi_config {
+    // emit as soon as every sensor has completed a new scan
+    bool wait_all;
+    // if positive, also emit slice_ms after the previous frame at the latest,
+    // with the scans completed so far
+    int slice_ms;
+    // capacity of the lidar packet ring of each sensor
+    size_t ring_slots;
+};
+
+/**
+ * The latest scan of one sensor in a fused frame. Points are in column-major
+ * order like batch_to_iter; missing columns are zero.
+ */
+struct fused_scan {
+    int sensor;
+    int W;
+    int H;
+    uint64_t scan_ts;
+    const fused_point* points;
+};
+
+/**
+ * Scans of the sensors that completed a scan since the last frame, in sensor
+ * order
+ */
+struct fused_frame {
+    uint64_t ts;  // earliest scan timestamp of the frame
+    std::vector<fused_scan> scans;
+};
+
+struct multi;
+
+/**
+ * Start receiving, decoding and fusing the scans of several sensors. The
+ * receive thread is pinned according to the options of the first sensor.
+ * Imu packets are discarded.
+ * @param sensors the sensors to stream; at most 256
+ * @param config when to emit fused frames
+ * @param f callback invoked on the fusion thread with each fused frame. The
+ * points are only valid until it returns
+ * @return pointer owning the threads and buffers, or null if a parameter is
+ * invalid; destroying it stops all threads. If polling the sensors fails, all
+ * threads stop and multi_failed returns true
+ */
+std::shared_ptr<multi> start_multi(
+    const std::vector<multi_sensor>& sensors, const multi_config& config,
+    std::function<void(const fused_frame&)> f);
+
+/**
+ * Get the number of scans of a sensor that were replaced by a newer scan
+ * before they could be fused
+ * @param m handle returned by start_multi
+ * @param sensor index of the sensor
+ */
+uint64_t dropped_scans(const multi& m, int sensor);
+
+/**
+ * Get the number of packets of a sensor discarded because its ring was full
+ * @param m handle returned by start_multi
+ * @param sensor index of the sensor
+ */
+uint64_t dropped_packets(const multi& m, int sensor);
+
+/**
+ * Check whether streaming stopped because polling the sensors failed. No more
+ * frames are emitted once it did
+ * @param m handle returned by start_multi
+ * @return true if receiving, decoding and fusing stopped on an error
+ */
+bool multi_failed(const multi& m);
+}
+}
@@ -0,0 +1,198 @@
+/**
+ * @file
+ * @brief Bounded queues and thread placement for the stages of a pipeline
+ *
+ * Stages of a pipeline, e.g. receiving, decoding and publishing, run on their
+ * own threads and hand items to each other through bounded queues, so a slow
+ * stage makes items wait for at most the capacity of the queue in front of it
+ * instead of latency growing without bound. What happens when a queue is full
+ * is chosen per queue: dropping the oldest frame keeps the latency of the
+ * frames that are passed on bounded, dropping the newest keeps the oldest
+ * items intact, and blocking propagates backpressure to the previous stage.
+ * The depth of each queue is recorded as a metric on every push, showing
+ * where backpressure builds.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "ouster/os1_metrics.h"
+
+namespace ouster {
+namespace OS1 {
+
+enum queue_policy { QUEUE_DROP_OLDEST, QUEUE_DROP_NEWEST, QUEUE_BLOCK };
+
+/**
+ * Threads and placement of a stage. The defaults leave it as created
+ */
+struct thread_config {
+    // number of threads running the stage, for stages that can split their
+    // work, e.g. decoding whole frames in parallel
+    int n_threads = 1;
+    // cpus the threads may run on; empty for any
+    std::vector<int> cpus;
+    // SCHED_FIFO priority from 1 to 99, or 0 to keep the default scheduler.
+    // Needs CAP_SYS_NICE or an rtprio limit
+    int fifo_priority = 0;
+};
+
+/**
+ * Apply the cpus and scheduling priority of a stage to the calling thread
+ * @param cfg placement of the stage
+ * @return false if setting the affinity or priority failed
+ */
+bool configure_thread(const thread_config& cfg);
+
+/**
+ * Queue between two stages holding items of a total weight of at most
+ * capacity, safe to use from any number of producer and consumer threads.
+ * The weight of an item is e.g. the number of packets it carries, so the
+ * queue bounds the work waiting regardless of how it is batched. Items also
+ * carry a group, e.g. their frame id: dropping the oldest items drops all
+ * consecutive items of the oldest group as a unit, so a frame is never
+ * passed on after some of its items were dropped for a newer frame.
+ *
+ * Items are swapped in and out of preallocated slots rather than copied, so
+ * buffers such as vectors or message pointers are recycled; items dropped
+ * with the oldest group are reset to T{} instead. Items dropped because the
+ * queue was full are counted in METRIC_QUEUE_DROPS.
+ */
+template <typename T>
+class bounded_queue {
+   public:
+    /**
+     * @param capacity maximum total weight of queued items, at least 1
+     * @param policy what push does when the queue is full
+     * @param depth metric recording the total weight queued on each push
+     */
+    bounded_queue(size_t capacity, queue_policy policy, metric_depth depth)
+        : capacity_(capacity ? capacity : 1),
+          items_(capacity_),
+          weights_(capacity_),
+          groups_(capacity_),
+          policy_{policy},
+          depth_{depth} {}
+
+    bounded_queue(const bounded_queue&) = delete;
+    bounded_queue& operator=(const bounded_queue&) = delete;
+
+    /**
+     * Queue an item, swapping it with the contents of a free slot. When the
+     * item does not fit, QUEUE_DROP_OLDEST drops the oldest groups until it
+     * does, QUEUE_DROP_NEWEST leaves the item unchanged and QUEUE_BLOCK waits
+     * until enough items are popped. An item heavier than capacity is only
+     * queued into an empty queue
+     * @param item the item to queue; receives the contents of the slot used
+     * @param weight weight of the item, at least 1
+     * @param group group of the item, or -1 for a group of its own
+     * @return false if the item was dropped or the queue is closed
+     */
+    bool push(T& item, size_t weight = 1, int64_t group = -1) {
+        if (!weight) weight = 1;
+        auto fits = [&] { return !size_ || weight_ + weight <= capacity_; };
+
+        std::unique_lock<std::mutex> lock{mtx_};
+        if (policy_ == QUEUE_BLOCK)
+            not_full_.wait(lock, [&] { return closed_ || fits(); });
+        if (closed_) return false;
+
+        if (!fits() && policy_ == QUEUE_DROP_NEWEST) {
+            count_metric(METRIC_QUEUE_DROPS);
+            return false;
+        }
+        while (!fits()) drop_oldest_group();
+
+        const size_t i = (first_ + size_) % items_.size();
+        std::swap(item, items_[i]);
+        weights_[i] = weight;
+        groups_[i] = group;
+        size_++;
+        weight_ += weight;
+        record_depth(depth_, weight_);
+
+        lock.unlock();
+        not_empty_.notify_one();
+        return true;
+    }
+
+    /**
+     * Wait for the oldest item and take it, swapping it with item
+     * @param item receives the item; its previous contents are recycled
+     * @return false once the queue is closed and empty
+     */
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock{mtx_};
+        not_empty_.wait(lock, [&] { return closed_ || size_; });
+        if (!size_) return false;
+
+        std::swap(item, items_[first_]);
+        weight_ -= weights_[first_];
+        first_ = (first_ + 1) % items_.size();
+        size_--;
+
+        lock.unlock();
+        not_full_.notify_all();
+        return true;
+    }
+
+    /**
+     * Stop accepting items and wake all waiting threads. Items already queued
+     * can still be popped
+     */
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock{mtx_};
+            closed_ = true;
+        }
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    /** total weight of the queued items */
+    size_t size() const {
+        std::lock_guard<std::mutex> lock{mtx_};
+        return weight_;
+    }
+
+    /** maximum total weight of queued items */
+    size_t capacity() const { return capacity_; }
+
+   private:
+    // drop the oldest item and the items of its group queued right after it
+    void drop_oldest_group() {
+        const int64_t group = groups_[first_];
+        do {
+            count_metric(METRIC_QUEUE_DROPS);
+            items_[first_] = T{};
+            weight_ -= weights_[first_];
+            first_ = (first_ + 1) % items_.size();
+            size_--;
+        } while (size_ && group >= 0 && groups_[first_] == group);
+    }
+
+    // each item weighs at least 1, so capacity slots are enough unless an
+    // oversized item was queued, which is then the only one
+    const size_t capacity_;
+    std::vector<T> items_;
+    std::vector<size_t> weights_;
+    std::vector<int64_t> groups_;
+    const queue_policy policy_;
+    const metric_depth depth_;
+
+    mutable std::mutex mtx_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    size_t first_{0};
+    size_t size_{0};
+    size_t weight_{0};
+    bool closed_{false};
+};
+}
+}
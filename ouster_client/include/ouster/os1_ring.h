@@ -0,0 +1,139 @@
+/**
+ * @file
+ * @brief Lock-free hand-off of packets from a dedicated receive thread
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "ouster/os1.h"
+#include "ouster/os1_metrics.h"
+
+namespace ouster {
+namespace OS1 {
+
+/**
+ * Preallocated single-producer / single-consumer ring of fixed-size packet
+ * slots. Slots are cache-line aligned; the producer receives directly into free
+ * slots and the consumer reads them in place, so packets are never copied.
+ * Neither side ever blocks: when the ring is full, new packets are counted as
+ * overflows and discarded by the producer.
+ */
+class packet_ring {
+   public:
+    static const size_t cache_line = 64;
+
+    /**
+     * @param n_slots capacity of the ring; rounded up to a power of two
+     * @param slot_bytes size of each slot; slots are spaced by this size
+     * rounded up to a multiple of the cache line size
+     */
+    packet_ring(size_t n_slots, size_t slot_bytes);
+    ~packet_ring();
+
+    packet_ring(const packet_ring&) = delete;
+    packet_ring& operator=(const packet_ring&) = delete;
+
+    /** distance in bytes between consecutive slots */
+    size_t stride() const { return stride_; }
+
+    /** number of slots */
+    size_t capacity() const { return mask_ + 1; }
+
+    /**
+     * Producer: get the run of free slots starting at the write position,
+     * stopping at the end of the buffer.
+     * @param bufs set to the first free slot, spaced by stride()
+     * @param ts set to the receive timestamps of the free slots
+     * @return number of consecutive free slots, 0 if the ring is full
+     */
+    size_t acquire(uint8_t** bufs, uint64_t** ts);
+
+    /** Producer: make the first n acquired slots visible to the consumer */
+    void commit(size_t n);
+
+    /** Producer: record n packets that were discarded because of overflow */
+    void discard(size_t n) {
+        overflows_.fetch_add(n, std::memory_order_relaxed);
+        count_metric(METRIC_DROPPED_PACKETS, n);
+    }
+
+    /**
+     * Consumer: get the oldest unread slot. The slot remains valid until pop()
+     * @param ts if not null, set to the receive timestamp of the packet
+     * @return pointer to the packet, or null if the ring is empty
+     */
+    const uint8_t* front(uint64_t* ts = nullptr) const;
+
+    /** Consumer: release the slot returned by front() for reuse */
+    void pop();
+
+    /** number of unread packets */
+    size_t size() const;
+
+    /** number of packets discarded because the ring was full */
+    uint64_t overflows() const {
+        return overflows_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    size_t mask_;
+    size_t stride_;
+    uint8_t* data_;
+    uint64_t* ts_;
+
+    // keep producer and consumer indices on separate cache lines
+    alignas(cache_line) std::atomic<size_t> head_;
+    alignas(cache_line) std::atomic<size_t> tail_;
+    alignas(cache_line) std::atomic<uint64_t> overflows_;
+};
+
+/**
+ * Handle to a thread draining the sockets of a client into packet rings
+ */
+struct receiver;
+
+/**
+ * Start a thread that reads all lidar and imu packets from a client into
+ * packet rings as soon as they arrive. The thread is pinned according to the
+ * client's options and never waits on consumers.
+ * @param cli client returned by init_client associated with the connection
+ * @param n_lidar_slots capacity of the lidar packet ring
+ * @param n_imu_slots capacity of the imu packet ring
+ * @return pointer owning the thread and rings; destroying it stops the thread
+ */
+std::shared_ptr<receiver> start_receiver(std::shared_ptr<client> cli,
+                                         size_t n_lidar_slots = 1024,
+                                         size_t n_imu_slots = 256);
+
+/**
+ * Get the ring holding lidar packets. Slots hold lidar_packet_bytes and the
+ * calling thread must be the only consumer.
+ * @param r receiver returned by start_receiver
+ */
+packet_ring& lidar_ring(receiver& r);
+
+/**
+ * Get the ring holding imu packets. Slots hold imu_packet_bytes with receive
+ * timestamps like those of the lidar ring, and the calling thread must be the
+ * only consumer.
+ * @param r receiver returned by start_receiver
+ */
+packet_ring& imu_ring(receiver& r);
+
+/**
+ * Block for up to timeout_ms until packets are available in either ring. Only
+ * one thread may wait on a receiver at a time
+ * @param r receiver returned by start_receiver
+ * @param timeout_ms milliseconds to block while waiting for data
+ * @return client_state s where (s & LIDAR_DATA) and (s & IMU_DATA) are true if
+ * the respective rings are not empty, and (s & ERROR) is true if the receive
+ * thread stopped because of an error
+ */
+client_state wait_receiver(receiver& r, int timeout_ms = 100);
+}
+}
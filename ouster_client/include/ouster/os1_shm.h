@@ -0,0 +1,215 @@
+/**
+ * @file
+ * @brief Fan-out of packets and scans to local processes through shared memory
+ *
+ * A publisher creates a POSIX shared memory object holding the sensor metadata
+ * and three rings of fixed-size slots: raw lidar packets, raw imu packets and
+ * decoded scans. Readers map the object and follow the rings at their own
+ * pace, so a single receive and decode serves any number of local consumers
+ * without serialization or per-consumer copies.
+ *
+ * Each slot is guarded by a sequence counter that is odd while the publisher
+ * writes the slot. The publisher never waits for readers: a reader that falls
+ * a whole ring behind skips to the oldest slot still available, and a reader
+ * using a slot while it is overwritten finds out from the counter when
+ * releasing it. Readers block without polling on a futex in the shared
+ * memory, which the publisher only wakes if someone is waiting.
+ *
+ * A publisher flags its object as closed when it is destroyed, and a new
+ * publisher of the same name flags the object of its predecessor even if that
+ * one exited without closing it. Readers find out from shm_closed and open
+ * the new object.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "ouster/os1_util.h"
+
+namespace ouster {
+namespace OS1 {
+
+struct shm_publisher;
+struct shm_reader;
+
+enum shm_stream { SHM_LIDAR_PACKETS = 0, SHM_IMU_PACKETS, SHM_SCANS };
+
+/**
+ * Layout of the slots of the scan ring
+ */
+enum shm_scan_layout : uint32_t {
+    // the planes of a scan_channels, in declaration order: W * H range,
+    // signal, reflectivity and noise values, then W column timestamps and
+    // encoder counts
+    SHM_SCAN_CHANNELS = 1,
+    // W * H points of point_bytes each, e.g. the PointOS1 layout of the
+    // points topic of ouster_ros, written by the caller
+    SHM_SCAN_POINTS = 2
+};
+
+/**
+ * Sizes of the rings of a shared memory publisher
+ */
+struct shm_config {
+    size_t lidar_slots = 1024;
+    size_t imu_slots = 256;
+    size_t scan_slots = 4;
+    shm_scan_layout scan_layout = SHM_SCAN_CHANNELS;
+    // size of a point for SHM_SCAN_POINTS
+    size_t point_bytes = 0;
+    // permissions of the object, regardless of the umask. Readers map it
+    // writable to wait for data, so they need write access
+    unsigned mode = 0660;
+};
+
+/**
+ * Description of the contents of a shared memory object
+ */
+struct shm_info {
+    int W;
+    int H;
+    shm_scan_layout scan_layout;
+    size_t point_bytes;
+    size_t scan_bytes;  // size of a scan slot
+    std::string metadata;
+};
+
+/**
+ * Create a shared memory object and map it for publishing. An existing object
+ * of the same name is flagged as closed and unlinked first; readers still
+ * mapping it keep reading the old one, which no longer changes. The object is
+ * closed and unlinked again when the publisher is destroyed
+ * @param name name of the object as for shm_open, e.g. "/os1"
+ * @param metadata sensor metadata returned by get_metadata
+ * @param W number of columns of a scan
+ * @param H number of pixels per column
+ * @param cfg sizes of the rings
+ * @return pointer owning the mapping, or an empty pointer on failure
+ */
+std::shared_ptr<shm_publisher> init_shm_publisher(const std::string& name,
+                                                  const std::string& metadata,
+                                                  int W, int H,
+                                                  const shm_config& cfg = {});
+
+/**
+ * Start writing the next slot of a ring in place, e.g. to batch a scan of
+ * points directly into shared memory. Readers skip the slot until it is
+ * committed
+ * @param p publisher returned by init_shm_publisher
+ * @param s the ring to write
+ * @return the slot, of lidar_packet_bytes, imu_packet_bytes or the scan size
+ */
+uint8_t* begin_shm_write(shm_publisher& p, shm_stream s);
+
+/**
+ * Make the slot returned by the last call to begin_shm_write for a ring
+ * visible to readers, waking readers waiting for it
+ * @param p publisher returned by init_shm_publisher
+ * @param s the ring written
+ * @param ts timestamp of the packet or scan in ns
+ */
+void commit_shm_write(shm_publisher& p, shm_stream s, uint64_t ts);
+
+/**
+ * Copy a packet to the next slot of a packet ring
+ * @param p publisher returned by init_shm_publisher
+ * @param s SHM_LIDAR_PACKETS or SHM_IMU_PACKETS
+ * @param buf packet of the size of the slots of the ring
+ * @param ts receive timestamp of the packet in ns
+ */
+void publish_shm_packet(shm_publisher& p, shm_stream s, const uint8_t* buf,
+                        uint64_t ts);
+
+/**
+ * Copy a scan to the next slot of a scan ring with the SHM_SCAN_CHANNELS
+ * layout
+ * @param p publisher returned by init_shm_publisher
+ * @param scan the scan batched by batch_to_channels
+ * @param scan_ts timestamp of the first column of the scan
+ * @return true if the scan was published, false if the dimensions or the
+ * scan layout of the publisher differ
+ */
+bool publish_shm_scan(shm_publisher& p, const scan_channels& scan,
+                      uint64_t scan_ts);
+
+/**
+ * Map a shared memory object created by init_shm_publisher. Reading starts
+ * with the slots committed after this call
+ * @param name name of the object passed to init_shm_publisher
+ * @return pointer owning the mapping and read positions, or an empty pointer
+ * if the object does not exist, is not a valid publisher or its layout does
+ * not fit the object
+ */
+std::shared_ptr<shm_reader> open_shm_reader(const std::string& name);
+
+/**
+ * Get the dimensions, scan layout and sensor metadata of a shared memory
+ * object
+ * @param r reader returned by open_shm_reader
+ */
+const shm_info& get_shm_info(const shm_reader& r);
+
+/**
+ * Get the next committed slot of a ring in place, skipping slots that were
+ * overwritten before they were read. The slot stays mapped but may be
+ * overwritten by the publisher; call end_shm_read before the next call for
+ * the same ring to find out whether it was
+ * @param r reader returned by open_shm_reader
+ * @param s the ring to read
+ * @param ts if not null, set to the timestamp of the slot
+ * @return pointer to the slot, or null if no new slot was committed
+ */
+const uint8_t* begin_shm_read(shm_reader& r, shm_stream s,
+                              uint64_t* ts = nullptr);
+
+/**
+ * Finish reading the slot returned by begin_shm_read
+ * @param r reader returned by open_shm_reader
+ * @param s the ring read
+ * @return true if the slot was not overwritten while it was read, false if
+ * the data read may be torn
+ */
+bool end_shm_read(shm_reader& r, shm_stream s);
+
+/**
+ * Copy the next scan with the SHM_SCAN_CHANNELS layout out of shared memory,
+ * retrying if the publisher overwrites it meanwhile
+ * @param r reader returned by open_shm_reader
+ * @param scan receives the scan; must have the dimensions of the publisher
+ * @param scan_ts receives the timestamp of the first column of the scan
+ * @return true if a scan was read, false if no new scan was committed
+ */
+bool read_shm_scan(shm_reader& r, scan_channels& scan, uint64_t& scan_ts);
+
+/**
+ * Get the number of slots of a ring skipped by a reader because they were
+ * overwritten before or while they were read
+ * @param r reader returned by open_shm_reader
+ * @param s the ring
+ */
+uint64_t shm_overruns(const shm_reader& r, shm_stream s);
+
+/**
+ * Check whether the publisher of a shared memory object was destroyed or
+ * replaced, so that no more slots will be committed. Slots committed before
+ * can still be read; open the object again to follow a new publisher
+ * @param r reader returned by open_shm_reader
+ * @return true if the object is closed
+ */
+bool shm_closed(const shm_reader& r);
+
+/**
+ * Block for up to timeout_ms until a slot of a ring is committed that the
+ * reader has not read yet, or the object is closed
+ * @param r reader returned by open_shm_reader
+ * @param s the ring to wait for
+ * @param timeout_ms milliseconds to block while waiting for data
+ * @return true if a slot is available
+ */
+bool wait_shm(shm_reader& r, shm_stream s, int timeout_ms = 100);
+}
+}
@@ -6,10 +6,15 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <functional>
 #include <iterator>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "ouster/os1_decode.h"
+#include "ouster/os1_metrics.h"
 #include "ouster/os1_packet.h"
 
 namespace ouster {
@@ -47,6 +52,39 @@ std::vector<double> make_xyz_lut(
     int W, int H, const std::vector<double>& beam_azimuth_angles,
     const std::vector<double>& beam_altitude_angles);
 
+/**
+ * Single precision lookup table for computing cartesian coordinates in meters
+ * directly from ranges in mm. Each component is stored in its own plane of W *
+ * H values indexed like the lookup table returned by make_xyz_lut, so a packet
+ * column reads contiguous memory from each plane. The mm -> m conversion and
+ * any rotation are folded into the planes; any translation is kept separately
+ * in offset and only applied to points with a non-zero range.
+ */
+struct xyz_lut {
+    int W;
+    int H;
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::array<float, 3> offset;
+};
+
+/**
+ * Generate a single precision, structure-of-arrays lookup table. See
+ * make_xyz_lut, above.
+ * @param W number of columns in the lidar scan. One of 512, 1024, or 2048.
+ * @param H number of rows in the lidar scan. 64 for the OS1 family of sensors.
+ * @param beam_azimuth_angles azimuth offsets in degrees for each of H beams
+ * @param beam_altitude_angles altitude in degrees for each of H beams
+ * @param transform 4x4 row-major homogeneous transform with translation in mm
+ * applied to every point, e.g. lidar_to_sensor_transform. Empty for identity
+ * @return lookup table to use with batch_to_iter
+ */
+xyz_lut make_xyz_lut(int W, int H,
+                     const std::vector<double>& beam_azimuth_angles,
+                     const std::vector<double>& beam_altitude_angles,
+                     const std::vector<double>& transform);
+
 /**
  * Generate a table of pixel offsets based on the scan width (512, 1024, or 2048
  * columns). These can be used to create a de-staggered range image where each
@@ -57,38 +95,401 @@ std::vector<double> make_xyz_lut(
  */
 std::vector<int> get_px_offset(int W);
 
+/**
+ * Range of columns of a scan passed to the sector callback of batch_to_iter.
+ * The points of the sector are at offsets H * first_col to H * (first_col +
+ * n_cols) of the iterator being batched to.
+ */
+struct scan_sector {
+    int first_col;      // measurement id of the first column of the sector
+    int n_cols;         // number of columns in the sector
+    uint64_t scan_ts;   // timestamp of the first column of the scan
+    uint64_t first_ts;  // timestamp of the first column received
+    uint64_t last_ts;   // timestamp of the last column received
+};
+
 /**
  * Make a function that batches a single scan (revolution) of data to a
  * random-access iterator. The callback f() is invoked with the timestamp of the
- * first column in the scan before adding data from a new scan. Timestamps for
- * each column are ns relative to the scan timestamp. XYZ coordinates in meters
- * are computed using the provided lookup table.
+ * first column in the scan before adding data from a new scan. The iterator is
+ * taken by reference, so f() may point it to a new buffer to receive the next
+ * scan. Timestamps for each column are ns relative to the scan timestamp. XYZ
+ * coordinates in meters are computed using the provided lookup table.
+ *
+ * For consumers that cannot wait for a whole scan, the columns of a scan can
+ * also be split into consecutive sectors of sector_cols columns (the last
+ * sector of a scan may be shorter). The callback s() is invoked with the column
+ * range of a sector as soon as its last column has been added, or missing
+ * columns after it are detected, and always before f() for the last sector.
+ * Sectors with no data received are skipped.
  *
  * The value type is assumed to be constructed from 9 values: x, y, z,
  * (padding), intensity, ts, reflectivity, noise, range (in mm) and
  * default-constructible. It should be compatible with PointOS1 in the
  * ouster_ros package.
  *
- * @param xyz_lut a lookup table generated from make_xyz_lut, above
- * @param W number of columns in the lidar scan. One of 512, 1024, or 2048.
- * @param H number of rows in the lidar scan. 64 for the OS1 family of sensors.
+ * @param lut a lookup table generated from make_xyz_lut, above
  * @param empty value to insert for mossing data
  * @param c function to construct a value from x, y, z (m), i, ts, reflectivity,
- * ring, noise, range (mm). Needed to use with Eigen datatypes.
+ * ring, noise, range (mm). Needed to use with Eigen datatypes. Prefer a lambda
+ * or other function object to a function pointer, which cannot be inlined
  * @param f callback invoked when batching a scan is done.
+ * @param sector_cols number of columns per sector, or 0 to disable sectors
+ * @param s callback invoked with a scan_sector when batching a sector is done
+ * @param p function invoked with the scan timestamp, the column timestamp, the
+ * measurement id and the px_column of each decoded column before its points
+ * are constructed, which may modify the decoded values, e.g. to motion
+ * compensate them
  * @return a function taking a lidar packet buffer and random-access iterator to
  * which data is added for every point in the scan.
  */
+template <typename iterator_type, typename F, typename C, typename S,
+          typename P>
+std::function<void(const uint8_t*, iterator_type& it)> batch_to_iter(
+    const xyz_lut& lut,
+    const typename std::iterator_traits<iterator_type>::value_type& empty,
+    C&& c, F&& f, int sector_cols, S&& s, P&& p);
+
+/**
+ * The function returned by batch_to_iter, batching scans of W x H points. For
+ * the sizes of the supported lidar modes, W and H are compile-time constants
+ * so the loops over the pixels of a column have constant bounds and the
+ * inlined constructor can be unrolled and vectorized; 0 means the size of the
+ * lookup table is used instead. See batch_to_iter for the parameters.
+ */
+template <int W_, int H_, typename iterator_type, typename C, typename F,
+          typename S, typename P>
+class scan_batcher {
+   public:
+    using value_type = typename std::iterator_traits<iterator_type>::value_type;
+
+    scan_batcher(const xyz_lut& lut, const value_type& empty, C c, F f,
+                 int sector_cols, S s, P p)
+        : lut_(lut),
+          empty_(empty),
+          c_(std::move(c)),
+          f_(std::move(f)),
+          sector_cols_{sector_cols},
+          s_(std::move(s)),
+          p_(std::move(p)),
+          next_m_id_{W()},
+          has_offset_{lut.offset[0] != 0 || lut.offset[1] != 0 ||
+                      lut.offset[2] != 0} {}
+
+    void operator()(const uint8_t* packet_buf, iterator_type& it) {
+        const int W = this->W();
+        const int H = this->H();
+        OS1::px_column px;
+
+        // time spent in callbacks is excluded from METRIC_DECODE_TIME
+        const uint64_t t0 = metrics_now();
+        uint64_t t_cb = 0;
+
+        auto finish_sector = [&]() {
+            if (sector_end_ < 0) return;
+            sector_.n_cols = sector_end_ - sector_.first_col;
+            sector_end_ = -1;
+            const uint64_t t = metrics_now();
+            s_(sector_);
+            t_cb += metrics_now() - t;
+        };
+
+        for (int icol = 0; icol < OS1::columns_per_buffer; icol++) {
+            const uint8_t* col_buf = OS1::nth_col(icol, packet_buf);
+            const uint16_t m_id = OS1::col_measurement_id(col_buf);
+            const uint16_t f_id = OS1::col_frame_id(col_buf);
+            const uint64_t ts = OS1::col_timestamp(col_buf);
+            const bool valid = OS1::col_valid(col_buf) == 0xffffffff;
+
+            // drop invalid / out-of-bounds data in case of misconfiguration
+            if (!valid || m_id >= W || f_id + 1 == cur_f_id_) continue;
+
+            if (f_id != cur_f_id_) {
+                // if not initializing with first packet
+                if (scan_ts_ != -1) {
+                    // zero out remaining missing columns
+                    std::fill(it + (H * next_m_id_), it + (H * W), empty_);
+                    count_metric(METRIC_MISSING_COLUMNS, W - next_m_id_);
+                    finish_sector();
+
+                    count_metric(METRIC_FRAMES);
+                    if (last_end_)
+                        record_latency(METRIC_FRAME_WAIT,
+                                       metrics_now() - last_end_);
+                    const uint64_t t = metrics_now();
+                    f_(scan_ts_);
+                    t_cb += metrics_now() - t;
+                }
+
+                // start new frame
+                scan_ts_ = ts;
+                next_m_id_ = 0;
+                cur_f_id_ = f_id;
+            }
+
+            // zero out missing columns if we jumped forward
+            if (m_id >= next_m_id_) {
+                std::fill(it + (H * next_m_id_), it + (H * m_id), empty_);
+                if (m_id > next_m_id_)
+                    count_metric(METRIC_MISSING_COLUMNS, m_id - next_m_id_);
+                next_m_id_ = m_id + 1;
+            }
+
+            // the pending sector is complete if we jumped past its end
+            if (m_id >= sector_end_) finish_sector();
+
+            // index of the first point in current packet
+            const int idx = H * m_id;
+
+            OS1::decode_column(col_buf, &lut_.x[idx], &lut_.y[idx],
+                               &lut_.z[idx],
+                               has_offset_ ? lut_.offset.data() : nullptr,
+                               px.planes());
+            p_(scan_ts_, ts, m_id, px);
+
+            const uint32_t t = ts - scan_ts_;
+            iterator_type col_it = it + idx;
+
+            // fully unrolling the constant bound spills registers
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 8
+#pragma GCC unroll 4
+#endif
+            for (int ipx = 0; ipx < H; ipx++) {
+                // x, y, z(m), i, ts, reflectivity, ring, noise, range (mm)
+                col_it[ipx] = c_(px.x[ipx], px.y[ipx], px.z[ipx],
+                                 px.signal[ipx], t, px.reflectivity[ipx],
+                                 static_cast<uint8_t>(ipx), px.noise[ipx],
+                                 px.range[ipx]);
+            }
+
+            if (sector_cols_ > 0) {
+                if (sector_end_ < 0) {
+                    sector_.first_col = m_id / sector_cols_ * sector_cols_;
+                    sector_.scan_ts = scan_ts_;
+                    sector_.first_ts = ts;
+                    sector_end_ = std::min(sector_.first_col + sector_cols_, W);
+                }
+                sector_.last_ts = ts;
+                if (m_id + 1 == sector_end_) finish_sector();
+            }
+        }
+
+        last_end_ = metrics_now();
+        record_latency(METRIC_DECODE_TIME, last_end_ - t0 - t_cb);
+    }
+
+    /**
+     * Forget the frame being batched without finishing it, so the next packet
+     * starts a new scan, e.g. to batch frames that are not consecutive
+     */
+    void reset() {
+        next_m_id_ = W();
+        cur_f_id_ = -1;
+        scan_ts_ = -1;
+        sector_end_ = -1;
+        last_end_ = 0;
+    }
+
+   private:
+    int W() const { return W_ ? W_ : lut_.W; }
+    int H() const { return H_ ? H_ : lut_.H; }
+
+    xyz_lut lut_;
+    value_type empty_;
+    C c_;
+    F f_;
+    int sector_cols_;
+    S s_;
+    P p_;
+
+    int next_m_id_;
+    int32_t cur_f_id_{-1};
+    int64_t scan_ts_{-1L};
+
+    // pending sector; empty if sector_end_ is -1
+    scan_sector sector_{0, 0, 0, 0, 0};
+    int sector_end_{-1};
+
+    // when decoding the previous packet finished, for METRIC_FRAME_WAIT
+    uint64_t last_end_{0};
+
+    // skip the offset entirely when there is no translation
+    bool has_offset_;
+};
+
+/**
+ * Make a scan_batcher for scans of exactly W x H points, for callers that
+ * select the size once, e.g. from n_cols_of_lidar_mode, and call the batcher
+ * directly instead of through a std::function. See batch_to_iter for the
+ * parameters; the lookup table must be for W x H scans.
+ * @return the batcher, a function object like the one batch_to_iter returns
+ */
+template <int W, int H, typename iterator_type, typename F, typename C,
+          typename S, typename P>
+scan_batcher<W, H, iterator_type, typename std::decay<C>::type,
+             typename std::decay<F>::type, typename std::decay<S>::type,
+             typename std::decay<P>::type>
+make_scan_batcher(
+    const xyz_lut& lut,
+    const typename std::iterator_traits<iterator_type>::value_type& empty,
+    C&& c, F&& f, int sector_cols, S&& s, P&& p) {
+    return {lut,
+            empty,
+            std::forward<C>(c),
+            std::forward<F>(f),
+            sector_cols,
+            std::forward<S>(s),
+            std::forward<P>(p)};
+}
+
+// callbacks of a scan_batcher without sectors or a column function
+struct no_sector_fn {
+    void operator()(const scan_sector&) const {}
+};
+struct no_column_fn {
+    void operator()(uint64_t, uint64_t, int, const px_column&) const {}
+};
+
+/**
+ * Make a scan_batcher for scans of exactly W x H points without sector
+ * callbacks or a column function. See above.
+ */
+template <int W, int H, typename iterator_type, typename F, typename C>
+scan_batcher<W, H, iterator_type, typename std::decay<C>::type,
+             typename std::decay<F>::type, no_sector_fn, no_column_fn>
+make_scan_batcher(
+    const xyz_lut& lut,
+    const typename std::iterator_traits<iterator_type>::value_type& empty,
+    C&& c, F&& f) {
+    return {lut,
+            empty,
+            std::forward<C>(c),
+            std::forward<F>(f),
+            0,
+            no_sector_fn{},
+            no_column_fn{}};
+}
+
+template <typename iterator_type, typename F, typename C, typename S,
+          typename P>
+std::function<void(const uint8_t*, iterator_type& it)> batch_to_iter(
+    const xyz_lut& lut,
+    const typename std::iterator_traits<iterator_type>::value_type& empty,
+    C&& c, F&& f, int sector_cols, S&& s, P&& p) {
+    using Cd = typename std::decay<C>::type;
+    using Fd = typename std::decay<F>::type;
+    using Sd = typename std::decay<S>::type;
+    using Pd = typename std::decay<P>::type;
+    const int H = pixels_per_column;
+
+    // one instantiation per lidar mode width, and one for any other size
+    if (lut.H == H && lut.W == 512)
+        return scan_batcher<512, H, iterator_type, Cd, Fd, Sd, Pd>{
+            lut, empty, c, f, sector_cols, s, p};
+    if (lut.H == H && lut.W == 1024)
+        return scan_batcher<1024, H, iterator_type, Cd, Fd, Sd, Pd>{
+            lut, empty, c, f, sector_cols, s, p};
+    if (lut.H == H && lut.W == 2048)
+        return scan_batcher<2048, H, iterator_type, Cd, Fd, Sd, Pd>{
+            lut, empty, c, f, sector_cols, s, p};
+    return scan_batcher<0, 0, iterator_type, Cd, Fd, Sd, Pd>{
+        lut, empty, c, f, sector_cols, s, p};
+}
+
+/**
+ * Make a function that batches a single scan (revolution) of data to a
+ * random-access iterator, without a column function. See above.
+ */
+template <typename iterator_type, typename F, typename C, typename S>
+std::function<void(const uint8_t*, iterator_type& it)> batch_to_iter(
+    const xyz_lut& lut,
+    const typename std::iterator_traits<iterator_type>::value_type& empty,
+    C&& c, F&& f, int sector_cols, S&& s) {
+    return batch_to_iter<iterator_type>(
+        lut, empty, std::forward<C>(c), std::forward<F>(f), sector_cols,
+        std::forward<S>(s), [](uint64_t, uint64_t, int, const px_column&) {});
+}
+
+/**
+ * Make a function that batches a single scan (revolution) of data to a
+ * random-access iterator, without sector callbacks. See above.
+ */
 template <typename iterator_type, typename F, typename C>
-std::function<void(const uint8_t*, iterator_type it)> batch_to_iter(
-    const std::vector<double>& xyz_lut, int W, int H,
-    const typename iterator_type::value_type& empty, C&& c, F&& f) {
-    int next_m_id{W};
+std::function<void(const uint8_t*, iterator_type& it)> batch_to_iter(
+    const xyz_lut& lut,
+    const typename std::iterator_traits<iterator_type>::value_type& empty,
+    C&& c, F&& f) {
+    return batch_to_iter<iterator_type>(lut, empty, std::forward<C>(c),
+                                        std::forward<F>(f), 0,
+                                        [](const scan_sector&) {});
+}
+
+/**
+ * Raw channels of a scan without cartesian coordinates, each in its own plane
+ * of W * H values indexed like the lookup table returned by make_xyz_lut, plus
+ * per-column data. Missing pixels and columns are zero.
+ */
+struct scan_channels {
+    int W;
+    int H;
+    std::vector<uint32_t> range;
+    std::vector<uint16_t> signal;
+    std::vector<uint16_t> reflectivity;
+    std::vector<uint16_t> noise;
+    std::vector<uint64_t> col_ts;       // W column timestamps
+    std::vector<uint32_t> col_encoder;  // W column encoder counts
+
+    scan_channels(int w, int h)
+        : W{w},
+          H{h},
+          range(w * h),
+          signal(w * h),
+          reflectivity(w * h),
+          noise(w * h),
+          col_ts(w),
+          col_encoder(w) {}
+};
+
+/**
+ * Make a function that batches a single scan (revolution) of raw channels
+ * without computing cartesian coordinates, for consumers that only need range
+ * images. Scans are split exactly like batch_to_iter, and the callback f() is
+ * invoked with the timestamp of the first column in the scan before adding
+ * data from a new scan; it may swap the contents of the scan being batched to
+ * with another buffer. Use project_xyz to compute coordinates afterwards.
+ *
+ * @param f callback invoked when batching a scan is done
+ * @return a function taking a lidar packet buffer and a scan_channels to which
+ * data is added for every column in the packet
+ */
+template <typename F>
+std::function<void(const uint8_t*, scan_channels& scan)> batch_to_channels(
+    F&& f) {
+    int next_m_id{0};
     int32_t cur_f_id{-1};
 
     int64_t scan_ts{-1L};
 
-    return [=](const uint8_t* packet_buf, iterator_type it) mutable {
+    return [=](const uint8_t* packet_buf, scan_channels& scan) mutable {
+        const int W = scan.W;
+        const int H = scan.H;
+
+        // zero out columns [first, last)
+        auto fill_missing = [&](int first, int last) {
+            if (first >= last) return;
+            std::fill(scan.range.data() + H * first,
+                      scan.range.data() + H * last, 0);
+            std::fill(scan.signal.data() + H * first,
+                      scan.signal.data() + H * last, 0);
+            std::fill(scan.reflectivity.data() + H * first,
+                      scan.reflectivity.data() + H * last, 0);
+            std::fill(scan.noise.data() + H * first,
+                      scan.noise.data() + H * last, 0);
+            std::fill(scan.col_ts.data() + first, scan.col_ts.data() + last,
+                      0);
+            std::fill(scan.col_encoder.data() + first,
+                      scan.col_encoder.data() + last, 0);
+        };
 
         for (int icol = 0; icol < OS1::columns_per_buffer; icol++) {
             const uint8_t* col_buf = OS1::nth_col(icol, packet_buf);
@@ -103,8 +504,7 @@ std::function<void(const uint8_t*, iterator_type it)> batch_to_iter(
             if (f_id != cur_f_id) {
                 // if not initializing with first packet
                 if (scan_ts != -1) {
-                    // zero out remaining missing columns
-                    std::fill(it + (H * next_m_id), it + (H * W), empty);
+                    fill_missing(next_m_id, W);
                     f(scan_ts);
                 }
 
@@ -116,27 +516,179 @@ std::function<void(const uint8_t*, iterator_type it)> batch_to_iter(
 
             // zero out missing columns if we jumped forward
             if (m_id >= next_m_id) {
-                std::fill(it + (H * next_m_id), it + (H * m_id), empty);
+                fill_missing(next_m_id, m_id);
                 next_m_id = m_id + 1;
             }
 
-            // index of the first point in current packet
             const int idx = H * m_id;
+            OS1::decode_column(col_buf, nullptr, nullptr, nullptr, nullptr,
+                               {nullptr, nullptr, nullptr, &scan.range[idx],
+                                &scan.signal[idx], &scan.reflectivity[idx],
+                                &scan.noise[idx]});
+            scan.col_ts[m_id] = ts;
+            scan.col_encoder[m_id] = OS1::col_h_encoder_count(col_buf);
+        }
+    };
+}
 
-            for (uint8_t ipx = 0; ipx < H; ipx++) {
-                const uint8_t* px_buf = OS1::nth_px(ipx, col_buf);
-                uint32_t r = OS1::px_range(px_buf);
-                int ind = 3 * (idx + ipx);
+/**
+ * Compute cartesian coordinates in meters for a window of a scan from its
+ * ranges, giving the same values batch_to_iter computes with the same lookup
+ * table. The window covers n_rows rows starting at first_row of n_cols columns
+ * starting at first_col; columns past the end of the scan wrap around to the
+ * start. Results are stored column by column, n_rows values per column.
+ *
+ * @param lut a lookup table generated from make_xyz_lut, above
+ * @param range W * H ranges in mm indexed like the lookup table
+ * @param first_col measurement id of the first column of the window
+ * @param n_cols number of columns in the window, at most W
+ * @param first_row first row of the window
+ * @param n_rows number of rows in the window, at most H - first_row
+ * @param x receives n_cols * n_rows x coordinates
+ * @param y receives n_cols * n_rows y coordinates
+ * @param z receives n_cols * n_rows z coordinates
+ */
+void project_xyz(const xyz_lut& lut, const uint32_t* range, int first_col,
+                 int n_cols, int first_row, int n_rows, float* x, float* y,
+                 float* z);
 
-                // x, y, z(m), i, ts, reflectivity, ring, noise, range (mm)
-                it[idx + ipx] = c(r * 0.001f * xyz_lut[ind + 0],
-                                  r * 0.001f * xyz_lut[ind + 1],
-                                  r * 0.001f * xyz_lut[ind + 2],
-                                  OS1::px_signal_photons(px_buf), ts - scan_ts,
-                                  OS1::px_reflectivity(px_buf), ipx,
-                                  OS1::px_noise_photons(px_buf), r);
-            }
-        }
+/**
+ * Compute cartesian coordinates in meters for a whole scan from its ranges.
+ * See above.
+ */
+inline void project_xyz(const xyz_lut& lut, const uint32_t* range, float* x,
+                        float* y, float* z) {
+    project_xyz(lut, range, 0, lut.W, 0, lut.H, x, y, z);
+}
+
+/**
+ * Write one row of a destaggered image of one channel of a scan, as two
+ * contiguous runs split at the pixel offset of the row. See destagger below.
+ *
+ * @param src W * H values of a scan in column-major order
+ * @param W number of columns in the lidar scan
+ * @param H number of rows in the lidar scan
+ * @param u the row to write
+ * @param ofs pixel offset of the row, generated by get_px_offset
+ * @param row receives W pixels
+ * @param f function converting a value of src to a pixel
+ */
+template <typename T, typename U, typename F>
+void destagger_row(const T* src, int W, int H, int u, int ofs, U* row,
+                   F&& f) {
+    const T* col = src + u;
+
+    // pixel v of the row comes from measurement id v + ofs, wrapping at W
+    for (int v = 0; v < W - ofs; v++) row[v] = f(col[H * (v + ofs)]);
+    for (int v = W - ofs; v < W; v++) row[v] = f(col[H * (v + ofs - W)]);
+}
+
+/**
+ * Write a destaggered image of one channel of a scan, in which each column of
+ * pixels has the same azimuth angle. Rows are written in order, each as two
+ * contiguous runs split at the pixel offset of the row.
+ *
+ * @param src W * H values of a scan in column-major order, indexed like the
+ * lookup table returned by make_xyz_lut
+ * @param W number of columns in the lidar scan. One of 512, 1024, or 2048.
+ * @param H number of rows in the lidar scan. 64 for the OS1 family of sensors.
+ * @param px_offset pixel offsets generated by get_px_offset
+ * @param dst receives H * W pixels in row-major order
+ * @param f function converting a value of src to a pixel
+ */
+template <typename T, typename U, typename F>
+void destagger(const T* src, int W, int H, const std::vector<int>& px_offset,
+               U* dst, F&& f) {
+    for (int u = 0; u < H; u++)
+        destagger_row(src, W, H, u, px_offset[u], dst + u * W, f);
+}
+
+/**
+ * Destaggered images of a scan, each H * W pixels in row-major order. 16-bit
+ * images keep the full precision of signal, reflectivity and noise; 8-bit
+ * images are clamped or scaled for display.
+ */
+struct scan_images {
+    int W;
+    int H;
+    int range_shift;  // 16-bit range pixels are in units of 2^range_shift mm
+    std::vector<uint16_t> range;
+    std::vector<uint16_t> signal;
+    std::vector<uint16_t> reflectivity;
+    std::vector<uint16_t> noise;
+    std::vector<uint8_t> range8;  // 8-bit images are empty unless requested
+    std::vector<uint8_t> signal8;
+    std::vector<uint8_t> reflectivity8;
+    std::vector<uint8_t> noise8;
+
+    scan_images(int w, int h, int shift, bool mono8)
+        : W{w},
+          H{h},
+          range_shift{shift},
+          range(w * h),
+          signal(w * h),
+          reflectivity(w * h),
+          noise(w * h),
+          range8(mono8 ? w * h : 0),
+          signal8(mono8 ? w * h : 0),
+          reflectivity8(mono8 ? w * h : 0),
+          noise8(mono8 ? w * h : 0) {}
+};
+
+/**
+ * Write destaggered images of the channels of a scan
+ * @param scan raw channels from batch_to_channels
+ * @param px_offset pixel offsets generated by get_px_offset
+ * @param images receives the images; 8-bit images are only written if not
+ * empty. Ranges too large for 16 bits saturate
+ */
+void make_images(const scan_channels& scan, const std::vector<int>& px_offset,
+                 scan_images& images);
+
+/**
+ * Make a function that batches destaggered images of a single scan
+ * (revolution) straight from lidar packets, without computing cartesian
+ * coordinates. The callback f() is invoked with the timestamp of the first
+ * column in the scan when the images of a scan are complete.
+ *
+ * @param W number of columns in the lidar scan. One of 512, 1024, or 2048.
+ * @param H number of rows in the lidar scan. 64 for the OS1 family of sensors.
+ * @param f callback invoked when batching a scan is done
+ * @return a function taking a lidar packet buffer and the scan_images to write
+ * when the scan is complete
+ */
+std::function<void(const uint8_t*, scan_images&)> batch_to_images(
+    int W, int H, std::function<void(uint64_t)> f);
+
+/**
+ * Make a function that batches a single scan to a random-access iterator using
+ * a double precision lookup table generated by make_xyz_lut. Equivalent to
+ * calling batch_to_iter with the single precision lookup table built from it,
+ * except that the iterator is taken by value as before, so callers pass the
+ * beginning of the scan to write on every call.
+ *
+ * @param xyz_lut a lookup table generated from make_xyz_lut, above
+ * @param W number of columns in the lidar scan. One of 512, 1024, or 2048.
+ * @param H number of rows in the lidar scan. 64 for the OS1 family of sensors.
+ */
+template <typename iterator_type, typename F, typename C>
+std::function<void(const uint8_t*, iterator_type it)> batch_to_iter(
+    const std::vector<double>& xyz_lut, int W, int H,
+    const typename std::iterator_traits<iterator_type>::value_type& empty,
+    C&& c, F&& f) {
+    OS1::xyz_lut lut{W, H, {}, {}, {}, {{0, 0, 0}}};
+    lut.x.resize(W * H);
+    lut.y.resize(W * H);
+    lut.z.resize(W * H);
+    for (int i = 0; i < W * H; i++) {
+        lut.x[i] = 0.001 * xyz_lut[3 * i + 0];
+        lut.y[i] = 0.001 * xyz_lut[3 * i + 1];
+        lut.z[i] = 0.001 * xyz_lut[3 * i + 2];
+    }
+    auto batch = batch_to_iter<iterator_type>(lut, empty, std::forward<C>(c),
+                                              std::forward<F>(f));
+    return [batch](const uint8_t* packet_buf, iterator_type it) mutable {
+        batch(packet_buf, it);
     };
 }
 }
@@ -0,0 +1,519 @@
+/**
+ * @file
+ * @brief Benchmarks of the decoding hot paths
+ *
+ * Runs every benchmark on synthetic packets of each lidar mode and, with
+ * --capture=<file>, on the lidar packets of a recorded capture. Besides the
+ * time per iteration, benchmarks report counters:
+ *   time/packet: time to batch one lidar packet
+ *   points/s: points decoded or projected per second
+ *   alloc_bytes/scan: bytes allocated with operator new per completed scan
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ouster/os1.h"
+#include "ouster/os1_capture.h"
+#include "ouster/os1_packet.h"
+#include "ouster/os1_util.h"
+
+#ifdef OUSTER_BENCH_LIDAR_SCAN
+#include "ouster/lidar_scan.h"
+#endif
+
+namespace OS1 = ouster::OS1;
+
+namespace {
+
+std::atomic<uint64_t> alloc_bytes{0};
+
+// same layout as PointOS1 in ouster_ros, without depending on PCL
+struct alignas(16) bench_point {
+    float x, y, z, pad;
+    float intensity;
+    uint32_t t;
+    uint16_t reflectivity;
+    uint8_t ring;
+    uint16_t noise;
+    uint32_t range;
+
+    static bench_point make(float x, float y, float z, float intensity,
+                            uint32_t t, uint16_t reflectivity, uint8_t ring,
+                            uint16_t noise, uint32_t range) {
+        return {x, y, z, 0.0, intensity, t, reflectivity, ring, noise, range};
+    }
+};
+
+// lidar packets of whole scans to benchmark with
+struct fixture {
+    std::string name;
+    int W;
+    int H;
+    std::vector<double> beam_azimuth_angles;
+    std::vector<double> beam_altitude_angles;
+    std::vector<uint8_t> buf;  // packets, lidar_packet_bytes apart
+    size_t n_packets;
+    int n_scans;
+
+    const uint8_t* packet(size_t i) const {
+        return buf.data() + (i % n_packets) * OS1::lidar_packet_bytes;
+    }
+};
+
+// scans of packets with every column valid and random pixel values
+fixture synthetic_fixture(OS1::lidar_mode mode, int n_scans) {
+    const int W = OS1::n_cols_of_lidar_mode(mode);
+    const int H = OS1::pixels_per_column;
+    const int hz = (mode == OS1::MODE_512x20 || mode == OS1::MODE_1024x20)
+                       ? 20
+                       : 10;
+    const uint64_t col_ns = 1000000000ULL / (hz * W);
+    const size_t per_scan = W / OS1::columns_per_buffer;
+
+    fixture res{OS1::to_string(mode) + "/synthetic",
+                W,
+                H,
+                OS1::beam_azimuth_angles,
+                OS1::beam_altitude_angles,
+                std::vector<uint8_t>(n_scans * per_scan *
+                                     OS1::lidar_packet_bytes),
+                n_scans * per_scan,
+                n_scans};
+
+    std::mt19937 gen{1};
+    for (size_t p = 0; p < res.n_packets; p++) {
+        uint8_t* pkt = res.buf.data() + p * OS1::lidar_packet_bytes;
+        for (int icol = 0; icol < OS1::columns_per_buffer; icol++) {
+            uint8_t* col = pkt + icol * OS1::column_bytes;
+            const uint16_t m_id = (p % per_scan) * OS1::columns_per_buffer +
+                                  icol;
+            const uint16_t f_id = p / per_scan;
+            const uint64_t ts = (f_id * W + m_id) * col_ns;
+            const uint32_t encoder = m_id * (OS1::encoder_ticks_per_rev / W);
+            const uint32_t valid = 0xffffffff;
+            std::memcpy(col, &ts, sizeof(ts));
+            std::memcpy(col + 8, &m_id, sizeof(m_id));
+            std::memcpy(col + 10, &f_id, sizeof(f_id));
+            std::memcpy(col + 12, &encoder, sizeof(encoder));
+            for (int ipx = 0; ipx < H; ipx++) {
+                uint8_t* px = col + 16 + ipx * OS1::pixel_bytes;
+                // about a tenth of returns are missing
+                const uint32_t range = gen() % 10 ? gen() % 120000 : 0;
+                const uint16_t vals[3] = {uint16_t(gen() % 4096),
+                                          uint16_t(gen() % 4096),
+                                          uint16_t(gen() % 1024)};
+                std::memcpy(px, &range, sizeof(range));
+                std::memcpy(px + 4, vals, sizeof(vals));
+            }
+            std::memcpy(col + 16 + H * OS1::pixel_bytes, &valid,
+                        sizeof(valid));
+        }
+    }
+    return res;
+}
+
+// the lidar packets of a capture, starting at its second frame
+bool capture_fixture(const std::string& path, fixture& res) {
+    auto cap = OS1::open_capture(path);
+    if (!cap) return false;
+
+    const auto info = OS1::parse_metadata(OS1::capture_metadata(*cap));
+    const auto& frames = OS1::capture_frames(*cap);
+    if (!info.mode || frames.size() < 3) {
+        std::cerr << "Capture needs metadata and at least 3 frames"
+                  << std::endl;
+        return false;
+    }
+
+    // the first and last frames are likely partial
+    res.name = OS1::to_string(info.mode) + "/capture";
+    res.W = OS1::n_cols_of_lidar_mode(info.mode);
+    res.H = OS1::pixels_per_column;
+    res.beam_azimuth_angles = info.beam_azimuth_angles.empty()
+                                  ? OS1::beam_azimuth_angles
+                                  : info.beam_azimuth_angles;
+    res.beam_altitude_angles = info.beam_altitude_angles.empty()
+                                   ? OS1::beam_altitude_angles
+                                   : info.beam_altitude_angles;
+    res.buf.clear();
+    res.n_packets = 0;
+    res.n_scans = frames.size() - 2;
+    for (size_t i = frames[1].first_packet; i < frames.back().first_packet;
+         i++) {
+        const OS1::capture_packet p = OS1::capture_packet_at(*cap, i);
+        if (p.type != OS1::LIDAR_PACKET) continue;
+        res.buf.insert(res.buf.end(), p.buf, p.buf + OS1::lidar_packet_bytes);
+        res.n_packets++;
+    }
+    return true;
+}
+
+OS1::xyz_lut fixture_lut(const fixture& fx) {
+    return OS1::make_xyz_lut(fx.W, fx.H, fx.beam_azimuth_angles,
+                             fx.beam_altitude_angles,
+                             OS1::lidar_to_sensor_transform);
+}
+
+// set the counters of a benchmark that batched packets into scans
+void report(benchmark::State& state, const fixture& fx, size_t packets,
+            int scans, uint64_t bytes) {
+    using benchmark::Counter;
+    state.counters["time/packet"] =
+        Counter(packets, Counter::kIsRate | Counter::kInvert);
+    state.counters["points/s"] =
+        Counter(packets * OS1::columns_per_buffer * fx.H, Counter::kIsRate);
+    state.counters["alloc_bytes/scan"] = scans ? double(bytes) / scans : 0;
+}
+
+// each iteration batches the packets of one scan
+
+void bm_batch_to_iter_cloud(benchmark::State& state, const fixture& fx) {
+    const auto lut = fixture_lut(fx);
+    std::vector<bench_point> cloud(fx.W * fx.H);
+    auto it = cloud.begin();
+    int scans = 0;
+    auto make = [](float x, float y, float z, float intensity, uint32_t t,
+                   uint16_t reflectivity, uint8_t ring, uint16_t noise,
+                   uint32_t range) {
+        return bench_point::make(x, y, z, intensity, t, reflectivity, ring,
+                                 noise, range);
+    };
+    auto batch = OS1::batch_to_iter<std::vector<bench_point>::iterator>(
+        lut, {}, make, [&](uint64_t) {
+            benchmark::DoNotOptimize(cloud.data());
+            scans++;
+        });
+
+    const size_t per_scan = fx.n_packets / fx.n_scans;
+    size_t i = 0;
+    const uint64_t bytes0 = alloc_bytes;
+    for (auto _ : state)
+        for (size_t end = i + per_scan; i < end; i++) batch(fx.packet(i), it);
+    report(state, fx, i, scans, alloc_bytes - bytes0);
+}
+
+// the same with the batcher type known at compile time, without the indirect
+// call through std::function per packet
+template <int W>
+void bm_scan_batcher_cloud(benchmark::State& state, const fixture& fx) {
+    const auto lut = fixture_lut(fx);
+    std::vector<bench_point> cloud(fx.W * fx.H);
+    auto it = cloud.begin();
+    int scans = 0;
+    auto make = [](float x, float y, float z, float intensity, uint32_t t,
+                   uint16_t reflectivity, uint8_t ring, uint16_t noise,
+                   uint32_t range) {
+        return bench_point::make(x, y, z, intensity, t, reflectivity, ring,
+                                 noise, range);
+    };
+    auto batch = OS1::make_scan_batcher<W, OS1::pixels_per_column,
+                                        std::vector<bench_point>::iterator>(
+        lut, {}, make, [&](uint64_t) {
+            benchmark::DoNotOptimize(cloud.data());
+            scans++;
+        });
+
+    const size_t per_scan = fx.n_packets / fx.n_scans;
+    size_t i = 0;
+    const uint64_t bytes0 = alloc_bytes;
+    for (auto _ : state)
+        for (size_t end = i + per_scan; i < end; i++) batch(fx.packet(i), it);
+    report(state, fx, i, scans, alloc_bytes - bytes0);
+}
+
+void bm_scan_batcher_cloud(benchmark::State& state, const fixture& fx) {
+    switch (fx.W) {
+        case 512:
+            return bm_scan_batcher_cloud<512>(state, fx);
+        case 1024:
+            return bm_scan_batcher_cloud<1024>(state, fx);
+        case 2048:
+            return bm_scan_batcher_cloud<2048>(state, fx);
+        default:
+            state.SkipWithError("unsupported scan width");
+    }
+}
+
+#ifdef OUSTER_BENCH_LIDAR_SCAN
+// batching into the scans of the visualizer through LidarScan::iterator, 48
+// bytes per point, or into the planes of CompactLidarScan with xyz
+template <typename S, typename C>
+void batch_to_scan(benchmark::State& state, const fixture& fx, S& ls,
+                   const typename S::iterator::value_type& empty, C make) {
+    const auto lut = fixture_lut(fx);
+    auto it = ls.begin();
+    int scans = 0;
+    auto batch = OS1::batch_to_iter<typename S::iterator>(
+        lut, empty, make, [&](uint64_t) {
+            benchmark::DoNotOptimize(&ls);
+            it = ls.begin();
+            scans++;
+        });
+
+    const size_t per_scan = fx.n_packets / fx.n_scans;
+    size_t i = 0;
+    const uint64_t bytes0 = alloc_bytes;
+    for (auto _ : state)
+        for (size_t end = i + per_scan; i < end; i++) batch(fx.packet(i), it);
+    report(state, fx, i, scans, alloc_bytes - bytes0);
+}
+
+void bm_batch_to_iter_lidar_scan(benchmark::State& state, const fixture& fx) {
+    ouster::LidarScan ls(fx.W, fx.H);
+    batch_to_scan(state, fx, ls, ouster::LidarScan::Point::Zero(),
+                  &ouster::LidarScan::make_val);
+}
+
+void bm_batch_to_iter_compact_scan(benchmark::State& state,
+                                   const fixture& fx) {
+    ouster::CompactLidarScan ls(fx.W, fx.H, true);
+    batch_to_scan(state, fx, ls, ouster::CompactLidarScan::Point{},
+                  &ouster::CompactLidarScan::make_val);
+}
+#endif
+
+void bm_batch_to_channels(benchmark::State& state, const fixture& fx) {
+    OS1::scan_channels scan{fx.W, fx.H};
+    int scans = 0;
+    auto batch = OS1::batch_to_channels([&](uint64_t) {
+        benchmark::DoNotOptimize(scan.range.data());
+        scans++;
+    });
+
+    const size_t per_scan = fx.n_packets / fx.n_scans;
+    size_t i = 0;
+    const uint64_t bytes0 = alloc_bytes;
+    for (auto _ : state)
+        for (size_t end = i + per_scan; i < end; i++) batch(fx.packet(i), scan);
+    report(state, fx, i, scans, alloc_bytes - bytes0);
+}
+
+// the packet mode of img_node
+void bm_batch_to_images(benchmark::State& state, const fixture& fx) {
+    OS1::scan_images images{fx.W, fx.H, 0, true};
+    int scans = 0;
+    auto batch = OS1::batch_to_images(fx.W, fx.H, [&](uint64_t) {
+        benchmark::DoNotOptimize(images.range.data());
+        scans++;
+    });
+
+    const size_t per_scan = fx.n_packets / fx.n_scans;
+    size_t i = 0;
+    const uint64_t bytes0 = alloc_bytes;
+    for (auto _ : state)
+        for (size_t end = i + per_scan; i < end; i++)
+            batch(fx.packet(i), images);
+    report(state, fx, i, scans, alloc_bytes - bytes0);
+}
+
+// each iteration processes one complete scan
+
+void bm_project_xyz(benchmark::State& state, const fixture& fx) {
+    const auto lut = fixture_lut(fx);
+    OS1::scan_channels scan{fx.W, fx.H};
+    auto batch = OS1::batch_to_channels([](uint64_t) {});
+    for (size_t i = 0; i < fx.n_packets; i++) batch(fx.packet(i), scan);
+
+    std::vector<float> x(fx.W * fx.H), y(fx.W * fx.H), z(fx.W * fx.H);
+    for (auto _ : state) {
+        OS1::project_xyz(lut, scan.range.data(), x.data(), y.data(),
+                         z.data());
+        benchmark::ClobberMemory();
+    }
+    state.counters["points/s"] = benchmark::Counter(
+        double(fx.W) * fx.H, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// the point cloud mode of img_node
+void bm_make_images(benchmark::State& state, const fixture& fx) {
+    OS1::scan_channels scan{fx.W, fx.H};
+    auto batch = OS1::batch_to_channels([](uint64_t) {});
+    for (size_t i = 0; i < fx.n_packets; i++) batch(fx.packet(i), scan);
+
+    const auto px_offset = OS1::get_px_offset(fx.W);
+    OS1::scan_images images{fx.W, fx.H, 0, true};
+    for (auto _ : state) {
+        OS1::make_images(scan, px_offset, images);
+        benchmark::ClobberMemory();
+    }
+    state.counters["points/s"] = benchmark::Counter(
+        double(fx.W) * fx.H, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void bm_make_xyz_lut(benchmark::State& state, const fixture& fx) {
+    for (auto _ : state) benchmark::DoNotOptimize(fixture_lut(fx));
+    state.counters["points/s"] = benchmark::Counter(
+        double(fx.W) * fx.H, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void bm_make_xyz_lut_double(benchmark::State& state, const fixture& fx) {
+    for (auto _ : state)
+        benchmark::DoNotOptimize(OS1::make_xyz_lut(
+            fx.W, fx.H, fx.beam_azimuth_angles, fx.beam_altitude_angles));
+    state.counters["points/s"] = benchmark::Counter(
+        double(fx.W) * fx.H, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void bm_get_px_offset(benchmark::State& state, const fixture& fx) {
+    for (auto _ : state) benchmark::DoNotOptimize(OS1::get_px_offset(fx.W));
+}
+
+void register_benchmarks(std::shared_ptr<const fixture> fx) {
+    using bm_fn = void (*)(benchmark::State&, const fixture&);
+    const std::pair<const char*, bm_fn> bms[] = {
+        {"batch_to_iter_cloud", bm_batch_to_iter_cloud},
+        {"scan_batcher_cloud", bm_scan_batcher_cloud},
+        {"batch_to_channels", bm_batch_to_channels},
+        {"batch_to_images", bm_batch_to_images},
+        {"project_xyz", bm_project_xyz},
+        {"make_images", bm_make_images},
+        {"make_xyz_lut", bm_make_xyz_lut},
+        {"make_xyz_lut_double", bm_make_xyz_lut_double},
+        {"get_px_offset", bm_get_px_offset},
+#ifdef OUSTER_BENCH_LIDAR_SCAN
+        {"batch_to_iter_lidar_scan", bm_batch_to_iter_lidar_scan},
+        {"batch_to_iter_compact_scan", bm_batch_to_iter_compact_scan},
+#endif
+    };
+
+    for (const auto& bm : bms) {
+        const bm_fn fn = bm.second;
+        benchmark::RegisterBenchmark(
+            (std::string{bm.first} + "/" + fx->name).c_str(),
+            [fx, fn](benchmark::State& state) { fn(state, *fx); });
+    }
+}
+}
+
+// count the bytes allocated by the benchmarked code. Every allocation and
+// deallocation function is replaced, so each new is paired with a matching
+// delete and array, nothrow and aligned allocations are counted too
+namespace {
+void* counted_alloc(size_t n) noexcept {
+    alloc_bytes.fetch_add(n, std::memory_order_relaxed);
+    return std::malloc(n ? n : 1);
+}
+
+void* counted_alloc_or_throw(size_t n) {
+    if (void* p = counted_alloc(n)) return p;
+    throw std::bad_alloc{};
+}
+}
+
+void* operator new(size_t n) { return counted_alloc_or_throw(n); }
+void* operator new[](size_t n) { return counted_alloc_or_throw(n); }
+void* operator new(size_t n, const std::nothrow_t&) noexcept {
+    return counted_alloc(n);
+}
+void* operator new[](size_t n, const std::nothrow_t&) noexcept {
+    return counted_alloc(n);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+#endif
+
+#ifdef __cpp_aligned_new
+namespace {
+void* counted_alloc(size_t n, std::align_val_t al) noexcept {
+    alloc_bytes.fetch_add(n, std::memory_order_relaxed);
+    const size_t a = std::max(static_cast<size_t>(al), sizeof(void*));
+    void* p = nullptr;
+    return posix_memalign(&p, a, n ? n : 1) == 0 ? p : nullptr;
+}
+
+void* counted_alloc_or_throw(size_t n, std::align_val_t al) {
+    if (void* p = counted_alloc(n, al)) return p;
+    throw std::bad_alloc{};
+}
+}
+
+void* operator new(size_t n, std::align_val_t al) {
+    return counted_alloc_or_throw(n, al);
+}
+void* operator new[](size_t n, std::align_val_t al) {
+    return counted_alloc_or_throw(n, al);
+}
+void* operator new(size_t n, std::align_val_t al,
+                   const std::nothrow_t&) noexcept {
+    return counted_alloc(n, al);
+}
+void* operator new[](size_t n, std::align_val_t al,
+                     const std::nothrow_t&) noexcept {
+    return counted_alloc(n, al);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::align_val_t,
+                     const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, std::align_val_t,
+                       const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+#endif
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+
+    std::string capture;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg.compare(0, 10, "--capture=") == 0) {
+            capture = arg.substr(10);
+        } else {
+            std::cerr << "Usage: ouster_bench [--capture=<file>] "
+                         "[benchmark options]"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    const OS1::lidar_mode modes[] = {OS1::MODE_512x10, OS1::MODE_512x20,
+                                     OS1::MODE_1024x10, OS1::MODE_1024x20,
+                                     OS1::MODE_2048x10};
+    for (OS1::lidar_mode mode : modes)
+        register_benchmarks(
+            std::make_shared<fixture>(synthetic_fixture(mode, 4)));
+
+    if (capture.size()) {
+        auto fx = std::make_shared<fixture>();
+        if (!capture_fixture(capture, *fx)) {
+            std::cerr << "Failed to read capture " << capture << std::endl;
+            return EXIT_FAILURE;
+        }
+        register_benchmarks(fx);
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return EXIT_SUCCESS;
+}
@@ -2,6 +2,7 @@
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <vector>
 
 #include "ouster/os1.h"
 #include "ouster/os1_packet.h"
@@ -60,20 +61,42 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    uint8_t lidar_buf[OS1::lidar_packet_bytes + 1];
+    auto poller = OS1::init_poller();
+    if (!poller || OS1::add_client(*poller, *cli) < 0) {
+        std::cerr << "Failed to set up event loop" << std::endl;
+        return 1;
+    }
+
+    // drain up to a full 2048x10 rotation's worth of packets per read
+    const size_t max_lidar_packets = 128;
+    std::vector<uint8_t> lidar_bufs(max_lidar_packets *
+                                    OS1::lidar_packet_bytes);
     uint8_t imu_buf[OS1::imu_packet_bytes + 1];
 
+    std::vector<OS1::client_state> states;
+
     print_headers();
 
     while (true) {
-        OS1::client_state st = OS1::poll_client(*cli);
+        OS1::client_state st = OS1::poll_clients(*poller, states);
         if (st & OS1::ERROR) {
             return 1;
-        } else if (st & OS1::LIDAR_DATA) {
-            if (OS1::read_lidar_packet(*cli, lidar_buf))
-                handle_lidar(lidar_buf);
-        } else if (st & OS1::IMU_DATA) {
-            if (OS1::read_imu_packet(*cli, imu_buf)) handle_imu(imu_buf);
+        }
+
+        // readiness is edge-triggered, so read until the sockets are empty
+        if (st & OS1::LIDAR_DATA) {
+            size_t n_received;
+            do {
+                const size_t n = OS1::read_lidar_packets(
+                    *cli, lidar_bufs.data(), max_lidar_packets, nullptr,
+                    &n_received);
+                for (size_t i = 0; i < n; i++)
+                    handle_lidar(lidar_bufs.data() +
+                                 i * OS1::lidar_packet_bytes);
+            } while (n_received == max_lidar_packets);
+        }
+        if (st & OS1::IMU_DATA) {
+            while (OS1::read_imu_packet(*cli, imu_buf)) handle_imu(imu_buf);
         }
 
         if (n_imu_packets % 50 == 0) print_stats();
@@ -1,6 +1,7 @@
 #include <json/json.h>
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cerrno>
 #include <chrono>
 #include <cstdio>
@@ -14,31 +15,76 @@
 
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
 #include <netdb.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
+#ifdef OS1_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
 #include "ouster/os1.h"
+#include "ouster/os1_metrics.h"
 #include "ouster/os1_packet.h"
+#include "ouster/os1_pipeline.h"
 
 namespace ouster {
 namespace OS1 {
 
 using ns = std::chrono::nanoseconds;
 
+struct uring;
+struct uring_socket;
+
 struct client {
     int lidar_fd;
     int imu_fd;
     Json::Value meta;
+    client_options opts;
+
+    // latest SO_RXQ_OVFL counts reported by the kernel
+    mutable std::atomic<uint32_t> lidar_drops{0};
+    mutable std::atomic<uint32_t> imu_drops{0};
+
+    // scratch space for read_lidar_packets, grown on demand
+    mutable std::vector<mmsghdr> msgs;
+    mutable std::vector<iovec> iovs;
+    mutable std::vector<uint8_t> ctrl;
+
+    // set while registered with an io_uring poller, which then receives
+    mutable uring_socket* lidar_uring = nullptr;
+    mutable uring_socket* imu_uring = nullptr;
+
     ~client() {
         close(lidar_fd);
         close(imu_fd);
     }
 };
 
+struct poller {
+    poller_mode mode = POLLER_EPOLL;
+    int epoll_fd = -1;
+    std::vector<const client*> clients;
+    std::vector<epoll_event> events;
+    std::unique_ptr<uring> ring;
+    ~poller();
+};
+
 namespace {
 
+// room for the control messages requested on data sockets
+const size_t ctrl_bytes =
+    CMSG_SPACE(sizeof(scm_timestamping)) + CMSG_SPACE(sizeof(uint32_t));
+
 const std::array<std::pair<lidar_mode, std::string>, 5> lidar_mode_strings = {
     {{MODE_512x10, "512x10"},
      {MODE_512x20, "512x20"},
@@ -46,7 +92,80 @@ const std::array<std::pair<lidar_mode, std::string>, 5> lidar_mode_strings = {
      {MODE_1024x20, "1024x20"},
      {MODE_2048x10, "2048x10"}}};
 
-int udp_data_socket(int port) {
+void set_udp_sockopt(int sock_fd, int opt, int val, const char* name) {
+    if (setsockopt(sock_fd, SOL_SOCKET, opt, &val, sizeof(val)) < 0)
+        std::cerr << "udp setsockopt(" << name
+                  << "): " << std::strerror(errno) << std::endl;
+}
+
+// failures are reported but not fatal: the socket still works with defaults
+void tune_udp_socket(int sock_fd, const client_options& opts) {
+    set_udp_sockopt(sock_fd, SO_RXQ_OVFL, 1, "SO_RXQ_OVFL");
+
+    if (opts.rcvbuf_bytes > 0) {
+        // SO_RCVBUFFORCE may exceed net.core.rmem_max, but needs CAP_NET_ADMIN
+        int val = opts.rcvbuf_bytes;
+        if (setsockopt(sock_fd, SOL_SOCKET, SO_RCVBUFFORCE, &val,
+                       sizeof(val)) < 0)
+            set_udp_sockopt(sock_fd, SO_RCVBUF, val, "SO_RCVBUF");
+
+        // the kernel reports double the usable size
+        socklen_t len = sizeof(val);
+        if (getsockopt(sock_fd, SOL_SOCKET, SO_RCVBUF, &val, &len) == 0 &&
+            val / 2 < opts.rcvbuf_bytes)
+            std::cerr << "udp SO_RCVBUF limited to " << val / 2
+                      << " bytes; check net.core.rmem_max" << std::endl;
+    }
+
+    if (opts.busy_poll_us > 0)
+        set_udp_sockopt(sock_fd, SO_BUSY_POLL, opts.busy_poll_us,
+                        "SO_BUSY_POLL");
+
+    switch (opts.timestamps) {
+        case TIMESTAMP_SOFTWARE:
+            set_udp_sockopt(sock_fd, SO_TIMESTAMPNS, 1, "SO_TIMESTAMPNS");
+            break;
+        case TIMESTAMP_HARDWARE:
+            set_udp_sockopt(sock_fd, SO_TIMESTAMPING,
+                            SOF_TIMESTAMPING_RX_HARDWARE |
+                                SOF_TIMESTAMPING_RAW_HARDWARE |
+                                SOF_TIMESTAMPING_RX_SOFTWARE |
+                                SOF_TIMESTAMPING_SOFTWARE,
+                            "SO_TIMESTAMPING");
+            break;
+        default:
+            break;
+    }
+}
+
+// extract the receive timestamp and kernel drop count from a received message
+void parse_cmsgs(msghdr& hdr, uint64_t* ts_ns, std::atomic<uint32_t>& drops) {
+    for (cmsghdr* c = CMSG_FIRSTHDR(&hdr); c != NULL;
+         c = CMSG_NXTHDR(&hdr, c)) {
+        if (c->cmsg_level != SOL_SOCKET) continue;
+
+        if (c->cmsg_type == SCM_TIMESTAMPNS && ts_ns) {
+            timespec t;
+            memcpy(&t, CMSG_DATA(c), sizeof(t));
+            *ts_ns = t.tv_sec * 1000000000ULL + t.tv_nsec;
+        } else if (c->cmsg_type == SCM_TIMESTAMPING && ts_ns) {
+            // ts[2] is the raw hardware timestamp, ts[0] the software one
+            scm_timestamping t;
+            memcpy(&t, CMSG_DATA(c), sizeof(t));
+            const timespec& hw = t.ts[2];
+            const timespec& sel = (hw.tv_sec || hw.tv_nsec) ? hw : t.ts[0];
+            *ts_ns = sel.tv_sec * 1000000000ULL + sel.tv_nsec;
+        } else if (c->cmsg_type == SO_RXQ_OVFL) {
+            // the kernel reports the total dropped on the socket so far
+            uint32_t n;
+            memcpy(&n, CMSG_DATA(c), sizeof(n));
+            const uint32_t prev = drops.exchange(n, std::memory_order_relaxed);
+            if (n > prev) count_metric(METRIC_DROPPED_PACKETS, n - prev);
+        }
+    }
+}
+
+int udp_data_socket(int port, const client_options& opts) {
     struct addrinfo hints, *info_start, *ai;
 
     memset(&hints, 0, sizeof hints);
@@ -94,6 +213,8 @@ int udp_data_socket(int port) {
         return -1;
     }
 
+    tune_udp_socket(sock_fd, opts);
+
     return sock_fd;
 }
 
@@ -138,43 +259,474 @@ int cfg_socket(const char* addr) {
     return sock_fd;
 }
 
-bool do_tcp_cmd(int sock_fd, const std::vector<std::string>& cmd_tokens,
-                std::string& res) {
-    const size_t max_res_len = 16 * 1024;
-    auto read_buf = std::unique_ptr<char[]>{new char[max_res_len + 1]};
+// the ipv4 address a hostname resolves to, as the sensor reports its udp_ip,
+// or the hostname itself if it does not resolve
+std::string resolve_ipv4(const std::string& host) {
+    struct addrinfo hints, *info;
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host.c_str(), NULL, &hints, &info) != 0) return host;
 
-    std::stringstream ss;
-    for (const auto& token : cmd_tokens) ss << token << " ";
-    ss << "\n";
-    std::string cmd = ss.str();
+    char buf[INET_ADDRSTRLEN];
+    const auto* sin = reinterpret_cast<const sockaddr_in*>(info->ai_addr);
+    const bool ok = inet_ntop(AF_INET, &sin->sin_addr, buf, sizeof buf);
+    freeaddrinfo(info);
+    return ok ? std::string{buf} : host;
+}
 
-    ssize_t len = write(sock_fd, cmd.c_str(), cmd.length());
-    if (len != (ssize_t)cmd.length()) {
-        return false;
+// connection to the configuration server of the sensor. Responses are single
+// lines read from a buffer kept across commands, so that several commands can
+// be sent before reading their responses
+struct tcp_session {
+    int fd;
+    std::string buf;  // received data following the last response
+};
+
+bool send_tcp_cmds(tcp_session& s,
+                   const std::vector<std::vector<std::string>>& cmds) {
+    std::string msg;
+    for (const auto& cmd_tokens : cmds) {
+        for (const auto& token : cmd_tokens) msg.append(token).append(" ");
+        msg.append("\n");
     }
 
-    // need to synchronize with server by reading response
-    std::stringstream read_ss;
-    do {
-        len = read(sock_fd, read_buf.get(), max_res_len);
-        if (len < 0) {
-            return false;
-        }
-        read_buf.get()[len] = '\0';
-        read_ss << read_buf.get();
-    } while (len > 0 && read_buf.get()[len - 1] != '\n');
+    for (size_t off = 0; off < msg.size();) {
+        ssize_t len = write(s.fd, msg.data() + off, msg.size() - off);
+        if (len <= 0) return false;
+        off += len;
+    }
+    return true;
+}
+
+bool read_tcp_res(tcp_session& s, std::string& res) {
+    char read_buf[4096];
+
+    size_t eol;
+    size_t searched = 0;
+    while ((eol = s.buf.find('\n', searched)) == std::string::npos) {
+        searched = s.buf.size();
+        ssize_t len = read(s.fd, read_buf, sizeof(read_buf));
+        if (len <= 0) return false;
+        s.buf.append(read_buf, len);
+    }
 
-    res = read_ss.str();
+    res.assign(s.buf, 0, eol);
     res.erase(res.find_last_not_of(" \r\n\t") + 1);
+    s.buf.erase(0, eol + 1);
 
     return true;
 }
 
+bool do_tcp_cmd(tcp_session& s, const std::vector<std::string>& cmd_tokens,
+                std::string& res) {
+    // need to synchronize with server by reading response
+    return send_tcp_cmds(s, {cmd_tokens}) && read_tcp_res(s, res);
+}
+
+// values of the active config may be strings or numbers depending on firmware
+std::string config_param_string(const Json::Value& v) {
+    return v.isString() || v.isNumeric() ? v.asString() : std::string{};
+}
+
 void update_json_obj(Json::Value& dst, const Json::Value& src) {
     for (const auto& key : src.getMemberNames()) dst[key] = src[key];
 }
 }
 
+#ifdef OS1_HAVE_IO_URING
+// receive buffers registered per data socket: a bit over two rotations of
+// 2048x10 for lidar, where the socket receive buffer also covers the time a
+// drained ring takes to be refilled, and a few for imu
+const uint16_t uring_lidar_buffers = 256;
+const uint16_t uring_imu_buffers = 16;
+
+// completions are bounded by the registered buffers; more than this many are
+// kept by the kernel (IORING_FEAT_NODROP) until they fit
+const unsigned uring_sq_entries = 64;
+const unsigned uring_cq_entries = 4096;
+
+// a data socket receiving with a multishot recvmsg into its buffer ring
+struct uring_socket {
+    int fd;
+    size_t packet_bytes;
+    std::atomic<uint32_t>* drops;
+    metric_counter packets;
+    client_state ready;
+
+    // sizes of the name and control areas at the start of every buffer, read
+    // by the kernel when the receive is armed
+    msghdr hdr;
+    bool armed = false;
+    bool failed = false;
+
+    // the ring registered as buffer group bgid, followed by n_bufs buffers of
+    // buf_bytes each, in one mapping
+    uint16_t bgid;
+    uint16_t n_bufs;
+    uint16_t tail = 0;
+    size_t buf_bytes;
+    size_t ring_bytes;
+    size_t map_bytes;
+    uint8_t* map = nullptr;
+
+    // ids of received buffers not read yet, in order of arrival
+    std::vector<uint16_t> done;
+    size_t done_head = 0;
+    size_t n_done = 0;
+
+    // entries of the ring, whose tail overlays the reserved field of the
+    // first; not io_uring_buf_ring::bufs, which c++ offsets by an empty struct
+    io_uring_buf* entries() { return (io_uring_buf*)map; }
+    uint16_t* ring_tail() { return &((io_uring_buf_ring*)map)->tail; }
+    uint8_t* buf(uint16_t bid) { return map + ring_bytes + bid * buf_bytes; }
+
+    ~uring_socket() {
+        if (map) munmap(map, map_bytes);
+    }
+};
+
+struct uring {
+    int fd = -1;
+    io_uring_params params;
+
+    // the submission and completion rings share one mapping
+    uint8_t* rings = nullptr;
+    size_t rings_bytes = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_bytes = 0;
+    unsigned n_unsubmitted = 0;
+
+    // indexed by the user data of completions: 2 * client + 1 for imu
+    std::vector<std::unique_ptr<uring_socket>> sockets;
+
+    // head, tail, mask and array fields at the offsets reported by setup
+    unsigned* field(uint32_t off) { return (unsigned*)(rings + off); }
+    io_uring_cqe* cqes() { return (io_uring_cqe*)(rings + params.cq_off.cqes); }
+
+    ~uring();
+};
+
+namespace {
+
+int uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                unsigned flags, const void* arg, size_t arg_bytes) {
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                   arg, arg_bytes);
+}
+
+int uring_register(int fd, unsigned opcode, const void* arg, unsigned n) {
+    return syscall(__NR_io_uring_register, fd, opcode, arg, n);
+}
+
+// multishot recvmsg into buffer rings came with zero copy sends in linux 6.0,
+// which the opcode probe can report
+bool uring_supported(int fd) {
+    const size_t n_ops = IORING_OP_SEND_ZC + 1;
+    std::vector<uint8_t> mem(sizeof(io_uring_probe) +
+                             n_ops * sizeof(io_uring_probe_op));
+    auto probe = (io_uring_probe*)mem.data();
+    if (uring_register(fd, IORING_REGISTER_PROBE, probe, n_ops) < 0)
+        return false;
+
+    auto supported = [&](unsigned op) {
+        return op <= probe->last_op && op < probe->ops_len &&
+               (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    };
+    return supported(IORING_OP_RECVMSG) && supported(IORING_OP_SEND_ZC);
+}
+
+// set up a ring, or return null without logging if the kernel lacks support
+std::unique_ptr<uring> init_uring() {
+    std::unique_ptr<uring> r{new uring};
+    memset(&r->params, 0, sizeof(r->params));
+    r->params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+    r->params.cq_entries = uring_cq_entries;
+
+    r->fd = syscall(__NR_io_uring_setup, uring_sq_entries, &r->params);
+    if (r->fd < 0) return std::unique_ptr<uring>();
+
+    const unsigned needed =
+        IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((r->params.features & needed) != needed || !uring_supported(r->fd))
+        return std::unique_ptr<uring>();
+
+    const io_uring_params& p = r->params;
+    r->rings_bytes =
+        std::max<size_t>(p.sq_off.array + p.sq_entries * sizeof(unsigned),
+                         p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe));
+    void* rings = mmap(NULL, r->rings_bytes, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (rings == MAP_FAILED) return std::unique_ptr<uring>();
+    r->rings = (uint8_t*)rings;
+
+    r->sqes_bytes = p.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(NULL, r->sqes_bytes, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) return std::unique_ptr<uring>();
+    r->sqes = (io_uring_sqe*)sqes;
+
+    return r;
+}
+
+// hand a buffer back to the kernel, without a system call
+void uring_recycle(uring_socket& s, uint16_t bid) {
+    io_uring_buf& b = s.entries()[s.tail & (s.n_bufs - 1)];
+    b.addr = (uint64_t)(uintptr_t)s.buf(bid);
+    b.len = s.buf_bytes;
+    b.bid = bid;
+    s.tail++;
+    __atomic_store_n(s.ring_tail(), s.tail, __ATOMIC_RELEASE);
+}
+
+// queue a multishot recvmsg on a socket, submitted when polling
+bool uring_arm(uring& r, uring_socket& s) {
+    if (r.n_unsubmitted == r.params.sq_entries) {
+        if (uring_enter(r.fd, r.n_unsubmitted, 0, 0, NULL, 0) < 0) {
+            std::cerr << "io_uring_enter: " << std::strerror(errno)
+                      << std::endl;
+            return false;
+        }
+        r.n_unsubmitted = 0;
+    }
+
+    const io_uring_params& p = r.params;
+    const unsigned tail = *r.field(p.sq_off.tail);
+    const unsigned idx = tail & *r.field(p.sq_off.ring_mask);
+
+    io_uring_sqe& sqe = r.sqes[idx];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_RECVMSG;
+    sqe.fd = s.fd;
+    sqe.addr = (uint64_t)(uintptr_t)&s.hdr;
+    sqe.ioprio = IORING_RECV_MULTISHOT;
+    sqe.flags = IOSQE_BUFFER_SELECT;
+    sqe.buf_group = s.bgid;
+    sqe.user_data = s.bgid;
+
+    r.field(p.sq_off.array)[idx] = idx;
+    __atomic_store_n(r.field(p.sq_off.tail), tail + 1, __ATOMIC_RELEASE);
+    r.n_unsubmitted++;
+    s.armed = true;
+    return true;
+}
+
+// register a buffer ring for a socket, whose receive is armed by the next poll
+uring_socket* uring_add_socket(uring& r, int fd, size_t packet_bytes,
+                               uint16_t n_bufs, std::atomic<uint32_t>& drops,
+                               metric_counter packets, client_state ready) {
+    std::unique_ptr<uring_socket> s{new uring_socket};
+    s->fd = fd;
+    s->packet_bytes = packet_bytes;
+    s->drops = &drops;
+    s->packets = packets;
+    s->ready = ready;
+
+    memset(&s->hdr, 0, sizeof(s->hdr));
+    s->hdr.msg_controllen = ctrl_bytes;
+
+    // buffers start with io_uring_recvmsg_out, then the control messages
+    const size_t page = sysconf(_SC_PAGESIZE);
+    s->bgid = r.sockets.size();
+    s->n_bufs = n_bufs;
+    s->buf_bytes =
+        (sizeof(io_uring_recvmsg_out) + ctrl_bytes + packet_bytes + 63) & ~63;
+    s->ring_bytes = (n_bufs * sizeof(io_uring_buf) + page - 1) & ~(page - 1);
+    s->map_bytes = s->ring_bytes + n_bufs * s->buf_bytes;
+
+    void* map = mmap(NULL, s->map_bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (map == MAP_FAILED) {
+        std::cerr << "mmap: " << std::strerror(errno) << std::endl;
+        return nullptr;
+    }
+    s->map = (uint8_t*)map;
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)s->map;
+    reg.ring_entries = n_bufs;
+    reg.bgid = s->bgid;
+    if (uring_register(r.fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        std::cerr << "io_uring_register: " << std::strerror(errno)
+                  << std::endl;
+        return nullptr;
+    }
+
+    s->done.resize(n_bufs);
+    for (uint16_t bid = 0; bid < n_bufs; bid++) uring_recycle(*s, bid);
+
+    r.sockets.push_back(std::move(s));
+    return r.sockets.back().get();
+}
+
+// undo the last uring_add_socket, before its receive is armed
+void uring_remove_socket(uring& r) {
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.bgid = r.sockets.back()->bgid;
+    uring_register(r.fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    r.sockets.pop_back();
+}
+
+// queue the buffers of completed receives on their sockets
+void uring_reap(uring& r) {
+    const io_uring_params& p = r.params;
+    unsigned* head_p = r.field(p.cq_off.head);
+    unsigned head = *head_p;
+    const unsigned tail =
+        __atomic_load_n(r.field(p.cq_off.tail), __ATOMIC_ACQUIRE);
+    const unsigned mask = *r.field(p.cq_off.ring_mask);
+
+    for (; head != tail; head++) {
+        const io_uring_cqe& cqe = r.cqes()[head & mask];
+        uring_socket& s = *r.sockets[cqe.user_data];
+
+        // a multishot receive ends on errors, including running out of
+        // buffers, and is armed again on the next poll
+        if (!(cqe.flags & IORING_CQE_F_MORE)) s.armed = false;
+
+        const uint16_t bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+        if ((cqe.flags & IORING_CQE_F_BUFFER) && cqe.res >= 0) {
+            s.done[(s.done_head + s.n_done) & (s.n_bufs - 1)] = bid;
+            s.n_done++;
+        } else if (cqe.flags & IORING_CQE_F_BUFFER) {
+            uring_recycle(s, bid);
+        }
+
+        if (cqe.res < 0 && cqe.res != -ENOBUFS) {
+            std::cerr << "io_uring recvmsg: " << std::strerror(-cqe.res)
+                      << std::endl;
+            s.failed = true;
+        }
+    }
+    __atomic_store_n(head_p, head, __ATOMIC_RELEASE);
+}
+
+client_state uring_poll(poller& p, std::vector<client_state>& states,
+                        const int timeout_ms) {
+    uring& r = *p.ring;
+
+    // arm new receives and those that ended once they have buffers again
+    for (auto& s : r.sockets)
+        if (!s->armed && !s->failed && s->n_done < s->n_bufs &&
+            !uring_arm(r, *s))
+            return ERROR;
+
+    uring_reap(r);
+    bool pending = false;
+    for (auto& s : r.sockets) pending = pending || s->n_done || s->failed;
+
+    // no system call when completions are already waiting to be read
+    const bool wait = !pending && timeout_ms != 0;
+    if (wait || r.n_unsubmitted) {
+        __kernel_timespec ts;
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+
+        io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts = timeout_ms < 0 ? 0 : (uint64_t)(uintptr_t)&ts;
+
+        unsigned flags = IORING_ENTER_EXT_ARG;
+        if (wait) flags |= IORING_ENTER_GETEVENTS;
+        int n = uring_enter(r.fd, r.n_unsubmitted, wait ? 1 : 0, flags, &arg,
+                            sizeof(arg));
+        if (n >= 0) {
+            r.n_unsubmitted -= std::min<unsigned>(n, r.n_unsubmitted);
+        } else if (errno == EINTR) {
+            return EXIT;
+        } else if (errno != ETIME && errno != EBUSY && errno != EAGAIN) {
+            std::cerr << "io_uring_enter: " << std::strerror(errno)
+                      << std::endl;
+            return ERROR;
+        }
+        uring_reap(r);
+    }
+
+    client_state res = client_state(0);
+    for (size_t i = 0; i < r.sockets.size(); i++) {
+        const uring_socket& s = *r.sockets[i];
+        client_state& st = states[i / 2];
+        if (s.failed) st = client_state(st | ERROR);
+        if (s.n_done) st = client_state(st | s.ready);
+        res = client_state(res | st);
+    }
+    return res;
+}
+
+// copy up to max_n received datagrams of packet_bytes out of their buffers,
+// like recvmmsg
+size_t uring_read(uring_socket& s, uint8_t* bufs, size_t max_n,
+                  uint64_t* ts_ns, size_t* n_received) {
+    size_t n = 0;
+    size_t n_valid = 0;
+    for (; n < max_n && s.n_done; n++) {
+        const uint16_t bid = s.done[s.done_head];
+        s.done_head = (s.done_head + 1) & (s.n_bufs - 1);
+        s.n_done--;
+
+        uint8_t* buf = s.buf(bid);
+        io_uring_recvmsg_out out;
+        memcpy(&out, buf, sizeof(out));
+        if (out.payloadlen != s.packet_bytes || (out.flags & MSG_TRUNC)) {
+            count_metric(METRIC_MALFORMED_PACKETS);
+            std::cerr << "Unexpected udp packet length: " << out.payloadlen
+                      << std::endl;
+            uring_recycle(s, bid);
+            continue;
+        }
+
+        msghdr hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_control = buf + sizeof(out);
+        hdr.msg_controllen = out.controllen;
+
+        uint64_t ts = 0;
+        parse_cmsgs(hdr, &ts, *s.drops);
+        if (ts_ns) ts_ns[n_valid] = ts;
+
+        memcpy(bufs + n_valid * s.packet_bytes,
+               buf + sizeof(out) + ctrl_bytes, s.packet_bytes);
+        uring_recycle(s, bid);
+        n_valid++;
+    }
+
+    if (n_received) *n_received = n;
+    count_metric(s.packets, n_valid);
+    return n_valid;
+}
+}
+
+uring::~uring() {
+    // stop the receives before unmapping the buffers they write to
+    if (fd >= 0) {
+        io_uring_sync_cancel_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.fd = -1;
+        reg.flags = IORING_ASYNC_CANCEL_ANY;
+        reg.timeout.tv_sec = -1;
+        reg.timeout.tv_nsec = -1;
+        uring_register(fd, IORING_REGISTER_SYNC_CANCEL, &reg, 1);
+        close(fd);
+    }
+    if (sqes) munmap(sqes, sqes_bytes);
+    if (rings) munmap(rings, rings_bytes);
+}
+#else
+struct uring {};
+struct uring_socket {};
+#endif
+
+poller::~poller() {
+    for (const client* c : clients) {
+        c->lidar_uring = nullptr;
+        c->imu_uring = nullptr;
+    }
+    if (epoll_fd >= 0) close(epoll_fd);
+}
+
 std::string to_string(version v) {
     if (v == invalid_version) return "UNKNOWN";
 
@@ -282,21 +834,23 @@ sensor_info parse_metadata(const std::string& meta) {
     return info;
 }
 
-std::shared_ptr<client> init_client(int lidar_port, int imu_port) {
+std::shared_ptr<client> init_client(int lidar_port, int imu_port,
+                                    const client_options& opts) {
     auto cli = std::make_shared<client>();
 
-    int lidar_fd = udp_data_socket(lidar_port);
-    int imu_fd = udp_data_socket(imu_port);
+    int lidar_fd = udp_data_socket(lidar_port, opts);
+    int imu_fd = udp_data_socket(imu_port, opts);
     cli->lidar_fd = lidar_fd;
     cli->imu_fd = imu_fd;
+    cli->opts = opts;
     return cli;
 }
 
 std::shared_ptr<client> init_client(const std::string& hostname,
                                     const std::string& udp_dest_host,
                                     lidar_mode mode, int lidar_port,
-                                    int imu_port) {
-    auto cli = init_client(lidar_port, imu_port);
+                                    int imu_port, const client_options& opts) {
+    auto cli = init_client(lidar_port, imu_port, opts);
 
     int sock_fd = cfg_socket(hostname.c_str());
 
@@ -307,47 +861,48 @@ std::shared_ptr<client> init_client(const std::string& hostname,
 
     if (sock_fd < 0) return std::shared_ptr<client>();
 
+    tcp_session s{sock_fd, {}};
     std::string res;
     bool success = true;
 
     success &=
-        do_tcp_cmd(sock_fd, {"set_config_param", "udp_ip", udp_dest_host}, res);
+        do_tcp_cmd(s, {"set_config_param", "udp_ip", udp_dest_host}, res);
     success &= res == "set_config_param";
 
-    success &= do_tcp_cmd(sock_fd, {"set_config_param", "udp_port_lidar",
+    success &= do_tcp_cmd(s, {"set_config_param", "udp_port_lidar",
                                     std::to_string(lidar_port)},
                           res);
     success &= res == "set_config_param";
 
     success &= do_tcp_cmd(
-        sock_fd, {"set_config_param", "udp_port_imu", std::to_string(imu_port)},
+        s, {"set_config_param", "udp_port_imu", std::to_string(imu_port)},
         res);
     success &= res == "set_config_param";
 
     success &= do_tcp_cmd(
-        sock_fd, {"set_config_param", "lidar_mode", to_string(mode)}, res);
+        s, {"set_config_param", "lidar_mode", to_string(mode)}, res);
     success &= res == "set_config_param";
 
-    success &= do_tcp_cmd(sock_fd, {"get_sensor_info"}, res);
+    success &= do_tcp_cmd(s, {"get_sensor_info"}, res);
     success &= reader->parse(res.c_str(), res.c_str() + res.size(), &cli->meta,
                              &errors);
 
-    success &= do_tcp_cmd(sock_fd, {"get_beam_intrinsics"}, res);
+    success &= do_tcp_cmd(s, {"get_beam_intrinsics"}, res);
     success &=
         reader->parse(res.c_str(), res.c_str() + res.size(), &root, &errors);
     update_json_obj(cli->meta, root);
 
-    success &= do_tcp_cmd(sock_fd, {"get_imu_intrinsics"}, res);
+    success &= do_tcp_cmd(s, {"get_imu_intrinsics"}, res);
     success &=
         reader->parse(res.c_str(), res.c_str() + res.size(), &root, &errors);
     update_json_obj(cli->meta, root);
 
-    success &= do_tcp_cmd(sock_fd, {"get_lidar_intrinsics"}, res);
+    success &= do_tcp_cmd(s, {"get_lidar_intrinsics"}, res);
     success &=
         reader->parse(res.c_str(), res.c_str() + res.size(), &root, &errors);
     update_json_obj(cli->meta, root);
 
-    success &= do_tcp_cmd(sock_fd, {"reinitialize"}, res);
+    success &= do_tcp_cmd(s, {"reinitialize"}, res);
     success &= res == "reinitialize";
 
     close(sock_fd);
@@ -359,6 +914,100 @@ std::shared_ptr<client> init_client(const std::string& hostname,
     return success ? cli : std::shared_ptr<client>();
 }
 
+std::shared_ptr<client> init_client_fast(const std::string& hostname,
+                                         const std::string& udp_dest_host,
+                                         const std::string& cached_metadata,
+                                         lidar_mode mode, int lidar_port,
+                                         int imu_port,
+                                         const client_options& opts) {
+    auto cli = init_client(lidar_port, imu_port, opts);
+
+    int sock_fd = cfg_socket(hostname.c_str());
+    if (sock_fd < 0) return std::shared_ptr<client>();
+
+    Json::CharReaderBuilder builder{};
+    auto reader = std::unique_ptr<Json::CharReader>{builder.newCharReader()};
+    std::string errors{};
+    auto parse = [&](const std::string& text, Json::Value& root) {
+        return reader->parse(text.c_str(), text.c_str() + text.size(), &root,
+                             &errors);
+    };
+
+    tcp_session s{sock_fd, {}};
+    std::string res;
+    Json::Value active{};
+
+    // the first round trip finds what the sensor is and how it is configured
+    bool success =
+        send_tcp_cmds(s, {{"get_config_param", "active"}, {"get_sensor_info"}});
+    success = success && read_tcp_res(s, res) && parse(res, active);
+    success = success && read_tcp_res(s, res) && parse(res, cli->meta);
+    if (!success) {
+        close(sock_fd);
+        return std::shared_ptr<client>();
+    }
+
+    // the second sends everything else at once: only the parameters that
+    // differ from the active config, followed by a reinitialize if any do.
+    // The destination is compared and sent as an address, as the sensor
+    // reports it
+    const std::vector<std::pair<std::string, std::string>> params = {
+        {"udp_ip", resolve_ipv4(udp_dest_host)},
+        {"udp_port_lidar", std::to_string(lidar_port)},
+        {"udp_port_imu", std::to_string(imu_port)},
+        {"lidar_mode", to_string(mode)}};
+
+    std::vector<std::vector<std::string>> cmds;
+    for (const auto& p : params)
+        if (config_param_string(active[p.first]) != p.second)
+            cmds.push_back({"set_config_param", p.first, p.second});
+    const bool reinitialize = !cmds.empty();
+
+    // intrinsics only change with the sensor or its firmware
+    const std::vector<std::string> intrinsics = {
+        "beam_altitude_angles", "beam_azimuth_angles",
+        "imu_to_sensor_transform", "lidar_to_sensor_transform"};
+
+    Json::Value cached{};
+    bool use_cached = !cached_metadata.empty() &&
+                      parse(cached_metadata, cached) && cached.isObject() &&
+                      cached["prod_sn"] == cli->meta["prod_sn"] &&
+                      cached["build_rev"] == cli->meta["build_rev"];
+    for (const auto& key : intrinsics)
+        use_cached = use_cached && cached[key].isArray();
+
+    if (use_cached) {
+        for (const auto& key : intrinsics) cli->meta[key] = cached[key];
+    } else {
+        cmds.push_back({"get_beam_intrinsics"});
+        cmds.push_back({"get_imu_intrinsics"});
+        cmds.push_back({"get_lidar_intrinsics"});
+    }
+
+    if (reinitialize) cmds.push_back({"reinitialize"});
+
+    success = cmds.empty() || send_tcp_cmds(s, cmds);
+    for (size_t i = 0; success && i < cmds.size(); i++) {
+        success = read_tcp_res(s, res);
+        const std::string& cmd = cmds[i][0];
+        if (cmd == "set_config_param" || cmd == "reinitialize") {
+            success = success && res == cmd;
+        } else {
+            Json::Value root{};
+            success = success && parse(res, root);
+            update_json_obj(cli->meta, root);
+        }
+    }
+
+    close(sock_fd);
+
+    // merge extra info into metadata
+    cli->meta["hostname"] = hostname;
+    cli->meta["lidar_mode"] = to_string(mode);
+
+    return success ? cli : std::shared_ptr<client>();
+}
+
 client_state poll_client(const client& c, const int timeout_sec) {
     fd_set rfds;
     FD_ZERO(&rfds);
@@ -386,23 +1035,249 @@ client_state poll_client(const client& c, const int timeout_sec) {
     return res;
 }
 
-static bool recv_fixed(int fd, void* buf, size_t len) {
-    ssize_t n = recvfrom(fd, buf, len + 1, 0, NULL, NULL);
-    if (n == (ssize_t)len)
+std::shared_ptr<poller> init_poller(const poller_mode mode) {
+    auto p = std::make_shared<poller>();
+
+    if (mode != POLLER_EPOLL) {
+#ifdef OS1_HAVE_IO_URING
+        p->ring = init_uring();
+#endif
+        if (p->ring) {
+            p->mode = POLLER_IO_URING;
+            return p;
+        } else if (mode == POLLER_IO_URING) {
+            std::cerr << "init_poller: io_uring is not available" << std::endl;
+            return std::shared_ptr<poller>();
+        }
+    }
+
+    int fd = epoll_create1(EPOLL_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "epoll_create1: " << std::strerror(errno) << std::endl;
+        return std::shared_ptr<poller>();
+    }
+
+    p->epoll_fd = fd;
+    return p;
+}
+
+poller_mode get_poller_mode(const poller& p) { return p.mode; }
+
+int add_client(poller& p, const client& cli) {
+    // the sockets of a client receiving with io_uring are drained by the ring
+    if (cli.lidar_uring || cli.imu_uring) {
+        std::cerr << "add_client: client already receives with io_uring"
+                  << std::endl;
+        return -1;
+    }
+
+    // event data: client index in the high bits, low bit set for imu
+    const uint64_t idx = p.clients.size();
+
+#ifdef OS1_HAVE_IO_URING
+    if (p.ring) {
+        uring& r = *p.ring;
+        uring_socket* lidar = uring_add_socket(
+            r, cli.lidar_fd, lidar_packet_bytes, uring_lidar_buffers,
+            cli.lidar_drops, METRIC_LIDAR_PACKETS, LIDAR_DATA);
+        if (!lidar) return -1;
+
+        uring_socket* imu = uring_add_socket(
+            r, cli.imu_fd, imu_packet_bytes, uring_imu_buffers,
+            cli.imu_drops, METRIC_IMU_PACKETS, IMU_DATA);
+        if (!imu) {
+            uring_remove_socket(r);
+            return -1;
+        }
+
+        cli.lidar_uring = lidar;
+        cli.imu_uring = imu;
+        p.clients.push_back(&cli);
+        return idx;
+    }
+#endif
+
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLET;
+
+    ev.data.u64 = idx << 1;
+    if (epoll_ctl(p.epoll_fd, EPOLL_CTL_ADD, cli.lidar_fd, &ev) < 0) {
+        std::cerr << "epoll_ctl: " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+
+    ev.data.u64 = (idx << 1) | 1;
+    if (epoll_ctl(p.epoll_fd, EPOLL_CTL_ADD, cli.imu_fd, &ev) < 0) {
+        std::cerr << "epoll_ctl: " << std::strerror(errno) << std::endl;
+        epoll_ctl(p.epoll_fd, EPOLL_CTL_DEL, cli.lidar_fd, NULL);
+        return -1;
+    }
+
+    p.clients.push_back(&cli);
+    p.events.resize(2 * p.clients.size());
+    return idx;
+}
+
+client_state poll_clients(poller& p, std::vector<client_state>& states,
+                          const int timeout_ms) {
+    states.assign(p.clients.size(), client_state(0));
+
+#ifdef OS1_HAVE_IO_URING
+    if (p.ring) return uring_poll(p, states, timeout_ms);
+#endif
+
+    int n = epoll_wait(p.epoll_fd, p.events.data(), p.events.size(),
+                       timeout_ms);
+
+    if (n == -1 && errno == EINTR) return EXIT;
+    if (n == -1) {
+        std::cerr << "epoll_wait: " << std::strerror(errno) << std::endl;
+        return ERROR;
+    }
+
+    client_state res = client_state(0);
+    for (int i = 0; i < n; i++) {
+        const uint64_t data = p.events[i].data.u64;
+        client_state& st = states[data >> 1];
+
+        if (p.events[i].events & (EPOLLERR | EPOLLHUP))
+            st = client_state(st | ERROR);
+        else if (data & 1)
+            st = client_state(st | IMU_DATA);
+        else
+            st = client_state(st | LIDAR_DATA);
+
+        res = client_state(res | st);
+    }
+    return res;
+}
+
+bool pin_receive_thread(const client& cli) {
+    thread_config cfg{};
+    if (cli.opts.recv_cpu >= 0) cfg.cpus.push_back(cli.opts.recv_cpu);
+    cfg.fifo_priority = cli.opts.recv_priority;
+    return configure_thread(cfg);
+}
+
+uint64_t get_dropped_packets(const client& cli) {
+    return (uint64_t)cli.lidar_drops.load(std::memory_order_relaxed) +
+           cli.imu_drops.load(std::memory_order_relaxed);
+}
+
+static bool recv_fixed(int fd, void* buf, size_t len,
+                       std::atomic<uint32_t>& drops, metric_counter packets,
+                       uint64_t* ts_ns = NULL) {
+    alignas(cmsghdr) uint8_t ctrl[ctrl_bytes];
+
+    iovec iov;
+    iov.iov_base = buf;
+    iov.iov_len = len + 1;
+
+    msghdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = ctrl;
+    hdr.msg_controllen = sizeof(ctrl);
+
+    ssize_t n = recvmsg(fd, &hdr, 0);
+    if (ts_ns) *ts_ns = 0;
+    if (n >= 0) parse_cmsgs(hdr, ts_ns, drops);
+    if (n == (ssize_t)len) {
+        count_metric(packets);
         return true;
-    else if (n == -1)
+    } else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return false;
+    } else if (n == -1) {
         std::cerr << "recvfrom: " << std::strerror(errno) << std::endl;
-    else
+    } else {
+        count_metric(METRIC_MALFORMED_PACKETS);
         std::cerr << "Unexpected udp packet length: " << n << std::endl;
+    }
     return false;
 }
 
 bool read_lidar_packet(const client& cli, uint8_t* buf) {
-    return recv_fixed(cli.lidar_fd, buf, lidar_packet_bytes);
+#ifdef OS1_HAVE_IO_URING
+    if (cli.lidar_uring)
+        return uring_read(*cli.lidar_uring, buf, 1, NULL, NULL) == 1;
+#endif
+    return recv_fixed(cli.lidar_fd, buf, lidar_packet_bytes, cli.lidar_drops,
+                      METRIC_LIDAR_PACKETS);
+}
+
+size_t read_lidar_packets(const client& cli, uint8_t* bufs, size_t max_n,
+                          uint64_t* ts_ns, size_t* n_received) {
+    if (n_received) *n_received = 0;
+    if (max_n == 0) return 0;
+
+#ifdef OS1_HAVE_IO_URING
+    if (cli.lidar_uring)
+        return uring_read(*cli.lidar_uring, bufs, max_n, ts_ns, n_received);
+#endif
+
+    if (cli.msgs.size() < max_n) {
+        cli.msgs.resize(max_n);
+        cli.iovs.resize(max_n);
+        cli.ctrl.resize(max_n * ctrl_bytes);
+    }
+
+    for (size_t i = 0; i < max_n; i++) {
+        cli.iovs[i].iov_base = bufs + i * lidar_packet_bytes;
+        cli.iovs[i].iov_len = lidar_packet_bytes;
+
+        msghdr& hdr = cli.msgs[i].msg_hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_iov = &cli.iovs[i];
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = cli.ctrl.data() + i * ctrl_bytes;
+        hdr.msg_controllen = ctrl_bytes;
+    }
+
+    int n = recvmmsg(cli.lidar_fd, cli.msgs.data(), max_n, MSG_DONTWAIT, NULL);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            std::cerr << "recvmmsg: " << std::strerror(errno) << std::endl;
+        return 0;
+    }
+    if (n_received) *n_received = n;
+
+    // compact valid packets into the leading slots
+    size_t n_valid = 0;
+    for (int i = 0; i < n; i++) {
+        msghdr& hdr = cli.msgs[i].msg_hdr;
+        if (cli.msgs[i].msg_len != lidar_packet_bytes ||
+            (hdr.msg_flags & MSG_TRUNC)) {
+            count_metric(METRIC_MALFORMED_PACKETS);
+            std::cerr << "Unexpected udp packet length: "
+                      << cli.msgs[i].msg_len << std::endl;
+            continue;
+        }
+
+        uint64_t ts = 0;
+        parse_cmsgs(hdr, &ts, cli.lidar_drops);
+        if (ts_ns) ts_ns[n_valid] = ts;
+
+        if ((size_t)i != n_valid)
+            memmove(bufs + n_valid * lidar_packet_bytes,
+                    bufs + i * lidar_packet_bytes, lidar_packet_bytes);
+        n_valid++;
+    }
+
+    count_metric(METRIC_LIDAR_PACKETS, n_valid);
+    return n_valid;
 }
 
-bool read_imu_packet(const client& cli, uint8_t* buf) {
-    return recv_fixed(cli.imu_fd, buf, imu_packet_bytes);
+bool read_imu_packet(const client& cli, uint8_t* buf, uint64_t* ts_ns) {
+#ifdef OS1_HAVE_IO_URING
+    if (cli.imu_uring) {
+        if (ts_ns) *ts_ns = 0;
+        return uring_read(*cli.imu_uring, buf, 1, ts_ns, NULL) == 1;
+    }
+#endif
+    return recv_fixed(cli.imu_fd, buf, imu_packet_bytes, cli.imu_drops,
+                      METRIC_IMU_PACKETS, ts_ns);
 }
 }
 }
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "ouster/os1.h"
+#include "ouster/os1_assembler.h"
+#include "ouster/os1_metrics.h"
+#include "ouster/os1_packet.h"
+
+namespace ouster {
+namespace OS1 {
+
+namespace {
+
+// held packets of one frame, indexed by the measurement id of their first
+// column divided by columns_per_buffer
+struct frame_slot {
+    std::vector<uint8_t> bufs;
+    std::vector<uint8_t> held;
+    std::vector<uint64_t> held_ts;
+    frame_stats stats;
+
+    void reset(uint16_t frame_id) {
+        std::fill(held.begin(), held.end(), 0);
+        std::fill(stats.received.begin(), stats.received.end(), 0);
+        stats.frame_id = frame_id;
+        stats.scan_ts = 0;
+        stats.cols_received = 0;
+        stats.reordered_packets = 0;
+        stats.late_packets = 0;
+        stats.duplicate_packets = 0;
+    }
+};
+
+// position of a packet in the stream
+struct packet_id {
+    uint16_t frame_id;
+    int index;
+    uint64_t ts;
+};
+
+// identify a packet by its first valid column; false if it has none
+bool get_packet_id(const uint8_t* buf, int W, packet_id& id) {
+    for (int icol = 0; icol < columns_per_buffer; icol++) {
+        const uint8_t* col_buf = nth_col(icol, buf);
+        if (col_valid(col_buf) != 0xffffffff) continue;
+
+        const int m_id = col_measurement_id(col_buf);
+        if (m_id >= W) return false;
+        id.frame_id = col_frame_id(col_buf);
+        id.index = m_id / columns_per_buffer;
+        id.ts = col_timestamp(col_buf);
+        return true;
+    }
+    return false;
+}
+}
+
+struct frame_assembler {
+    int W;
+    int n_packets;
+    uint64_t max_wait_ns;
+    std::function<void(const uint8_t*)> p;
+    std::function<void(const frame_stats&)> f;
+
+    bool started{false};
+    uint16_t cur_f_id{0};
+    int next_index{0};     // next packet of the current frame to pass on
+    uint64_t newest_ts{0};  // latest column timestamp received
+
+    // the current frame and the one after
+    frame_slot slots[2];
+};
+
+namespace {
+
+frame_slot& cur_slot(frame_assembler& a) { return a.slots[0]; }
+frame_slot& next_slot(frame_assembler& a) { return a.slots[1]; }
+
+// pass a packet of the current frame on, counting its valid columns
+void pass_on(frame_assembler& a, const uint8_t* buf) {
+    frame_stats& s = cur_slot(a).stats;
+    for (int icol = 0; icol < columns_per_buffer; icol++) {
+        const uint8_t* col_buf = nth_col(icol, buf);
+        const int m_id = col_measurement_id(col_buf);
+        if (col_valid(col_buf) != 0xffffffff || m_id >= a.W) continue;
+
+        if (!s.cols_received) s.scan_ts = col_timestamp(col_buf);
+        s.cols_received += !s.received[m_id];
+        s.received[m_id] = 1;
+    }
+    a.next_index++;
+    a.p(buf);
+}
+
+// report the current frame and make the next one current
+void close_frame(frame_assembler& a) {
+    a.f(cur_slot(a).stats);
+
+    std::swap(a.slots[0], a.slots[1]);
+    a.cur_f_id++;
+    next_slot(a).reset(a.cur_f_id + 1);
+    a.next_index = 0;
+}
+
+// pass on held packets following those already passed on, closing frames
+// once their last packet was passed on
+void release(frame_assembler& a) {
+    while (true) {
+        if (a.next_index == a.n_packets) {
+            close_frame(a);
+            continue;
+        }
+        frame_slot& cur = cur_slot(a);
+        if (!cur.held[a.next_index]) return;
+
+        cur.held[a.next_index] = 0;
+        pass_on(a, cur.bufs.data() + a.next_index * lidar_packet_bytes);
+    }
+}
+
+// the first held packet of the current frame, or of the next one, at or after
+// next_index; -1 if no packet is held
+int first_held(frame_assembler& a, int& slot) {
+    for (slot = 0; slot < 2; slot++) {
+        const std::vector<uint8_t>& held = a.slots[slot].held;
+        auto it = std::find(held.begin() + (slot ? 0 : a.next_index),
+                            held.end(), 1);
+        if (it != held.end()) return it - held.begin();
+    }
+    return -1;
+}
+
+// stop waiting for missing packets before held packets that waited for
+// max_wait_ns, or before every held packet if all is set
+void expire(frame_assembler& a, bool all) {
+    int slot;
+    int index;
+    while ((index = first_held(a, slot)) >= 0) {
+        const uint64_t ts = a.slots[slot].held_ts[index];
+        if (!all && a.newest_ts - ts < a.max_wait_ns) return;
+
+        // the rest of the current frame is missing
+        if (slot) close_frame(a);
+        a.next_index = index;
+        release(a);
+    }
+}
+
+void hold(frame_slot& slot, const uint8_t* buf, const packet_id& id) {
+    std::memcpy(slot.bufs.data() + id.index * lidar_packet_bytes, buf,
+                lidar_packet_bytes);
+    slot.held[id.index] = 1;
+    slot.held_ts[id.index] = id.ts;
+}
+
+void drop(frame_stats& s, bool duplicate) {
+    if (duplicate)
+        s.duplicate_packets++;
+    else
+        s.late_packets++;
+    count_metric(METRIC_LATE_PACKETS);
+}
+}
+
+std::shared_ptr<frame_assembler> init_frame_assembler(
+    int W, uint64_t max_wait_ns, std::function<void(const uint8_t*)> p,
+    std::function<void(const frame_stats&)> f) {
+    auto a = std::make_shared<frame_assembler>();
+    a->W = W;
+    a->n_packets = W / columns_per_buffer;
+    a->max_wait_ns = max_wait_ns;
+    a->p = std::move(p);
+    a->f = std::move(f);
+
+    for (frame_slot& slot : a->slots) {
+        slot.bufs.resize(a->n_packets * lidar_packet_bytes);
+        slot.held.resize(a->n_packets);
+        slot.held_ts.resize(a->n_packets);
+        slot.stats.n_cols = W;
+        slot.stats.received.resize(W);
+        slot.reset(0);
+    }
+    return a;
+}
+
+void add_lidar_packet(frame_assembler& a, const uint8_t* buf) {
+    packet_id id;
+    if (!get_packet_id(buf, a.W, id)) return;
+
+    // nothing earlier to wait for when joining a stream
+    if (!a.started) {
+        a.started = true;
+        a.cur_f_id = id.frame_id;
+        a.next_index = id.index;
+        cur_slot(a).reset(id.frame_id);
+        next_slot(a).reset(id.frame_id + 1);
+    }
+
+    // only the frame before the window is late; anything further off, e.g.
+    // frame ids restarting after the sensor reinitialized, starts over
+    int16_t d = id.frame_id - a.cur_f_id;
+    if (d >= 2 || d < -1) {
+        // outside the window: give up on both frames and start over
+        expire(a, true);
+        if (a.next_index) close_frame(a);
+        a.cur_f_id = id.frame_id;
+        a.next_index = 0;
+        cur_slot(a).reset(id.frame_id);
+        next_slot(a).reset(id.frame_id + 1);
+        // timestamps may have restarted too
+        a.newest_ts = id.ts;
+        d = 0;
+    }
+    a.newest_ts = std::max(a.newest_ts, id.ts);
+
+    frame_slot& cur = cur_slot(a);
+    if (d == -1) {
+        drop(cur.stats, false);
+    } else if (d == 1) {
+        frame_slot& next = next_slot(a);
+        if (next.held[id.index])
+            drop(cur.stats, true);
+        else
+            hold(next, buf, id);
+    } else if (id.index < a.next_index) {
+        const uint16_t m_id = id.index * columns_per_buffer;
+        drop(cur.stats, cur.stats.received[m_id]);
+    } else if (cur.held[id.index]) {
+        drop(cur.stats, true);
+    } else if (id.index > a.next_index) {
+        hold(cur, buf, id);
+    } else {
+        // filling a gap before held packets
+        int slot;
+        if (first_held(a, slot) >= 0) {
+            cur.stats.reordered_packets++;
+            count_metric(METRIC_REORDERED_PACKETS);
+        }
+        pass_on(a, buf);
+        release(a);
+    }
+
+    expire(a, a.max_wait_ns == 0);
+}
+
+void flush_frames(frame_assembler& a) {
+    if (!a.started) return;
+    expire(a, true);
+    if (a.next_index) close_frame(a);
+}
+}
+}
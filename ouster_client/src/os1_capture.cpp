@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ouster/os1.h"
+#include "ouster/os1_capture.h"
+#include "ouster/os1_packet.h"
+
+namespace ouster {
+namespace OS1 {
+
+namespace {
+
+const char capture_magic[8] = {'O', 'S', '1', 'C', 'A', 'P', '\0', '\0'};
+const uint32_t capture_version = 1;
+
+// followed by metadata_bytes of metadata, padded to a multiple of 8 bytes
+struct file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t metadata_bytes;
+};
+
+// followed by bytes of packet data, padded to a multiple of 8 bytes
+struct record_header {
+    uint32_t type;
+    uint32_t bytes;
+    uint64_t ts;
+};
+
+const size_t write_buffer_bytes = 1 << 20;
+
+size_t padded(size_t n) { return (n + 7) & ~size_t(7); }
+
+uint64_t now_ns() {
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    return uint64_t(t.tv_sec) * 1000000000ULL + t.tv_nsec;
+}
+}
+
+struct capture_writer {
+    FILE* file;
+    std::vector<char> buffer;
+
+    capture_writer(FILE* f) : file{f}, buffer(write_buffer_bytes) {
+        setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+    }
+    ~capture_writer() { fclose(file); }
+};
+
+struct capture_reader {
+    const uint8_t* data;
+    size_t size;
+    std::string metadata;
+    std::vector<uint64_t> offsets;
+    std::vector<capture_frame> frames;
+    // whether frame timestamps never decrease, so find_frame can bisect
+    bool frames_sorted;
+
+    capture_reader() : data{nullptr}, size{0}, frames_sorted{true} {}
+    ~capture_reader() {
+        if (data) munmap(const_cast<uint8_t*>(data), size);
+    }
+};
+
+namespace {
+
+bool write_packet(capture_writer& w, packet_type type, const uint8_t* buf,
+                  uint32_t bytes, uint64_t ts) {
+    static const uint8_t zeros[8] = {0};
+
+    record_header h{type, bytes, ts ? ts : now_ns()};
+    if (fwrite(&h, sizeof(h), 1, w.file) != 1 ||
+        fwrite(buf, 1, bytes, w.file) != bytes ||
+        fwrite(zeros, 1, padded(bytes) - bytes, w.file) !=
+            padded(bytes) - bytes) {
+        std::cerr << "capture: write failed: " << std::strerror(errno)
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// scan record headers to build the packet and frame indices
+void index_capture(capture_reader& r, size_t pos) {
+    int32_t cur_f_id = -1;
+
+    while (pos + sizeof(record_header) <= r.size) {
+        record_header h;
+        std::memcpy(&h, r.data + pos, sizeof(h));
+
+        const size_t end = pos + sizeof(h) + padded(h.bytes);
+        if (end > r.size) break;
+
+        const bool lidar =
+            h.type == LIDAR_PACKET && h.bytes == lidar_packet_bytes;
+        if (!lidar && !(h.type == IMU_PACKET && h.bytes == imu_packet_bytes)) {
+            std::cerr << "capture: unexpected packet at offset " << pos
+                      << "; ignoring rest of file" << std::endl;
+            break;
+        }
+
+        // split frames like batch_to_iter: at the first valid column of a new
+        // frame, ignoring late packets of the previous frame
+        for (int icol = 0; lidar && icol < columns_per_buffer; icol++) {
+            const uint8_t* col_buf = nth_col(icol, r.data + pos + sizeof(h));
+            if (col_valid(col_buf) != 0xffffffff) continue;
+
+            const uint16_t f_id = col_frame_id(col_buf);
+            if (f_id != cur_f_id && f_id + 1 != cur_f_id) {
+                r.frames.push_back({f_id, col_timestamp(col_buf),
+                                    r.offsets.size(), 0});
+                cur_f_id = f_id;
+            }
+            break;
+        }
+
+        r.offsets.push_back(pos);
+        if (!r.frames.empty()) r.frames.back().n_packets++;
+        pos = end;
+    }
+
+    for (size_t i = 1; i < r.frames.size(); i++)
+        if (r.frames[i].ts < r.frames[i - 1].ts) r.frames_sorted = false;
+}
+}
+
+std::shared_ptr<capture_writer> open_capture_writer(
+    const std::string& path, const std::string& metadata) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        std::cerr << "capture: failed to open " << path << ": "
+                  << std::strerror(errno) << std::endl;
+        return std::shared_ptr<capture_writer>();
+    }
+    auto w = std::make_shared<capture_writer>(f);
+
+    file_header h{};
+    std::memcpy(h.magic, capture_magic, sizeof(h.magic));
+    h.version = capture_version;
+    h.metadata_bytes = metadata.size();
+
+    const std::string pad(padded(metadata.size()) - metadata.size(), '\0');
+    if (fwrite(&h, sizeof(h), 1, f) != 1 ||
+        fwrite(metadata.data(), 1, metadata.size(), f) != metadata.size() ||
+        fwrite(pad.data(), 1, pad.size(), f) != pad.size()) {
+        std::cerr << "capture: failed to write header to " << path
+                  << std::endl;
+        return std::shared_ptr<capture_writer>();
+    }
+    return w;
+}
+
+bool write_lidar_packet(capture_writer& w, const uint8_t* buf, uint64_t ts) {
+    return write_packet(w, LIDAR_PACKET, buf, lidar_packet_bytes, ts);
+}
+
+bool write_imu_packet(capture_writer& w, const uint8_t* buf, uint64_t ts) {
+    return write_packet(w, IMU_PACKET, buf, imu_packet_bytes, ts);
+}
+
+std::shared_ptr<capture_reader> open_capture(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "capture: failed to open " << path << ": "
+                  << std::strerror(errno) << std::endl;
+        return std::shared_ptr<capture_reader>();
+    }
+
+    struct stat st;
+    auto r = std::make_shared<capture_reader>();
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(file_header)) {
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            r->data = static_cast<const uint8_t*>(p);
+            r->size = st.st_size;
+            madvise(p, st.st_size, MADV_SEQUENTIAL);
+        }
+    }
+    close(fd);
+
+    file_header h;
+    if (r->data) std::memcpy(&h, r->data, sizeof(h));
+    if (!r->data || std::memcmp(h.magic, capture_magic, sizeof(h.magic)) ||
+        h.version != capture_version ||
+        sizeof(h) + padded(h.metadata_bytes) > r->size) {
+        std::cerr << "capture: " << path << " is not a valid capture"
+                  << std::endl;
+        return std::shared_ptr<capture_reader>();
+    }
+
+    const char* meta = reinterpret_cast<const char*>(r->data + sizeof(h));
+    r->metadata.assign(meta, h.metadata_bytes);
+    index_capture(*r, sizeof(h) + padded(h.metadata_bytes));
+    return r;
+}
+
+const std::string& capture_metadata(const capture_reader& r) {
+    return r.metadata;
+}
+
+size_t capture_size(const capture_reader& r) { return r.offsets.size(); }
+
+capture_packet capture_packet_at(const capture_reader& r, size_t i) {
+    record_header h;
+    std::memcpy(&h, r.data + r.offsets[i], sizeof(h));
+    return {packet_type(h.type), h.ts,
+            r.data + r.offsets[i] + sizeof(record_header)};
+}
+
+const std::vector<capture_frame>& capture_frames(const capture_reader& r) {
+    return r.frames;
+}
+
+size_t find_frame(const capture_reader& r, uint64_t ts) {
+    if (r.frames_sorted)
+        return std::lower_bound(r.frames.begin(), r.frames.end(), ts,
+                                [](const capture_frame& f, uint64_t t) {
+                                    return f.ts < t;
+                                }) -
+               r.frames.begin();
+
+    // frames are not ordered by timestamp if the sensor was restarted during
+    // the capture, so search linearly
+    for (size_t i = 0; i < r.frames.size(); i++)
+        if (r.frames[i].ts >= ts) return i;
+    return r.frames.size();
+}
+
+size_t replay_capture(const capture_reader& r, size_t first, size_t last,
+                      double rate,
+                      const std::function<bool(const capture_packet&)>& f) {
+    using clock = std::chrono::steady_clock;
+
+    last = std::min(last, capture_size(r));
+    if (first >= last) return 0;
+
+    const auto t0 = clock::now();
+    const uint64_t ts0 = capture_packet_at(r, first).ts;
+
+    size_t n = 0;
+    for (size_t i = first; i < last; i++) {
+        const capture_packet p = capture_packet_at(r, i);
+
+        if (rate > 0 && p.ts > ts0) {
+            const auto dt = std::chrono::nanoseconds{
+                static_cast<int64_t>((p.ts - ts0) / rate)};
+            std::this_thread::sleep_until(t0 + dt);
+        }
+
+        n++;
+        if (!f(p)) break;
+    }
+    return n;
+}
+}
+}
@@ -0,0 +1,294 @@
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "ouster/os1_codec.h"
+#include "ouster/os1_packet.h"
+#include "ouster/os1_util.h"
+
+namespace ouster {
+namespace OS1 {
+
+namespace {
+
+const uint8_t codec_magic[4] = {'O', 'S', '1', 'Z'};
+const uint8_t codec_version = 2;
+const size_t header_bytes = 30;
+
+const uint32_t range_mask = 0x000fffff;
+const uint32_t u16_mask = 0xffff;
+const uint32_t u32_mask = 0xffffffff;
+
+// bytes of the payload before compression: per-column timestamps and encoder
+// counts, then 20 bit ranges and the 16 bit channels in codec_channel order
+size_t payload_bytes(int W, int H, uint8_t channels) {
+    size_t n_u16 = 0;
+    for (uint8_t ch : {CODEC_SIGNAL, CODEC_REFLECTIVITY, CODEC_NOISE})
+        n_u16 += (channels & ch) != 0;
+    return W * 2 * sizeof(uint32_t) + size_t(W) * H * (3 + 2 * n_u16);
+}
+
+// map a difference of values of mask bits to codes that are small for small
+// differences of either sign
+inline uint32_t zigzag(uint32_t d, uint32_t mask) {
+    d &= mask;
+    const bool negative = d & ~(mask >> 1);
+    return ((d << 1) & mask) ^ (negative ? mask : 0);
+}
+
+inline uint32_t unzigzag(uint32_t z, uint32_t mask) {
+    return ((z >> 1) ^ ((z & 1) ? mask : 0)) & mask;
+}
+
+// header fields are little-endian regardless of the host
+template <typename T>
+void put_le(uint8_t* p, T v) {
+    for (size_t i = 0; i < sizeof(T); i++)
+        p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+template <typename T>
+T get_le(const uint8_t* p) {
+    T v = 0;
+    for (size_t i = 0; i < sizeof(T); i++) v |= T(p[i]) << (8 * i);
+    return v;
+}
+
+// delta code each destaggered row of a W x H channel and store the n_bytes
+// bytes of the codes of its W * H pixels in consecutive byte planes
+template <typename T>
+uint8_t* put_plane(const T* src, int W, int H,
+                   const std::vector<int>& px_offset, int n_bytes,
+                   uint32_t mask, uint8_t* out) {
+    const size_t n = size_t(W) * H;
+    for (int u = 0; u < H; u++) {
+        const int ofs = px_offset[u];
+        uint8_t* row = out + size_t(u) * W;
+        uint32_t prev = 0;
+        for (int v = 0; v < W; v++) {
+            const int col = v + ofs < W ? v + ofs : v + ofs - W;
+            const uint32_t val = src[H * col + u] & mask;
+            const uint32_t z = zigzag(val - prev, mask);
+            prev = val;
+            for (int b = 0; b < n_bytes; b++)
+                row[b * n + v] = static_cast<uint8_t>(z >> (8 * b));
+        }
+    }
+    return out + n_bytes * n;
+}
+
+// inverse of put_plane
+template <typename T>
+const uint8_t* get_plane(const uint8_t* in, int W, int H,
+                         const std::vector<int>& px_offset, int n_bytes,
+                         uint32_t mask, T* dst) {
+    const size_t n = size_t(W) * H;
+    for (int u = 0; u < H; u++) {
+        const int ofs = px_offset[u];
+        const uint8_t* row = in + size_t(u) * W;
+        uint32_t prev = 0;
+        for (int v = 0; v < W; v++) {
+            uint32_t z = 0;
+            for (int b = 0; b < n_bytes; b++)
+                z |= uint32_t(row[b * n + v]) << (8 * b);
+            prev = (prev + unzigzag(z, mask)) & mask;
+            const int col = v + ofs < W ? v + ofs : v + ofs - W;
+            dst[H * col + u] = static_cast<T>(prev);
+        }
+    }
+    return in + n_bytes * n;
+}
+}
+
+struct scan_codec {
+    int W;
+    int H;
+    uint8_t channels;
+    std::vector<int> px_offset;
+    std::vector<int> col_offset;  // column data is a single row
+
+    std::vector<uint8_t> payload;  // sized for all channels
+    std::vector<uint32_t> col_t;   // column timestamps relative to the first
+
+    z_stream deflater;
+    z_stream inflater;
+    bool has_deflater{false};
+    bool has_inflater{false};
+
+    ~scan_codec() {
+        if (has_deflater) deflateEnd(&deflater);
+        if (has_inflater) inflateEnd(&inflater);
+    }
+};
+
+std::shared_ptr<scan_codec> init_codec(int W, int H, uint8_t channels,
+                                       int level) {
+    // pixel offsets are only known for the columns and rows of the lidar modes
+    const bool lidar_mode_W = W == 512 || W == 1024 || W == 2048;
+    if (!lidar_mode_W || H <= 0 || H > pixels_per_column) {
+        std::cerr << "codec: invalid scan dimensions " << W << "x" << H
+                  << std::endl;
+        return {};
+    }
+    if (level < 1 || level > 9) {
+        std::cerr << "codec: invalid compression level " << level
+                  << std::endl;
+        return {};
+    }
+
+    auto c = std::make_shared<scan_codec>();
+    c->W = W;
+    c->H = H;
+    c->channels = channels & CODEC_ALL;
+    c->px_offset = get_px_offset(W);
+    c->col_offset = {0};
+    c->payload.resize(payload_bytes(W, H, CODEC_ALL));
+    c->col_t.resize(W);
+
+    std::memset(&c->deflater, 0, sizeof(c->deflater));
+    std::memset(&c->inflater, 0, sizeof(c->inflater));
+    c->has_deflater = deflateInit(&c->deflater, level) == Z_OK;
+    c->has_inflater = inflateInit(&c->inflater) == Z_OK;
+    if (!c->has_deflater || !c->has_inflater) {
+        std::cerr << "codec: failed to initialize zlib" << std::endl;
+        return {};
+    }
+    return c;
+}
+
+bool encode_scan(scan_codec& c, const scan_channels& scan, uint64_t scan_ts,
+                 std::vector<uint8_t>& buf) {
+    const int W = c.W;
+    const int H = c.H;
+    if (scan.W != W || scan.H != H) {
+        std::cerr << "codec: scan dimensions differ from the codec"
+                  << std::endl;
+        return false;
+    }
+
+    // columns may be received out of order, so timestamps are relative to
+    // the earliest one. Missing columns have no timestamp and are coded as 0,
+    // so offsets start at 1
+    uint64_t first_ts = UINT64_MAX, last_ts = 0;
+    for (int j = 0; j < W; j++) {
+        if (!scan.col_ts[j]) continue;
+        first_ts = std::min(first_ts, scan.col_ts[j]);
+        last_ts = std::max(last_ts, scan.col_ts[j]);
+    }
+    if (first_ts > last_ts) first_ts = last_ts = 0;
+    if (last_ts - first_ts >= UINT32_MAX) {
+        std::cerr << "codec: column timestamps span more than 32 bits"
+                  << std::endl;
+        return false;
+    }
+    for (int j = 0; j < W; j++)
+        c.col_t[j] = scan.col_ts[j] ? scan.col_ts[j] - first_ts + 1 : 0;
+
+    uint8_t* out = c.payload.data();
+    out = put_plane(c.col_t.data(), W, 1, c.col_offset, 4, u32_mask, out);
+    out = put_plane(scan.col_encoder.data(), W, 1, c.col_offset, 4, u32_mask,
+                    out);
+    out = put_plane(scan.range.data(), W, H, c.px_offset, 3, range_mask, out);
+    if (c.channels & CODEC_SIGNAL)
+        out = put_plane(scan.signal.data(), W, H, c.px_offset, 2, u16_mask,
+                        out);
+    if (c.channels & CODEC_REFLECTIVITY)
+        out = put_plane(scan.reflectivity.data(), W, H, c.px_offset, 2,
+                        u16_mask, out);
+    if (c.channels & CODEC_NOISE)
+        out = put_plane(scan.noise.data(), W, H, c.px_offset, 2, u16_mask,
+                        out);
+    const uint32_t raw_size = out - c.payload.data();
+
+    z_stream& z = c.deflater;
+    deflateReset(&z);
+    buf.resize(header_bytes + deflateBound(&z, raw_size));
+
+    uint8_t* hdr = buf.data();
+    std::memcpy(hdr, codec_magic, sizeof(codec_magic));
+    hdr[4] = codec_version;
+    hdr[5] = c.channels;
+    put_le<uint16_t>(hdr + 6, W);
+    put_le<uint16_t>(hdr + 8, H);
+    put_le<uint64_t>(hdr + 10, scan_ts);
+    put_le<uint32_t>(hdr + 18, raw_size);
+    put_le<uint64_t>(hdr + 22, first_ts);
+
+    z.next_in = c.payload.data();
+    z.avail_in = raw_size;
+    z.next_out = buf.data() + header_bytes;
+    z.avail_out = buf.size() - header_bytes;
+    if (deflate(&z, Z_FINISH) != Z_STREAM_END) {
+        std::cerr << "codec: failed to compress scan" << std::endl;
+        return false;
+    }
+    buf.resize(header_bytes + z.total_out);
+    return true;
+}
+
+bool decode_scan(scan_codec& c, const uint8_t* buf, size_t size,
+                 scan_channels& scan, uint64_t& scan_ts) {
+    const int W = c.W;
+    const int H = c.H;
+
+    if (size < header_bytes ||
+        std::memcmp(buf, codec_magic, sizeof(codec_magic)) != 0 ||
+        buf[4] != codec_version) {
+        std::cerr << "codec: malformed compressed scan" << std::endl;
+        return false;
+    }
+
+    const uint16_t w = get_le<uint16_t>(buf + 6);
+    const uint16_t h = get_le<uint16_t>(buf + 8);
+    if (w != W || h != H || scan.W != W || scan.H != H) {
+        std::cerr << "codec: scan dimensions differ from the codec"
+                  << std::endl;
+        return false;
+    }
+
+    const uint8_t channels = buf[5];
+    const uint32_t raw_size = get_le<uint32_t>(buf + 18);
+    if ((channels & ~CODEC_ALL) || raw_size != payload_bytes(W, H, channels)) {
+        std::cerr << "codec: malformed compressed scan" << std::endl;
+        return false;
+    }
+    scan_ts = get_le<uint64_t>(buf + 10);
+    const uint64_t first_ts = get_le<uint64_t>(buf + 22);
+
+    z_stream& z = c.inflater;
+    inflateReset(&z);
+    z.next_in = const_cast<uint8_t*>(buf + header_bytes);
+    z.avail_in = size - header_bytes;
+    z.next_out = c.payload.data();
+    z.avail_out = raw_size;
+    if (inflate(&z, Z_FINISH) != Z_STREAM_END || z.total_out != raw_size) {
+        std::cerr << "codec: failed to decompress scan" << std::endl;
+        return false;
+    }
+
+    const uint8_t* in = c.payload.data();
+    in = get_plane(in, W, 1, c.col_offset, 4, u32_mask, c.col_t.data());
+    in = get_plane(in, W, 1, c.col_offset, 4, u32_mask,
+                   scan.col_encoder.data());
+    for (int j = 0; j < W; j++)
+        scan.col_ts[j] = c.col_t[j] ? first_ts + c.col_t[j] - 1 : 0;
+
+    in = get_plane(in, W, H, c.px_offset, 3, range_mask, scan.range.data());
+    auto get_u16 = [&](uint8_t ch, std::vector<uint16_t>& dst) {
+        if (channels & ch)
+            in = get_plane(in, W, H, c.px_offset, 2, u16_mask, dst.data());
+        else
+            std::fill(dst.begin(), dst.end(), 0);
+    };
+    get_u16(CODEC_SIGNAL, scan.signal);
+    get_u16(CODEC_REFLECTIVITY, scan.reflectivity);
+    get_u16(CODEC_NOISE, scan.noise);
+    return true;
+}
+}
+}
@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "ouster/os1_decimate.h"
+
+namespace ouster {
+namespace OS1 {
+
+namespace {
+
+// coordinates of a voxel take 21 signed bits each in its key
+const int voxel_key_bits = 21;
+
+struct voxel_slot {
+    uint64_t key;
+    uint32_t gen;  // slot is empty unless this is the current generation
+    uint32_t idx;  // index of the voxel in the reduced scan
+};
+
+uint64_t voxel_key(float x, float y, float z, float inv_size) {
+    const uint64_t mask = (uint64_t{1} << voxel_key_bits) - 1;
+    const uint64_t ix = static_cast<int64_t>(std::floor(x * inv_size)) & mask;
+    const uint64_t iy = static_cast<int64_t>(std::floor(y * inv_size)) & mask;
+    const uint64_t iz = static_cast<int64_t>(std::floor(z * inv_size)) & mask;
+    return (ix << (2 * voxel_key_bits)) | (iy << voxel_key_bits) | iz;
+}
+}
+
+struct decimator {
+    int W;
+    int H;
+    decimate_config config;
+    std::vector<int> rings;
+
+    // dimensions of the organized reduced scan
+    int out_W;
+    int out_H;
+    decimated_scan out;
+
+    bool started;
+    uint64_t scan_ts;
+
+    // open addressing table of occupied voxels; slots are invalidated by
+    // bumping the generation, so starting a scan does not clear the table
+    std::vector<voxel_slot> table;
+    int table_bits;
+    uint32_t gen;
+    size_t n_voxels;
+    std::vector<uint32_t> n_points;
+};
+
+namespace {
+
+void resize(decimated_scan& s, size_t n) {
+    s.x.resize(n);
+    s.y.resize(n);
+    s.z.resize(n);
+    s.signal.resize(n);
+    s.t.resize(n);
+    s.reflectivity.resize(n);
+    s.ring.resize(n);
+    s.noise.resize(n);
+    s.range.resize(n);
+}
+
+void clear(decimated_scan& s) {
+    std::fill(s.x.begin(), s.x.end(), 0.0f);
+    std::fill(s.y.begin(), s.y.end(), 0.0f);
+    std::fill(s.z.begin(), s.z.end(), 0.0f);
+    std::fill(s.signal.begin(), s.signal.end(), 0);
+    std::fill(s.t.begin(), s.t.end(), 0);
+    std::fill(s.reflectivity.begin(), s.reflectivity.end(), 0);
+    std::fill(s.ring.begin(), s.ring.end(), 0);
+    std::fill(s.noise.begin(), s.noise.end(), 0);
+    std::fill(s.range.begin(), s.range.end(), 0);
+}
+
+void store(decimated_scan& s, size_t i, const px_column& px, int ipx,
+           uint32_t t) {
+    s.x[i] = px.x[ipx];
+    s.y[i] = px.y[ipx];
+    s.z[i] = px.z[ipx];
+    s.signal[i] = px.signal[ipx];
+    s.t[i] = t;
+    s.reflectivity[i] = px.reflectivity[ipx];
+    s.ring[i] = ipx;
+    s.noise[i] = px.noise[ipx];
+    s.range[i] = px.range[ipx];
+}
+
+void start_scan(decimator& d, uint64_t scan_ts) {
+    d.started = true;
+    d.scan_ts = scan_ts;
+    d.out.dropped = 0;
+
+    if (d.config.reduction != REDUCE_VOXEL) {
+        d.out.W = d.out_W;
+        d.out.H = d.out_H;
+        clear(d.out);
+        return;
+    }
+
+    d.n_voxels = 0;
+    if (++d.gen == 0) {
+        for (auto& slot : d.table) slot.gen = 0;
+        d.gen = 1;
+    }
+}
+
+void add_voxel(decimator& d, const px_column& px, int ipx, uint32_t t) {
+    const uint64_t key =
+        voxel_key(px.x[ipx], px.y[ipx], px.z[ipx], 1.0f / d.config.voxel_size);
+    const uint64_t mask = d.table.size() - 1;
+
+    // fibonacci hashing, then linear probing
+    uint64_t h = (key * 0x9E3779B97F4A7C15ULL) >> (64 - d.table_bits);
+    while (d.table[h].gen == d.gen && d.table[h].key != key)
+        h = (h + 1) & mask;
+
+    voxel_slot& slot = d.table[h];
+    if (slot.gen == d.gen) {
+        decimated_scan& s = d.out;
+        s.x[slot.idx] += px.x[ipx];
+        s.y[slot.idx] += px.y[ipx];
+        s.z[slot.idx] += px.z[ipx];
+        d.n_points[slot.idx]++;
+        return;
+    }
+
+    if (d.n_voxels == d.config.max_voxels) {
+        d.out.dropped++;
+        return;
+    }
+
+    // the first return of a voxel provides its other fields
+    slot.key = key;
+    slot.gen = d.gen;
+    slot.idx = d.n_voxels++;
+    store(d.out, slot.idx, px, ipx, t);
+    d.n_points[slot.idx] = 1;
+}
+}
+
+std::shared_ptr<decimator> init_decimator(int W, int H,
+                                          const decimate_config& config) {
+    if (config.col_stride < 1) {
+        std::cerr << "decimate: invalid column stride " << config.col_stride
+                  << std::endl;
+        return std::shared_ptr<decimator>();
+    }
+    for (int r : config.rings) {
+        if (r < 0 || r >= H) {
+            std::cerr << "decimate: invalid ring " << r << std::endl;
+            return std::shared_ptr<decimator>();
+        }
+    }
+    const bool block = config.reduction == REDUCE_BLOCK_MIN ||
+                       config.reduction == REDUCE_BLOCK_MAX;
+    if (block && config.block < 1) {
+        std::cerr << "decimate: invalid block size " << config.block
+                  << std::endl;
+        return std::shared_ptr<decimator>();
+    }
+    if (config.reduction == REDUCE_VOXEL &&
+        (!(config.voxel_size > 0) || config.max_voxels == 0 ||
+         config.max_voxels > UINT32_MAX / 2)) {
+        std::cerr << "decimate: invalid voxel size or count" << std::endl;
+        return std::shared_ptr<decimator>();
+    }
+
+    auto d = std::make_shared<decimator>();
+    d->W = W;
+    d->H = H;
+    d->config = config;
+    d->rings = config.rings;
+    if (d->rings.empty())
+        for (int r = 0; r < H; r++) d->rings.push_back(r);
+
+    const int k = block ? config.block : 1;
+    const int sub_W = (W + config.col_stride - 1) / config.col_stride;
+    const int sub_H = d->rings.size();
+    d->out_W = (sub_W + k - 1) / k;
+    d->out_H = (sub_H + k - 1) / k;
+    d->started = false;
+    d->scan_ts = 0;
+    d->gen = 0;
+    d->n_voxels = 0;
+    d->table_bits = 0;
+
+    if (config.reduction == REDUCE_VOXEL) {
+        // keep the table at most half full
+        while ((size_t{1} << d->table_bits) < 2 * config.max_voxels)
+            d->table_bits++;
+        d->table.assign(size_t{1} << d->table_bits, voxel_slot{0, 0, 0});
+        d->n_points.resize(config.max_voxels);
+        resize(d->out, config.max_voxels);
+        d->out.W = 0;
+        d->out.H = 1;
+    } else {
+        resize(d->out, d->out_W * d->out_H);
+        d->out.W = d->out_W;
+        d->out.H = d->out_H;
+    }
+    d->out.dropped = 0;
+
+    return d;
+}
+
+void decimate_column(decimator& d, uint64_t scan_ts, uint64_t ts, int m_id,
+                     const px_column& px) {
+    if (!d.started || scan_ts != d.scan_ts) start_scan(d, scan_ts);
+    if (m_id % d.config.col_stride != 0) return;
+
+    const int col = m_id / d.config.col_stride;
+    const uint32_t t = ts - scan_ts;
+    const int n_rings = d.rings.size();
+    decimated_scan& s = d.out;
+
+    switch (d.config.reduction) {
+        case REDUCE_NONE:
+            for (int r = 0; r < n_rings; r++)
+                store(s, col * d.out_H + r, px, d.rings[r], t);
+            break;
+        case REDUCE_BLOCK_MIN:
+        case REDUCE_BLOCK_MAX: {
+            // keep the nearest or farthest return of each block
+            const bool min = d.config.reduction == REDUCE_BLOCK_MIN;
+            const int k = d.config.block;
+            const size_t first = (col / k) * d.out_H;
+            for (int r = 0; r < n_rings; r++) {
+                const int ipx = d.rings[r];
+                const uint32_t range = px.range[ipx];
+                const size_t i = first + r / k;
+                const bool keep = min ? range != 0 && (s.range[i] == 0 ||
+                                                      range < s.range[i])
+                                      : range > s.range[i];
+                if (keep) store(s, i, px, ipx, t);
+            }
+            break;
+        }
+        case REDUCE_VOXEL:
+            for (int r = 0; r < n_rings; r++)
+                if (px.range[d.rings[r]] != 0) add_voxel(d, px, d.rings[r], t);
+            break;
+    }
+}
+
+const decimated_scan& finish_decimated(decimator& d) {
+    // nothing added since the last scan was completed
+    if (!d.started) start_scan(d, d.scan_ts);
+
+    if (d.config.reduction == REDUCE_VOXEL) {
+        decimated_scan& s = d.out;
+        for (size_t i = 0; i < d.n_voxels; i++) {
+            const float inv = 1.0f / d.n_points[i];
+            s.x[i] *= inv;
+            s.y[i] *= inv;
+            s.z[i] *= inv;
+        }
+        s.W = d.n_voxels;
+        s.H = 1;
+    }
+
+    // the next column starts a new scan, even with the same timestamp
+    d.started = false;
+    return d.out;
+}
+}
+}
@@ -0,0 +1,266 @@
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define OS1_DECODE_AVX2
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define OS1_DECODE_NEON
+#endif
+
+#include "ouster/os1_decode.h"
+#include "ouster/os1_packet.h"
+
+namespace ouster {
+namespace OS1 {
+
+namespace {
+
+using decode_fn = void (*)(const uint8_t*, const float*, const float*,
+                           const float*, const float*, const px_planes&);
+using project_fn = void (*)(const uint32_t*, const float*, const float*,
+                            const float*, const float*, int, float*, float*,
+                            float*);
+
+// shared by the vectorized projections for the last n % lanes pixels
+void project_pixels_scalar(const uint32_t* range, const float* lut_x,
+                           const float* lut_y, const float* lut_z,
+                           const float* offset, int n, float* x, float* y,
+                           float* z) {
+    for (int i = 0; i < n; i++) {
+        const uint32_t r = range[i];
+        const float rf = static_cast<float>(r);
+        x[i] = rf * lut_x[i];
+        y[i] = rf * lut_y[i];
+        z[i] = rf * lut_z[i];
+
+        if (offset) {
+            x[i] = r ? x[i] + offset[0] : 0.0f;
+            y[i] = r ? y[i] + offset[1] : 0.0f;
+            z[i] = r ? z[i] + offset[2] : 0.0f;
+        }
+    }
+}
+
+#ifdef OS1_DECODE_AVX2
+
+// narrow eight 32-bit lanes holding 16-bit values and store them
+__attribute__((target("avx2"))) inline void store_u16(uint16_t* dst,
+                                                      __m256i v) {
+    __m256i p = _mm256_packus_epi32(v, v);
+    p = _mm256_permute4x64_epi64(p, 0x08);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                     _mm256_castsi256_si128(p));
+}
+
+// multiply range by the lookup table, then offset returns if requested
+__attribute__((target("avx2"))) inline void store_xyz(
+    float* dst, __m256 rf, __m256 zero, const float* lut, const float* offset,
+    int i) {
+    __m256 v = _mm256_mul_ps(rf, _mm256_loadu_ps(lut));
+    if (offset) {
+        v = _mm256_add_ps(v, _mm256_set1_ps(offset[i]));
+        v = _mm256_andnot_ps(zero, v);
+    }
+    _mm256_storeu_ps(dst, v);
+}
+
+__attribute__((target("avx2"))) void decode_column_avx2(
+    const uint8_t* col_buf, const float* lut_x, const float* lut_y,
+    const float* lut_z, const float* offset, const px_planes& dst) {
+    const bool xyz = dst.x && dst.y && dst.z;
+
+    // byte offsets of eight consecutive 12-byte pixel records
+    const __m256i ofs = _mm256_setr_epi32(0, 12, 24, 36, 48, 60, 72, 84);
+    const __m256i mask_range = _mm256_set1_epi32(0x000fffff);
+    const __m256i mask_u16 = _mm256_set1_epi32(0x0000ffff);
+
+    for (int ipx = 0; ipx < pixels_per_column; ipx += 8) {
+        const int* px_buf = reinterpret_cast<const int*>(nth_px(ipx, col_buf));
+
+        // range | reflectivity, signal | noise
+        const __m256i w0 = _mm256_i32gather_epi32(px_buf, ofs, 1);
+        const __m256i w1 = _mm256_i32gather_epi32(px_buf + 1, ofs, 1);
+        const __m256i w2 = _mm256_i32gather_epi32(px_buf + 2, ofs, 1);
+
+        const __m256i r = _mm256_and_si256(w0, mask_range);
+
+        if (dst.range)
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst.range + ipx),
+                                r);
+        if (dst.reflectivity)
+            store_u16(dst.reflectivity + ipx, _mm256_and_si256(w1, mask_u16));
+        if (dst.signal)
+            store_u16(dst.signal + ipx, _mm256_srli_epi32(w1, 16));
+        if (dst.noise)
+            store_u16(dst.noise + ipx, _mm256_and_si256(w2, mask_u16));
+
+        if (xyz) {
+            const __m256 rf = _mm256_cvtepi32_ps(r);
+            const __m256 zero = _mm256_castsi256_ps(
+                _mm256_cmpeq_epi32(r, _mm256_setzero_si256()));
+            store_xyz(dst.x + ipx, rf, zero, lut_x + ipx, offset, 0);
+            store_xyz(dst.y + ipx, rf, zero, lut_y + ipx, offset, 1);
+            store_xyz(dst.z + ipx, rf, zero, lut_z + ipx, offset, 2);
+        }
+    }
+}
+
+__attribute__((target("avx2"))) void project_pixels_avx2(
+    const uint32_t* range, const float* lut_x, const float* lut_y,
+    const float* lut_z, const float* offset, int n, float* x, float* y,
+    float* z) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i r =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(range + i));
+        const __m256 rf = _mm256_cvtepi32_ps(r);
+        const __m256 zero = _mm256_castsi256_ps(
+            _mm256_cmpeq_epi32(r, _mm256_setzero_si256()));
+        store_xyz(x + i, rf, zero, lut_x + i, offset, 0);
+        store_xyz(y + i, rf, zero, lut_y + i, offset, 1);
+        store_xyz(z + i, rf, zero, lut_z + i, offset, 2);
+    }
+    project_pixels_scalar(range + i, lut_x + i, lut_y + i, lut_z + i, offset,
+                          n - i, x + i, y + i, z + i);
+}
+
+#endif
+
+#ifdef OS1_DECODE_NEON
+
+// multiply range by the lookup table, then offset returns if requested
+inline void store_xyz(float* dst, float32x4_t rf, uint32x4_t zero,
+                      const float* lut, const float* offset, int i) {
+    float32x4_t v = vmulq_f32(rf, vld1q_f32(lut));
+    if (offset) {
+        v = vaddq_f32(v, vdupq_n_f32(offset[i]));
+        v = vreinterpretq_f32_u32(
+            vbicq_u32(vreinterpretq_u32_f32(v), zero));
+    }
+    vst1q_f32(dst, v);
+}
+
+void decode_column_neon(const uint8_t* col_buf, const float* lut_x,
+                        const float* lut_y, const float* lut_z,
+                        const float* offset, const px_planes& dst) {
+    const bool xyz = dst.x && dst.y && dst.z;
+    const uint32x4_t mask_range = vdupq_n_u32(0x000fffff);
+
+    for (int ipx = 0; ipx < pixels_per_column; ipx += 4) {
+        // de-interleave the three words of four 12-byte pixel records
+        const uint32x4x3_t w = vld3q_u32(
+            reinterpret_cast<const uint32_t*>(nth_px(ipx, col_buf)));
+
+        const uint32x4_t r = vandq_u32(w.val[0], mask_range);
+
+        if (dst.range) vst1q_u32(dst.range + ipx, r);
+        if (dst.reflectivity)
+            vst1_u16(dst.reflectivity + ipx, vmovn_u32(w.val[1]));
+        if (dst.signal)
+            vst1_u16(dst.signal + ipx, vmovn_u32(vshrq_n_u32(w.val[1], 16)));
+        if (dst.noise) vst1_u16(dst.noise + ipx, vmovn_u32(w.val[2]));
+
+        if (xyz) {
+            const float32x4_t rf = vcvtq_f32_u32(r);
+            const uint32x4_t zero = vceqq_u32(r, vdupq_n_u32(0));
+            store_xyz(dst.x + ipx, rf, zero, lut_x + ipx, offset, 0);
+            store_xyz(dst.y + ipx, rf, zero, lut_y + ipx, offset, 1);
+            store_xyz(dst.z + ipx, rf, zero, lut_z + ipx, offset, 2);
+        }
+    }
+}
+
+void project_pixels_neon(const uint32_t* range, const float* lut_x,
+                         const float* lut_y, const float* lut_z,
+                         const float* offset, int n, float* x, float* y,
+                         float* z) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const uint32x4_t r = vld1q_u32(range + i);
+        const float32x4_t rf = vcvtq_f32_u32(r);
+        const uint32x4_t zero = vceqq_u32(r, vdupq_n_u32(0));
+        store_xyz(x + i, rf, zero, lut_x + i, offset, 0);
+        store_xyz(y + i, rf, zero, lut_y + i, offset, 1);
+        store_xyz(z + i, rf, zero, lut_z + i, offset, 2);
+    }
+    project_pixels_scalar(range + i, lut_x + i, lut_y + i, lut_z + i, offset,
+                          n - i, x + i, y + i, z + i);
+}
+
+#endif
+
+decode_fn select_decoder() {
+#if defined(OS1_DECODE_AVX2)
+    if (__builtin_cpu_supports("avx2")) return decode_column_avx2;
+#elif defined(OS1_DECODE_NEON)
+    return decode_column_neon;
+#endif
+    return decode_column_scalar;
+}
+
+project_fn select_projection() {
+#if defined(OS1_DECODE_AVX2)
+    if (__builtin_cpu_supports("avx2")) return project_pixels_avx2;
+#elif defined(OS1_DECODE_NEON)
+    return project_pixels_neon;
+#endif
+    return project_pixels_scalar;
+}
+
+const decode_fn decoder = select_decoder();
+const project_fn projection = select_projection();
+}
+
+void decode_column(const uint8_t* col_buf, const float* lut_x,
+                   const float* lut_y, const float* lut_z, const float* offset,
+                   const px_planes& dst) {
+    decoder(col_buf, lut_x, lut_y, lut_z, offset, dst);
+}
+
+void decode_column_scalar(const uint8_t* col_buf, const float* lut_x,
+                          const float* lut_y, const float* lut_z,
+                          const float* offset, const px_planes& dst) {
+    const bool xyz = dst.x && dst.y && dst.z;
+
+    for (int ipx = 0; ipx < pixels_per_column; ipx++) {
+        const uint8_t* px_buf = nth_px(ipx, col_buf);
+        const uint32_t r = px_range(px_buf);
+
+        if (dst.range) dst.range[ipx] = r;
+        if (dst.reflectivity) dst.reflectivity[ipx] = px_reflectivity(px_buf);
+        if (dst.signal) dst.signal[ipx] = px_signal_photons(px_buf);
+        if (dst.noise) dst.noise[ipx] = px_noise_photons(px_buf);
+
+        if (xyz) {
+            // exact for 20-bit ranges, matching the vectorized conversion
+            const float rf = static_cast<float>(r);
+            dst.x[ipx] = rf * lut_x[ipx];
+            dst.y[ipx] = rf * lut_y[ipx];
+            dst.z[ipx] = rf * lut_z[ipx];
+
+            if (offset) {
+                dst.x[ipx] = r ? dst.x[ipx] + offset[0] : 0.0f;
+                dst.y[ipx] = r ? dst.y[ipx] + offset[1] : 0.0f;
+                dst.z[ipx] = r ? dst.z[ipx] + offset[2] : 0.0f;
+            }
+        }
+    }
+}
+
+void project_pixels(const uint32_t* range, const float* lut_x,
+                    const float* lut_y, const float* lut_z, const float* offset,
+                    int n, float* x, float* y, float* z) {
+    projection(range, lut_x, lut_y, lut_z, offset, n, x, y, z);
+}
+
+const char* decode_isa() {
+#if defined(OS1_DECODE_AVX2)
+    if (decoder == decode_column_avx2) return "avx2";
+#elif defined(OS1_DECODE_NEON)
+    if (decoder == decode_column_neon) return "neon";
+#endif
+    return "scalar";
+}
+}
+}
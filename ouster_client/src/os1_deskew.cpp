@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ouster/os1_deskew.h"
+#include "ouster/os1_packet.h"
+
+namespace ouster {
+namespace OS1 {
+
+namespace {
+
+const double standard_gravity = 9.80665;
+
+// the imu reports at 100 Hz, so this covers more than two scans at 10 Hz
+const size_t imu_history = 256;
+
+struct imu_sample {
+    uint64_t ts;
+    double av[3];  // rad/s, lidar frame
+    double la[3];  // m/s^2, lidar frame
+};
+
+// 3x3 row-major matrix products
+void mat_mul(const double* a, const double* b, double* res) {
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            res[3 * i + j] = a[3 * i + 0] * b[0 + j] +
+                             a[3 * i + 1] * b[3 + j] + a[3 * i + 2] * b[6 + j];
+}
+
+void mat_vec(const double* a, const double* v, double* res) {
+    for (int i = 0; i < 3; i++)
+        res[i] =
+            a[3 * i + 0] * v[0] + a[3 * i + 1] * v[1] + a[3 * i + 2] * v[2];
+}
+
+// rotation by the angle-axis vector w * dt (Rodrigues)
+void rotation_of(const double* w, double dt, double* res) {
+    const double r[3] = {w[0] * dt, w[1] * dt, w[2] * dt};
+    const double th2 = r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+
+    // second order expansions near zero avoid dividing by a tiny angle
+    double a, b;
+    if (th2 < 1e-12) {
+        a = 1.0 - th2 / 6.0;
+        b = 0.5 - th2 / 24.0;
+    } else {
+        const double th = std::sqrt(th2);
+        a = std::sin(th) / th;
+        b = (1.0 - std::cos(th)) / th2;
+    }
+
+    const double k[9] = {0, -r[2], r[1], r[2], 0, -r[0], -r[1], r[0], 0};
+    double k2[9];
+    mat_mul(k, k, k2);
+    for (int i = 0; i < 9; i++)
+        res[i] = (i % 4 == 0 ? 1.0 : 0.0) + a * k[i] + b * k2[i];
+}
+}
+
+struct deskewer {
+    deskew_mode mode;
+
+    // rotates imu measurements into the lidar frame
+    double imu_to_lidar[9];
+
+    // sample k is at hist[k % imu_history]; samples [n - size, n) are valid
+    std::array<imu_sample, imu_history> hist;
+    uint64_t n;
+
+    // integration state of the current scan: the pose at t, integrated using
+    // sample k held since its timestamp
+    bool started;
+    uint64_t scan_ts;
+    uint64_t t;
+    uint64_t k;
+    double R[9];
+    double v[3];
+    double p[3];
+    double la0[3];
+};
+
+namespace {
+
+uint64_t oldest(const deskewer& d) {
+    return d.n > imu_history ? d.n - imu_history : 0;
+}
+
+const imu_sample& sample(const deskewer& d, uint64_t k) {
+    return d.hist[k % imu_history];
+}
+
+// start integrating a scan from the newest sample not after scan_ts
+void reset(deskewer& d, uint64_t scan_ts) {
+    d.started = true;
+    d.scan_ts = scan_ts;
+    d.t = scan_ts;
+
+    d.k = d.n - 1;
+    while (d.k > oldest(d) && sample(d, d.k).ts > scan_ts) d.k--;
+
+    for (int i = 0; i < 9; i++) d.R[i] = i % 4 == 0 ? 1.0 : 0.0;
+    for (int i = 0; i < 3; i++) {
+        d.v[i] = 0;
+        d.p[i] = 0;
+        d.la0[i] = sample(d, d.k).la[i];
+    }
+}
+
+// integrate the held sample over dt seconds
+void integrate(deskewer& d, const imu_sample& s, double dt) {
+    if (d.mode == DESKEW_FULL) {
+        // acceleration in the scan start frame, less gravity
+        double a[3];
+        mat_vec(d.R, s.la, a);
+        for (int i = 0; i < 3; i++) {
+            a[i] -= d.la0[i];
+            d.p[i] += d.v[i] * dt + 0.5 * a[i] * dt * dt;
+            d.v[i] += a[i] * dt;
+        }
+    }
+
+    double dR[9], R[9];
+    rotation_of(s.av, dt, dR);
+    mat_mul(d.R, dR, R);
+    for (int i = 0; i < 9; i++) d.R[i] = R[i];
+}
+
+void advance(deskewer& d, uint64_t ts) {
+    // samples overwritten since the last call are skipped
+    if (d.k < oldest(d)) d.k = oldest(d);
+
+    while (d.t < ts) {
+        uint64_t until = ts;
+        const bool next = d.k + 1 < d.n && sample(d, d.k + 1).ts < ts;
+        if (next) until = std::max(sample(d, d.k + 1).ts, d.t);
+
+        integrate(d, sample(d, d.k), (until - d.t) * 1e-9);
+        d.t = until;
+        if (next) d.k++;
+    }
+}
+}
+
+std::shared_ptr<deskewer> init_deskewer(
+    const std::vector<double>& imu_to_sensor_transform,
+    const std::vector<double>& lidar_to_sensor_transform, deskew_mode mode) {
+    auto d = std::make_shared<deskewer>();
+    d->mode = mode;
+    d->n = 0;
+    d->started = false;
+
+    // rotation parts of the 4x4 transforms; identity if missing
+    double imu_rot[9], lidar_rot_t[9];
+    const bool has_imu = imu_to_sensor_transform.size() == 16;
+    const bool has_lidar = lidar_to_sensor_transform.size() == 16;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            const double id = i == j ? 1.0 : 0.0;
+            imu_rot[3 * i + j] =
+                has_imu ? imu_to_sensor_transform[4 * i + j] : id;
+            lidar_rot_t[3 * j + i] =
+                has_lidar ? lidar_to_sensor_transform[4 * i + j] : id;
+        }
+    }
+    mat_mul(lidar_rot_t, imu_rot, d->imu_to_lidar);
+
+    return d;
+}
+
+void add_imu_packet(deskewer& d, const uint8_t* imu_buf) {
+    const uint64_t ts = imu_gyro_ts(imu_buf);
+    if (d.n > 0 && ts <= sample(d, d.n - 1).ts) return;
+
+    const double deg = M_PI / 180.0;
+    const double av[3] = {imu_av_x(imu_buf) * deg, imu_av_y(imu_buf) * deg,
+                          imu_av_z(imu_buf) * deg};
+    const double la[3] = {imu_la_x(imu_buf) * standard_gravity,
+                          imu_la_y(imu_buf) * standard_gravity,
+                          imu_la_z(imu_buf) * standard_gravity};
+
+    imu_sample& s = d.hist[d.n % imu_history];
+    s.ts = ts;
+    mat_vec(d.imu_to_lidar, av, s.av);
+    mat_vec(d.imu_to_lidar, la, s.la);
+    d.n++;
+}
+
+void column_pose(deskewer& d, uint64_t scan_ts, uint64_t ts, float pose[12]) {
+    if (d.n == 0) {
+        for (int i = 0; i < 12; i++) pose[i] = i % 5 == 0 ? 1.0f : 0.0f;
+        return;
+    }
+
+    // columns of a scan arrive in order, so this rarely restarts a scan
+    if (!d.started || scan_ts != d.scan_ts || ts < d.t) reset(d, scan_ts);
+    advance(d, ts);
+
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) pose[4 * i + j] = d.R[3 * i + j];
+        pose[4 * i + 3] = d.p[i];
+    }
+}
+
+void transform_column(const float pose[12], px_column& px) {
+    // branchless, so the compiler can vectorize the loop
+    for (int i = 0; i < pixels_per_column; i++) {
+        const float x = px.x[i], y = px.y[i], z = px.z[i];
+        const float ret = px.range[i] != 0 ? 1.0f : 0.0f;
+        px.x[i] = pose[0] * x + pose[1] * y + pose[2] * z + ret * pose[3];
+        px.y[i] = pose[4] * x + pose[5] * y + pose[6] * z + ret * pose[7];
+        px.z[i] = pose[8] * x + pose[9] * y + pose[10] * z + ret * pose[11];
+    }
+}
+
+void deskew_column(deskewer& d, uint64_t scan_ts, uint64_t ts,
+                   px_column& px) {
+    float pose[12];
+    column_pose(d, scan_ts, ts, pose);
+    transform_column(pose, px);
+}
+}
+}
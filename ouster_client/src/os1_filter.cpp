@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+#include "ouster/os1_filter.h"
+#include "ouster/os1_util.h"
+
+namespace ouster {
+namespace OS1 {
+
+struct scan_filter {
+    int W;
+    int H;
+    std::vector<int> px_offset;
+    filter_config config;
+
+    // destaggered ranges, each row padded with the wrapped around pixel on
+    // both sides so neighbor passes need no bounds checks
+    std::vector<uint32_t> img;
+    std::vector<uint8_t> img_flags;
+    std::vector<uint8_t> count;
+    std::vector<uint8_t> flags;
+};
+
+namespace {
+
+inline uint32_t abs_diff(uint32_t a, uint32_t b) {
+    return std::max(a, b) - std::min(a, b);
+}
+
+// count the returns of n within tol of the returns of c
+void count_similar(const uint32_t* c, const uint32_t* n, int W, uint32_t tol,
+                   uint8_t* count) {
+    for (int v = 0; v < W; v++)
+        count[v] += (n[v] != 0) & (abs_diff(c[v], n[v]) <= tol);
+}
+
+// flag the returns of c farther than those of n by more than jump
+void flag_edges(const uint32_t* c, const uint32_t* n, int W, uint32_t jump,
+                uint8_t* flags) {
+    for (int v = 0; v < W; v++)
+        flags[v] |= ((n[v] != 0) & (c[v] > n[v]) & (c[v] - n[v] > jump)) *
+                    FILTER_EDGE;
+}
+}
+
+std::shared_ptr<scan_filter> init_filter(int W, int H,
+                                         const std::vector<int>& px_offset,
+                                         const filter_config& config) {
+    auto f = std::make_shared<scan_filter>();
+    f->W = W;
+    f->H = H;
+    f->px_offset = px_offset;
+    f->config = config;
+    f->img.resize(H * (W + 2));
+    f->img_flags.resize(H * W);
+    f->count.resize(W);
+    f->flags.resize(W * H);
+    return f;
+}
+
+const std::vector<uint8_t>& filter_scan(scan_filter& f, const uint32_t* range) {
+    const int W = f.W;
+    const int H = f.H;
+    const int P = W + 2;
+    const filter_config& cfg = f.config;
+    const uint32_t max_range = cfg.max_range ? cfg.max_range : UINT32_MAX;
+
+    // destagger and clip ranges
+    for (int u = 0; u < H; u++) {
+        uint32_t* row = f.img.data() + u * P + 1;
+        uint8_t* fl = f.img_flags.data() + u * W;
+
+        destagger_row(range, W, H, u, f.px_offset[u], row,
+                      [](uint32_t r) { return r; });
+
+        for (int v = 0; v < W; v++) {
+            const uint32_t r = row[v];
+            const bool out =
+                (r != 0) & ((r < cfg.min_range) | (r > max_range));
+            row[v] = out ? 0 : r;
+            fl[v] = out * FILTER_RANGE;
+        }
+
+        row[-1] = row[W - 1];
+        row[W] = row[0];
+    }
+
+    for (int u = 0; u < H; u++) {
+        const uint32_t* row = f.img.data() + u * P;
+        const uint32_t* c = row + 1;
+        const uint32_t* above = u > 0 ? row - P : nullptr;
+        const uint32_t* below = u + 1 < H ? row + P : nullptr;
+        uint8_t* fl = f.img_flags.data() + u * W;
+
+        if (cfg.min_neighbors > 0) {
+            uint8_t* count = f.count.data();
+            std::fill(count, count + W, 0);
+
+            // neighbors at column offsets -1, 0, +1 start at row + 0, 1, 2
+            count_similar(c, row, W, cfg.neighbor_range, count);
+            count_similar(c, row + 2, W, cfg.neighbor_range, count);
+            for (const uint32_t* n : {above, below}) {
+                if (!n) continue;
+                for (int dv = 0; dv < 3; dv++)
+                    count_similar(c, n + dv, W, cfg.neighbor_range, count);
+            }
+
+            for (int v = 0; v < W; v++)
+                fl[v] |= ((c[v] != 0) & (count[v] < cfg.min_neighbors)) *
+                         FILTER_ISOLATED;
+        }
+
+        if (cfg.edge_jump > 0) {
+            flag_edges(c, row, W, cfg.edge_jump, fl);
+            flag_edges(c, row + 2, W, cfg.edge_jump, fl);
+            if (above) flag_edges(c, above + 1, W, cfg.edge_jump, fl);
+            if (below) flag_edges(c, below + 1, W, cfg.edge_jump, fl);
+        }
+    }
+
+    // restagger the flags to the order of the scan
+    for (int u = 0; u < H; u++) {
+        const int ofs = f.px_offset[u];
+        const uint8_t* fl = f.img_flags.data() + u * W;
+        uint8_t* col = f.flags.data() + u;
+
+        for (int v = 0; v < W - ofs; v++) col[H * (v + ofs)] = fl[v];
+        for (int v = W - ofs; v < W; v++) col[H * (v + ofs - W)] = fl[v];
+    }
+
+    return f.flags;
+}
+}
+}
@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ouster/os1_frames.h"
+
+namespace ouster {
+namespace OS1 {
+
+namespace {
+
+struct work_queue {
+    std::mutex mtx;
+    std::deque<size_t> items;
+};
+
+// take the lowest item of a queue; stealing from the front too keeps the items
+// in progress close together, so workers rarely wait to deliver
+bool take(work_queue& q, size_t& item) {
+    std::lock_guard<std::mutex> lock{q.mtx};
+    if (q.items.empty()) return false;
+    item = q.items.front();
+    q.items.pop_front();
+    return true;
+}
+}
+
+void run_ordered(size_t n, int n_threads,
+                 const std::function<void(int, size_t)>& work,
+                 const std::function<void(int, size_t)>& deliver) {
+    if (n_threads <= 0) n_threads = std::thread::hardware_concurrency();
+    n_threads = std::max(n_threads, 1);
+
+    std::vector<work_queue> queues(n_threads);
+    for (size_t i = 0; i < n; i++) queues[i % n_threads].items.push_back(i);
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    size_t next = 0;
+
+    auto worker = [&](int w) {
+        size_t item;
+        for (;;) {
+            bool found = take(queues[w], item);
+            for (int k = 1; !found && k < n_threads; k++)
+                found = take(queues[(w + k) % n_threads], item);
+            if (!found) return;
+
+            work(w, item);
+
+            std::unique_lock<std::mutex> lock{mtx};
+            cv.wait(lock, [&] { return next == item; });
+            deliver(w, item);
+            next++;
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int w = 1; w < n_threads; w++) threads.emplace_back(worker, w);
+    worker(0);
+    for (auto& t : threads) t.join();
+}
+}
+}
@@ -0,0 +1,168 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "ouster/os1_metrics.h"
+
+namespace ouster {
+namespace OS1 {
+
+const int latency_histogram::sub_bits;
+const int latency_histogram::max_shift;
+const size_t latency_histogram::n_buckets;
+
+namespace {
+
+// lower bound of the values in a bucket
+uint64_t bucket_start(size_t i) {
+    const size_t sub = size_t{1} << latency_histogram::sub_bits;
+    if (i < sub) return i;
+    const int shift = i / sub - 1;
+    return (uint64_t{sub} + i % sub) << shift;
+}
+
+uint64_t bucket_mid(size_t i) {
+    const size_t sub = size_t{1} << latency_histogram::sub_bits;
+    if (i < sub) return i;
+    const int shift = i / sub - 1;
+    return bucket_start(i) + ((uint64_t{1} << shift) >> 1);
+}
+
+struct registry {
+    std::atomic<uint64_t> counters[n_metric_counters];
+    latency_histogram latencies[n_metric_latencies];
+    latency_histogram depths[n_metric_depths];
+
+    registry() {
+        for (auto& c : counters) c.store(0, std::memory_order_relaxed);
+    }
+};
+
+registry& the_registry() {
+    static registry r;
+    return r;
+}
+}
+
+latency_summary latency_histogram::summary() const {
+    latency_summary res{};
+    res.count = count_.load(std::memory_order_relaxed);
+    res.max = max_.load(std::memory_order_relaxed);
+    if (res.count == 0) return res;
+    res.mean = sum_.load(std::memory_order_relaxed) / res.count;
+
+    // buckets may have been updated after count was read
+    uint64_t total = 0;
+    for (size_t i = 0; i < n_buckets; i++)
+        total += buckets_[i].load(std::memory_order_relaxed);
+
+    const double ps[3] = {0.5, 0.9, 0.99};
+    uint64_t* outs[3] = {&res.p50, &res.p90, &res.p99};
+    uint64_t seen = 0;
+    int k = 0;
+    for (size_t i = 0; i < n_buckets && k < 3; i++) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        while (k < 3 && seen > ps[k] * total) {
+            *outs[k] = bucket_mid(i) < res.max ? bucket_mid(i) : res.max;
+            k++;
+        }
+    }
+    return res;
+}
+
+void latency_histogram::reset() {
+    for (auto& b : buckets_) b.store(0, std::memory_order_relaxed);
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+std::atomic<uint64_t>& metric(metric_counter c) {
+    return the_registry().counters[c];
+}
+
+latency_histogram& metric(metric_latency l) {
+    return the_registry().latencies[l];
+}
+
+latency_histogram& metric(metric_depth d) { return the_registry().depths[d]; }
+
+metrics_snapshot get_metrics() {
+    metrics_snapshot res;
+    for (int i = 0; i < n_metric_counters; i++)
+        res.counters[i] =
+            the_registry().counters[i].load(std::memory_order_relaxed);
+    for (int i = 0; i < n_metric_latencies; i++)
+        res.latencies[i] = the_registry().latencies[i].summary();
+    for (int i = 0; i < n_metric_depths; i++)
+        res.depths[i] = the_registry().depths[i].summary();
+    return res;
+}
+
+void reset_metrics() {
+    for (auto& c : the_registry().counters)
+        c.store(0, std::memory_order_relaxed);
+    for (auto& l : the_registry().latencies) l.reset();
+    for (auto& d : the_registry().depths) d.reset();
+}
+
+const char* to_string(metric_counter c) {
+    switch (c) {
+        case METRIC_LIDAR_PACKETS:
+            return "lidar_packets";
+        case METRIC_IMU_PACKETS:
+            return "imu_packets";
+        case METRIC_DROPPED_PACKETS:
+            return "dropped_packets";
+        case METRIC_MALFORMED_PACKETS:
+            return "malformed_packets";
+        case METRIC_MISSING_COLUMNS:
+            return "missing_columns";
+        case METRIC_FRAMES:
+            return "frames";
+        case METRIC_POOL_ALLOCATIONS:
+            return "pool_allocations";
+        case METRIC_REORDERED_PACKETS:
+            return "reordered_packets";
+        case METRIC_LATE_PACKETS:
+            return "late_packets";
+        case METRIC_QUEUE_DROPS:
+            return "queue_drops";
+        case METRIC_HEAP_ALLOCATIONS:
+            return "heap_allocations";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+const char* to_string(metric_latency l) {
+    switch (l) {
+        case METRIC_FRAME_WAIT:
+            return "frame_wait";
+        case METRIC_DECODE_TIME:
+            return "decode_time";
+        case METRIC_PUBLISH_TIME:
+            return "publish_time";
+        case METRIC_FRAME_LATENCY:
+            return "frame_latency";
+        case METRIC_PUBLISH_LATENCY:
+            return "publish_latency";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+const char* to_string(metric_depth d) {
+    switch (d) {
+        case METRIC_RECEIVE_QUEUE_DEPTH:
+            return "receive_queue_depth";
+        case METRIC_DECODE_QUEUE_DEPTH:
+            return "decode_queue_depth";
+        case METRIC_PUBLISH_QUEUE_DEPTH:
+            return "publish_queue_depth";
+        default:
+            return "UNKNOWN";
+    }
+}
+}
+}
@@ -0,0 +1,348 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ouster/os1.h"
+#include "ouster/os1_multi.h"
+#include "ouster/os1_pipeline.h"
+#include "ouster/os1_ring.h"
+#include "ouster/os1_util.h"
+
+namespace ouster {
+namespace OS1 {
+
+namespace {
+
+// packets read and discarded per call while a ring is full
+const size_t scratch_packets = 32;
+
+// row-major 4x4 product
+std::vector<double> mat4_mul(const std::vector<double>& a,
+                             const std::vector<double>& b) {
+    std::vector<double> res(16, 0);
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            for (int k = 0; k < 4; k++)
+                res[4 * i + j] += a[4 * i + k] * b[4 * k + j];
+    return res;
+}
+
+std::vector<double> identity4() {
+    std::vector<double> res(16, 0);
+    for (int i = 0; i < 4; i++) res[5 * i] = 1;
+    return res;
+}
+}
+
+// per-sensor ring, decode thread and scan buffers
+struct multi_stream {
+    int index;
+    multi_sensor sensor;
+    int W;
+    int H;
+    packet_ring ring;
+
+    // the decoder only takes the lock when the ring is empty
+    std::atomic_bool waiting{false};
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread thread;
+
+    // triple buffer: the decoder fills one scan while the latest complete
+    // scan waits in ready and the fusion thread reads held. Indices, ready_ts
+    // and fresh are guarded by the fusion mutex
+    std::vector<fused_point> bufs[3];
+    int filling{0};
+    int ready{1};
+    int held{2};
+    uint64_t ready_ts{0};
+    bool fresh{false};
+
+    std::atomic<uint64_t> dropped{0};
+
+    multi_stream(int i, const multi_sensor& s, int w, int h, size_t slots)
+        : index{i}, sensor{s}, W{w}, H{h}, ring{slots, lidar_packet_bytes} {
+        for (auto& buf : bufs) buf.resize(W * H);
+    }
+};
+
+struct multi {
+    std::vector<std::shared_ptr<multi_stream>> streams;
+    std::shared_ptr<poller> poll;
+    multi_config config;
+    std::function<void(const fused_frame&)> f;
+    std::vector<uint8_t> scratch;
+
+    std::atomic_bool stop{false};
+    std::atomic_bool error{false};
+    std::mutex fuse_mtx;
+    std::condition_variable fuse_cv;
+
+    std::thread receive_thread;
+    std::thread fuse_thread;
+
+    // make every thread return
+    void stop_all() {
+        stop = true;
+        for (auto& s : streams) {
+            { std::lock_guard<std::mutex> lock{s->mtx}; }
+            s->cv.notify_all();
+        }
+        { std::lock_guard<std::mutex> lock{fuse_mtx}; }
+        fuse_cv.notify_all();
+    }
+
+    ~multi() {
+        stop_all();
+        if (receive_thread.joinable()) receive_thread.join();
+        for (auto& s : streams)
+            if (s->thread.joinable()) s->thread.join();
+        if (fuse_thread.joinable()) fuse_thread.join();
+    }
+};
+
+namespace {
+
+void notify(multi_stream& s) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (s.waiting) {
+        { std::lock_guard<std::mutex> lock{s.mtx}; }
+        s.cv.notify_all();
+    }
+}
+
+void drain_lidar(multi& m, multi_stream& s) {
+    const client& cli = *s.sensor.cli;
+    while (true) {
+        uint8_t* bufs;
+        uint64_t* ts;
+        size_t n_free = s.ring.acquire(&bufs, &ts);
+
+        // malformed packets are skipped, so only the number of datagrams
+        // received tells whether the socket is empty
+        size_t n_received;
+        if (n_free) {
+            const size_t n =
+                read_lidar_packets(cli, bufs, n_free, ts, &n_received);
+            s.ring.commit(n);
+            notify(s);
+        } else {
+            n_free = scratch_packets;
+            const size_t n = read_lidar_packets(
+                cli, m.scratch.data(), n_free, nullptr, &n_received);
+            s.ring.discard(n);
+        }
+        if (n_received < n_free) return;
+    }
+}
+
+void receive_loop(multi& m) {
+    pin_receive_thread(*m.streams.front()->sensor.cli);
+
+    std::vector<client_state> states;
+    while (!m.stop) {
+        client_state st = poll_clients(*m.poll, states, 100);
+
+        // signals are left to the owner
+        if (st == EXIT) continue;
+
+        // without data the other stages have nothing left to do
+        if (st & ERROR) {
+            std::cerr << "multi: polling sensors failed" << std::endl;
+            m.error = true;
+            m.stop_all();
+            return;
+        }
+
+        for (size_t i = 0; i < states.size(); i++) {
+            multi_stream& s = *m.streams[i];
+            if (states[i] & LIDAR_DATA) drain_lidar(m, s);
+            if (states[i] & IMU_DATA)
+                while (read_imu_packet(*s.sensor.cli, m.scratch.data())) {
+                }
+        }
+    }
+}
+
+// hand a complete scan to the fusion thread
+void complete_scan(multi& m, multi_stream& s, uint64_t scan_ts) {
+    {
+        std::lock_guard<std::mutex> lock{m.fuse_mtx};
+        std::swap(s.filling, s.ready);
+        if (s.fresh) s.dropped++;
+        s.fresh = true;
+        s.ready_ts = scan_ts;
+    }
+    m.fuse_cv.notify_one();
+}
+
+// batch the packets of a sensor until stopped, with a batcher specialized for
+// scans of W columns
+template <int W>
+void batch_stream(multi& m, multi_stream& s, const xyz_lut& lut) {
+    const uint8_t sensor = s.index;
+    fused_point* it = s.bufs[s.filling].data();
+    auto batch = make_scan_batcher<W, pixels_per_column, fused_point*>(
+        lut, fused_point{},
+        [sensor](float x, float y, float z, uint16_t signal, uint32_t t,
+                 uint16_t reflectivity, uint8_t ring, uint16_t noise,
+                 uint32_t range) {
+            return fused_point{x, y, z, t, range, signal, reflectivity,
+                               noise, ring, sensor};
+        },
+        [&](uint64_t scan_ts) {
+            complete_scan(m, s, scan_ts);
+            it = s.bufs[s.filling].data();
+        });
+
+    while (!m.stop) {
+        if (!s.ring.size()) {
+            std::unique_lock<std::mutex> lock{s.mtx};
+            s.waiting = true;
+            s.cv.wait_for(lock, std::chrono::milliseconds{100},
+                          [&] { return s.ring.size() || m.stop; });
+            s.waiting = false;
+        }
+
+        while (const uint8_t* buf = s.ring.front()) {
+            batch(buf, it);
+            s.ring.pop();
+        }
+    }
+}
+
+void decode_loop(multi& m, multi_stream& s) {
+    thread_config cfg{};
+    if (s.sensor.decode_cpu >= 0) cfg.cpus.push_back(s.sensor.decode_cpu);
+    configure_thread(cfg);
+
+    // fold the extrinsic, with its translation converted to mm, into the lut
+    std::vector<double> extrinsic =
+        s.sensor.extrinsic.empty() ? identity4() : s.sensor.extrinsic;
+    for (int i = 0; i < 3; i++) extrinsic[4 * i + 3] *= 1000;
+    const std::vector<double>& lidar_to_sensor =
+        s.sensor.info.lidar_to_sensor_transform.size() == 16
+            ? s.sensor.info.lidar_to_sensor_transform
+            : identity4();
+    const auto lut = make_xyz_lut(s.W, s.H, s.sensor.info.beam_azimuth_angles,
+                                  s.sensor.info.beam_altitude_angles,
+                                  mat4_mul(extrinsic, lidar_to_sensor));
+
+    switch (s.W) {
+        case 512:
+            return batch_stream<512>(m, s, lut);
+        case 1024:
+            return batch_stream<1024>(m, s, lut);
+        default:
+            return batch_stream<2048>(m, s, lut);
+    }
+}
+
+void fuse_loop(multi& m) {
+    const auto slice = std::chrono::milliseconds{m.config.slice_ms};
+    auto next = std::chrono::steady_clock::now() + slice;
+
+    auto all_fresh = [&] {
+        for (auto& s : m.streams)
+            if (!s->fresh) return false;
+        return true;
+    };
+    auto done = [&] { return m.stop || (m.config.wait_all && all_fresh()); };
+
+    fused_frame frame;
+    frame.scans.reserve(m.streams.size());
+
+    std::unique_lock<std::mutex> lock{m.fuse_mtx};
+    while (!m.stop) {
+        if (m.config.slice_ms > 0)
+            m.fuse_cv.wait_until(lock, next, done);
+        else
+            m.fuse_cv.wait(lock, done);
+        if (m.stop) break;
+
+        frame.scans.clear();
+        for (auto& s : m.streams) {
+            if (!s->fresh) continue;
+            std::swap(s->ready, s->held);
+            s->fresh = false;
+            frame.scans.push_back(fused_scan{s->index, s->W, s->H, s->ready_ts,
+                                             s->bufs[s->held].data()});
+        }
+        next = std::chrono::steady_clock::now() + slice;
+        if (frame.scans.empty()) continue;
+
+        frame.ts = frame.scans.front().scan_ts;
+        for (const auto& scan : frame.scans)
+            frame.ts = std::min(frame.ts, scan.scan_ts);
+
+        // held buffers are left alone by the decoders while unlocked
+        lock.unlock();
+        m.f(frame);
+        lock.lock();
+    }
+}
+}
+
+std::shared_ptr<multi> start_multi(
+    const std::vector<multi_sensor>& sensors, const multi_config& config,
+    std::function<void(const fused_frame&)> f) {
+    if (sensors.empty() || sensors.size() > 256) {
+        std::cerr << "multi: expected 1 to 256 sensors" << std::endl;
+        return std::shared_ptr<multi>();
+    }
+    if (!config.wait_all && config.slice_ms <= 0) {
+        std::cerr << "multi: frames are never emitted" << std::endl;
+        return std::shared_ptr<multi>();
+    }
+
+    auto m = std::make_shared<multi>();
+    m->config = config;
+    m->f = std::move(f);
+    m->scratch.resize(scratch_packets * lidar_packet_bytes);
+    m->poll = init_poller();
+    if (!m->poll) return std::shared_ptr<multi>();
+
+    for (size_t i = 0; i < sensors.size(); i++) {
+        const multi_sensor& s = sensors[i];
+        const int H = pixels_per_column;
+        if (!s.cli || s.info.mode < MODE_512x10 || s.info.mode > MODE_2048x10 ||
+            s.info.beam_azimuth_angles.size() != pixels_per_column ||
+            s.info.beam_altitude_angles.size() != pixels_per_column ||
+            (!s.extrinsic.empty() && s.extrinsic.size() != 16)) {
+            std::cerr << "multi: invalid sensor " << i << std::endl;
+            return std::shared_ptr<multi>();
+        }
+        if (add_client(*m->poll, *s.cli) != static_cast<int>(i))
+            return std::shared_ptr<multi>();
+
+        const int W = n_cols_of_lidar_mode(s.info.mode);
+        m->streams.push_back(
+            std::make_shared<multi_stream>(i, s, W, H, config.ring_slots));
+    }
+
+    m->fuse_thread = std::thread{fuse_loop, std::ref(*m)};
+    for (auto& s : m->streams)
+        s->thread = std::thread{decode_loop, std::ref(*m), std::ref(*s)};
+    m->receive_thread = std::thread{receive_loop, std::ref(*m)};
+
+    return m;
+}
+
+uint64_t dropped_scans(const multi& m, int sensor) {
+    return m.streams.at(sensor)->dropped.load(std::memory_order_relaxed);
+}
+
+uint64_t dropped_packets(const multi& m, int sensor) {
+    return m.streams.at(sensor)->ring.overflows();
+}
+
+bool multi_failed(const multi& m) { return m.error; }
+}
+}
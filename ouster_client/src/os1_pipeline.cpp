@@ -0,0 +1,41 @@
+#include <pthread.h>
+#include <sched.h>
+
+#include <cstring>
+#include <iostream>
+
+#include "ouster/os1_pipeline.h"
+
+namespace ouster {
+namespace OS1 {
+
+bool configure_thread(const thread_config& cfg) {
+    bool ok = true;
+
+    if (!cfg.cpus.empty()) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu : cfg.cpus)
+            if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &cpus);
+        int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (ret != 0) {
+            std::cerr << "pthread_setaffinity_np: " << std::strerror(ret)
+                      << std::endl;
+            ok = false;
+        }
+    }
+
+    if (cfg.fifo_priority > 0) {
+        sched_param param{};
+        param.sched_priority = cfg.fifo_priority;
+        int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (ret != 0) {
+            std::cerr << "pthread_setschedparam: " << std::strerror(ret)
+                      << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+}
+}
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "ouster/os1.h"
+#include "ouster/os1_ring.h"
+
+namespace ouster {
+namespace OS1 {
+
+const size_t packet_ring::cache_line;
+
+// read_lidar_packets writes consecutive packets lidar_packet_bytes apart
+static_assert(lidar_packet_bytes % packet_ring::cache_line == 0,
+              "lidar ring slots must be contiguous");
+
+namespace {
+
+size_t next_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+// packets read and discarded per call while a ring is full
+const size_t scratch_packets = 32;
+}
+
+packet_ring::packet_ring(size_t n_slots, size_t slot_bytes)
+    : mask_{next_pow2(std::max<size_t>(n_slots, 1)) - 1},
+      stride_{(slot_bytes + cache_line - 1) / cache_line * cache_line},
+      data_{nullptr},
+      ts_{nullptr},
+      head_{0},
+      tail_{0},
+      overflows_{0} {
+    void* p = nullptr;
+    if (posix_memalign(&p, cache_line, capacity() * stride_) != 0)
+        throw std::bad_alloc{};
+    data_ = static_cast<uint8_t*>(p);
+
+    // touch every page up front so the receive path never faults
+    std::memset(data_, 0, capacity() * stride_);
+    ts_ = new uint64_t[capacity()]();
+}
+
+packet_ring::~packet_ring() {
+    std::free(data_);
+    delete[] ts_;
+}
+
+size_t packet_ring::acquire(uint8_t** bufs, uint64_t** ts) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    const size_t idx = head & mask_;
+
+    *bufs = data_ + idx * stride_;
+    *ts = ts_ + idx;
+    return std::min(capacity() - (head - tail), capacity() - idx);
+}
+
+void packet_ring::commit(size_t n) {
+    head_.store(head_.load(std::memory_order_relaxed) + n,
+                std::memory_order_release);
+}
+
+const uint8_t* packet_ring::front(uint64_t* ts) const {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t head = head_.load(std::memory_order_acquire);
+    if (tail == head) return nullptr;
+
+    const size_t idx = tail & mask_;
+    if (ts) *ts = ts_[idx];
+    return data_ + idx * stride_;
+}
+
+void packet_ring::pop() {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+}
+
+size_t packet_ring::size() const {
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    return head_.load(std::memory_order_acquire) - tail;
+}
+
+struct receiver {
+    std::shared_ptr<client> cli;
+    std::shared_ptr<poller> poll;
+    packet_ring lidar;
+    packet_ring imu;
+    std::vector<uint8_t> scratch;
+
+    std::atomic_bool stop{false};
+    std::atomic_bool error{false};
+
+    // consumers only take the lock when the rings are empty
+    std::atomic_bool waiting{false};
+    std::mutex mtx;
+    std::condition_variable cv;
+
+    std::thread thread;
+
+    receiver(std::shared_ptr<client> c, size_t n_lidar_slots,
+             size_t n_imu_slots)
+        : cli{c},
+          poll{init_poller()},
+          lidar{n_lidar_slots, lidar_packet_bytes},
+          imu{n_imu_slots, imu_packet_bytes + 1},
+          scratch(scratch_packets * lidar_packet_bytes) {}
+
+    ~receiver() {
+        stop = true;
+        if (thread.joinable()) thread.join();
+    }
+};
+
+namespace {
+
+void notify(receiver& r) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (r.waiting) {
+        { std::lock_guard<std::mutex> lock{r.mtx}; }
+        r.cv.notify_all();
+    }
+}
+
+void drain_lidar(receiver& r) {
+    while (true) {
+        uint8_t* bufs;
+        uint64_t* ts;
+        size_t n_free = r.lidar.acquire(&bufs, &ts);
+
+        // malformed packets are skipped, so only the number of datagrams
+        // received tells whether the socket is empty
+        size_t n_received;
+        if (n_free) {
+            const size_t n =
+                read_lidar_packets(*r.cli, bufs, n_free, ts, &n_received);
+            r.lidar.commit(n);
+            notify(r);
+        } else {
+            n_free = scratch_packets;
+            const size_t n = read_lidar_packets(
+                *r.cli, r.scratch.data(), n_free, nullptr, &n_received);
+            r.lidar.discard(n);
+        }
+        if (n_received < n_free) return;
+    }
+}
+
+void drain_imu(receiver& r) {
+    while (true) {
+        uint8_t* buf;
+        uint64_t* ts;
+        if (r.imu.acquire(&buf, &ts)) {
+            if (!read_imu_packet(*r.cli, buf, ts)) return;
+            r.imu.commit(1);
+            notify(r);
+        } else {
+            if (!read_imu_packet(*r.cli, r.scratch.data())) return;
+            r.imu.discard(1);
+        }
+    }
+}
+
+void receive_loop(receiver& r) {
+    pin_receive_thread(*r.cli);
+
+    std::vector<client_state> states;
+    while (!r.stop) {
+        client_state st = poll_clients(*r.poll, states, 100);
+
+        // signals are left to the owner of the receiver
+        if (st == EXIT) continue;
+
+        if (st & ERROR) {
+            r.error = true;
+            notify(r);
+            return;
+        }
+
+        if (st & LIDAR_DATA) drain_lidar(r);
+        if (st & IMU_DATA) drain_imu(r);
+    }
+}
+}
+
+std::shared_ptr<receiver> start_receiver(std::shared_ptr<client> cli,
+                                         size_t n_lidar_slots,
+                                         size_t n_imu_slots) {
+    if (!cli) return std::shared_ptr<receiver>();
+
+    auto r = std::make_shared<receiver>(cli, n_lidar_slots, n_imu_slots);
+    if (!r->poll || add_client(*r->poll, *cli) < 0)
+        return std::shared_ptr<receiver>();
+
+    r->thread = std::thread{receive_loop, std::ref(*r)};
+    return r;
+}
+
+packet_ring& lidar_ring(receiver& r) { return r.lidar; }
+
+packet_ring& imu_ring(receiver& r) { return r.imu; }
+
+client_state wait_receiver(receiver& r, const int timeout_ms) {
+    auto ready = [&] { return r.lidar.size() || r.imu.size() || r.error; };
+
+    if (!ready()) {
+        std::unique_lock<std::mutex> lock{r.mtx};
+        r.waiting = true;
+        r.cv.wait_for(lock, std::chrono::milliseconds{timeout_ms}, ready);
+        r.waiting = false;
+    }
+
+    client_state res = client_state(0);
+    if (r.lidar.size()) res = client_state(res | LIDAR_DATA);
+    if (r.imu.size()) res = client_state(res | IMU_DATA);
+    if (r.error) res = client_state(res | ERROR);
+    return res;
+}
+}
+}
@@ -0,0 +1,495 @@
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "ouster/os1.h"
+#include "ouster/os1_shm.h"
+
+namespace ouster {
+namespace OS1 {
+
+namespace {
+
+const char shm_magic[8] = {'O', 'S', '1', 'S', 'H', 'M', 0, 0};
+const uint32_t shm_version = 2;
+const size_t cache_line = 64;
+const int n_streams = 3;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "shared counters must be lock-free");
+
+struct ring_desc {
+    uint64_t offset;  // of the first slot from the start of the object
+    uint64_t slot_bytes;
+    uint64_t stride;  // distance between slots, including the slot header
+    uint64_t n_slots;
+};
+
+// written by the publisher, except for waiters
+struct alignas(cache_line) ring_ctl {
+    std::atomic<uint64_t> head;     // number of slots committed
+    std::atomic<uint32_t> futex;    // bumped on commits while readers wait
+    std::atomic<uint32_t> waiters;  // readers blocked in wait_shm
+};
+
+struct shm_header {
+    char magic[8];
+    uint32_t version;
+    int32_t W;
+    int32_t H;
+    uint32_t scan_layout;
+    uint64_t point_bytes;
+    uint64_t total_bytes;
+    uint64_t metadata_offset;
+    uint64_t metadata_bytes;
+    // set once the publisher is destroyed or replaced
+    std::atomic<uint32_t> closed;
+    ring_desc rings[n_streams];
+    ring_ctl ctl[n_streams];
+};
+
+// precedes the data of each slot, on its own cache line
+struct slot_header {
+    // 2 * (n + 1) once the n-th slot of the ring is committed here, odd while
+    // it is written
+    std::atomic<uint64_t> seq;
+    uint64_t ts;
+};
+
+size_t aligned(size_t n) {
+    return (n + cache_line - 1) / cache_line * cache_line;
+}
+
+size_t next_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+size_t channels_bytes(int W, int H) {
+    return size_t(W) * H * (sizeof(uint32_t) + 3 * sizeof(uint16_t)) +
+           size_t(W) * (sizeof(uint64_t) + sizeof(uint32_t));
+}
+
+slot_header* slot_at(uint8_t* base, const ring_desc& d, uint64_t n) {
+    return reinterpret_cast<slot_header*>(base + d.offset +
+                                          (n & (d.n_slots - 1)) * d.stride);
+}
+
+uint8_t* slot_data(slot_header* h) {
+    return reinterpret_cast<uint8_t*>(h) + cache_line;
+}
+
+int futex(std::atomic<uint32_t>& word, int op, uint32_t val,
+          const struct timespec* timeout) {
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), op, val,
+                   timeout, nullptr, 0);
+}
+
+// the planes of a scan_channels in the order of the SHM_SCAN_CHANNELS layout
+template <typename S, typename F>
+void for_each_plane(S& scan, F&& f) {
+    f(scan.range.data(), scan.range.size() * sizeof(uint32_t));
+    f(scan.signal.data(), scan.signal.size() * sizeof(uint16_t));
+    f(scan.reflectivity.data(), scan.reflectivity.size() * sizeof(uint16_t));
+    f(scan.noise.data(), scan.noise.size() * sizeof(uint16_t));
+    f(scan.col_ts.data(), scan.col_ts.size() * sizeof(uint64_t));
+    f(scan.col_encoder.data(), scan.col_encoder.size() * sizeof(uint32_t));
+}
+
+bool map_object(int fd, size_t size, uint8_t*& base, int flags) {
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | flags,
+                   fd, 0);
+    if (p == MAP_FAILED) return false;
+    base = static_cast<uint8_t*>(p);
+    return true;
+}
+
+// flag the object as closed and wake its blocked readers to notice
+void close_object(shm_header& h) {
+    h.closed.store(1, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (ring_ctl& ctl : h.ctl) {
+        if (!ctl.waiters.load(std::memory_order_relaxed)) continue;
+        ctl.futex.fetch_add(1, std::memory_order_relaxed);
+        futex(ctl.futex, FUTEX_WAKE, INT_MAX, nullptr);
+    }
+}
+
+// close the object left by a previous publisher of the same name, which may
+// have exited without closing it
+void close_previous(const std::string& name) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) return;
+
+    struct stat st;
+    uint8_t* base = nullptr;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(shm_header) &&
+        map_object(fd, st.st_size, base, 0)) {
+        shm_header& h = *reinterpret_cast<shm_header*>(base);
+        if (!std::memcmp(h.magic, shm_magic, sizeof(shm_magic)) &&
+            h.version == shm_version)
+            close_object(h);
+        munmap(base, st.st_size);
+    }
+    close(fd);
+}
+
+// whether the name still refers to the object with this device and inode
+bool same_object(const std::string& name, dev_t dev, ino_t ino) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    const bool same =
+        fstat(fd, &st) == 0 && st.st_dev == dev && st.st_ino == ino;
+    close(fd);
+    return same;
+}
+
+// expected size of a slot of the scan ring
+size_t scan_slot_bytes(int W, int H, uint32_t layout, size_t point_bytes) {
+    if (W <= 0 || H <= 0) return 0;
+    if (layout == SHM_SCAN_CHANNELS) return channels_bytes(W, H);
+    if (layout == SHM_SCAN_POINTS) return size_t(W) * H * point_bytes;
+    return 0;
+}
+}
+
+struct shm_publisher {
+    std::string name;
+    uint8_t* base{nullptr};
+    size_t size{0};
+    dev_t dev{0};
+    ino_t ino{0};
+    uint64_t next[n_streams]{};  // slot being written, mirrors head
+
+    shm_header& header() { return *reinterpret_cast<shm_header*>(base); }
+
+    ~shm_publisher() {
+        if (!base) return;
+        close_object(header());
+        munmap(base, size);
+        // the name may already belong to a new publisher
+        if (same_object(name, dev, ino)) shm_unlink(name.c_str());
+    }
+};
+
+struct shm_reader {
+    uint8_t* base{nullptr};
+    size_t size{0};
+    shm_info info;
+    uint64_t next[n_streams]{};  // next slot to read
+    uint64_t reading[n_streams]{};  // seq of the slot being read, or 0
+    uint64_t overruns[n_streams]{};
+
+    shm_header& header() { return *reinterpret_cast<shm_header*>(base); }
+    const shm_header& header() const {
+        return *reinterpret_cast<const shm_header*>(base);
+    }
+
+    ~shm_reader() {
+        if (base) munmap(base, size);
+    }
+};
+
+std::shared_ptr<shm_publisher> init_shm_publisher(const std::string& name,
+                                                  const std::string& metadata,
+                                                  int W, int H,
+                                                  const shm_config& cfg) {
+    const size_t scan_bytes =
+        scan_slot_bytes(W, H, cfg.scan_layout, cfg.point_bytes);
+    if (!scan_bytes) {
+        std::cerr << "shm: invalid scan dimensions or layout" << std::endl;
+        return std::shared_ptr<shm_publisher>();
+    }
+
+    // lay out the header, metadata and rings on separate cache lines
+    const size_t metadata_offset = aligned(sizeof(shm_header));
+    const size_t slot_bytes[n_streams] = {lidar_packet_bytes,
+                                          imu_packet_bytes, scan_bytes};
+    const size_t n_slots[n_streams] = {cfg.lidar_slots, cfg.imu_slots,
+                                       cfg.scan_slots};
+    ring_desc rings[n_streams];
+    size_t offset = aligned(metadata_offset + metadata.size());
+    for (int s = 0; s < n_streams; s++) {
+        ring_desc& d = rings[s];
+        d.offset = offset;
+        d.slot_bytes = slot_bytes[s];
+        d.stride = cache_line + aligned(slot_bytes[s]);
+        d.n_slots = next_pow2(std::max<size_t>(n_slots[s], 1));
+        offset += d.stride * d.n_slots;
+    }
+
+    // readers of a previous publisher keep their mapping of the old object,
+    // which is flagged as closed so that they reopen the new one
+    close_previous(name);
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, cfg.mode);
+    if (fd < 0) {
+        std::cerr << "shm: failed to create " << name << ": "
+                  << std::strerror(errno) << std::endl;
+        return std::shared_ptr<shm_publisher>();
+    }
+
+    auto p = std::make_shared<shm_publisher>();
+    p->name = name;
+    p->size = offset;
+
+    // readers map the object writable to wait, so apply the mode in full
+    // rather than as masked by the umask. Populate the mapping up front so
+    // publishing never faults
+    struct stat st;
+    const bool ok = fchmod(fd, cfg.mode) == 0 && fstat(fd, &st) == 0 &&
+                    ftruncate(fd, p->size) == 0 &&
+                    map_object(fd, p->size, p->base, MAP_POPULATE);
+    close(fd);
+    if (!ok) {
+        std::cerr << "shm: failed to map " << name << ": "
+                  << std::strerror(errno) << std::endl;
+        if (!p->base) shm_unlink(name.c_str());
+        return std::shared_ptr<shm_publisher>();
+    }
+    p->dev = st.st_dev;
+    p->ino = st.st_ino;
+
+    // the object is zeroed, so every counter starts at 0. Readers check the
+    // magic, which is written last
+    shm_header& h = p->header();
+    h.version = shm_version;
+    h.W = W;
+    h.H = H;
+    h.scan_layout = cfg.scan_layout;
+    h.point_bytes = cfg.point_bytes;
+    h.total_bytes = p->size;
+    h.metadata_offset = metadata_offset;
+    h.metadata_bytes = metadata.size();
+    std::copy(rings, rings + n_streams, h.rings);
+    std::memcpy(p->base + metadata_offset, metadata.data(), metadata.size());
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(h.magic, shm_magic, sizeof(h.magic));
+
+    return p;
+}
+
+uint8_t* begin_shm_write(shm_publisher& p, shm_stream s) {
+    const uint64_t n = p.next[s];
+    slot_header* slot = slot_at(p.base, p.header().rings[s], n);
+
+    // readers that see any of the new data also see the odd sequence number
+    slot->seq.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return slot_data(slot);
+}
+
+void commit_shm_write(shm_publisher& p, shm_stream s, uint64_t ts) {
+    const uint64_t n = p.next[s]++;
+    ring_ctl& ctl = p.header().ctl[s];
+    slot_header* slot = slot_at(p.base, p.header().rings[s], n);
+
+    slot->ts = ts;
+    slot->seq.store(2 * n + 2, std::memory_order_release);
+    ctl.head.store(n + 1, std::memory_order_release);
+
+    // pairs with the fence in wait_shm, so a reader about to block either
+    // sees the new head or is woken
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ctl.waiters.load(std::memory_order_relaxed)) {
+        ctl.futex.fetch_add(1, std::memory_order_relaxed);
+        futex(ctl.futex, FUTEX_WAKE, INT_MAX, nullptr);
+    }
+}
+
+void publish_shm_packet(shm_publisher& p, shm_stream s, const uint8_t* buf,
+                        uint64_t ts) {
+    uint8_t* slot = begin_shm_write(p, s);
+    std::memcpy(slot, buf, p.header().rings[s].slot_bytes);
+    commit_shm_write(p, s, ts);
+}
+
+bool publish_shm_scan(shm_publisher& p, const scan_channels& scan,
+                      uint64_t scan_ts) {
+    const shm_header& h = p.header();
+    if (h.scan_layout != SHM_SCAN_CHANNELS || scan.W != h.W || scan.H != h.H)
+        return false;
+
+    uint8_t* slot = begin_shm_write(p, SHM_SCANS);
+    for_each_plane(scan, [&](const void* plane, size_t bytes) {
+        std::memcpy(slot, plane, bytes);
+        slot += bytes;
+    });
+    commit_shm_write(p, SHM_SCANS, scan_ts);
+    return true;
+}
+
+std::shared_ptr<shm_reader> open_shm_reader(const std::string& name) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        std::cerr << "shm: failed to open " << name << ": "
+                  << std::strerror(errno) << std::endl;
+        return std::shared_ptr<shm_reader>();
+    }
+
+    // readers only write the waiter counts of the rings
+    struct stat st;
+    auto r = std::make_shared<shm_reader>();
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(shm_header) &&
+        map_object(fd, st.st_size, r->base, 0))
+        r->size = st.st_size;
+    close(fd);
+
+    bool valid = r->base &&
+                 !std::memcmp(r->header().magic, shm_magic, sizeof(shm_magic));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    shm_header& h = r->header();
+    valid = valid && h.version == shm_version && h.total_bytes <= r->size &&
+            h.metadata_offset <= r->size &&
+            h.metadata_bytes <= r->size - h.metadata_offset;
+
+    // slots are addressed from the ring layout, which must fit the object
+    const size_t slot_bytes[n_streams] = {
+        lidar_packet_bytes, imu_packet_bytes,
+        scan_slot_bytes(h.W, h.H, h.scan_layout, h.point_bytes)};
+    for (int s = 0; valid && s < n_streams; s++) {
+        const ring_desc& d = h.rings[s];
+        valid = d.slot_bytes && d.slot_bytes == slot_bytes[s] &&
+                d.stride >= cache_line + d.slot_bytes && d.n_slots &&
+                !(d.n_slots & (d.n_slots - 1)) && d.offset <= r->size &&
+                d.n_slots <= (r->size - d.offset) / d.stride;
+    }
+    if (!valid) {
+        std::cerr << "shm: " << name << " is not a valid publisher"
+                  << std::endl;
+        return std::shared_ptr<shm_reader>();
+    }
+
+    r->info.W = h.W;
+    r->info.H = h.H;
+    r->info.scan_layout = static_cast<shm_scan_layout>(h.scan_layout);
+    r->info.point_bytes = h.point_bytes;
+    r->info.scan_bytes = h.rings[SHM_SCANS].slot_bytes;
+    r->info.metadata.assign(
+        reinterpret_cast<const char*>(r->base + h.metadata_offset),
+        h.metadata_bytes);
+
+    for (int s = 0; s < n_streams; s++)
+        r->next[s] = h.ctl[s].head.load(std::memory_order_acquire);
+    return r;
+}
+
+const shm_info& get_shm_info(const shm_reader& r) { return r.info; }
+
+const uint8_t* begin_shm_read(shm_reader& r, shm_stream s, uint64_t* ts) {
+    const ring_desc& d = r.header().rings[s];
+    const ring_ctl& ctl = r.header().ctl[s];
+    r.reading[s] = 0;
+
+    while (true) {
+        const uint64_t head = ctl.head.load(std::memory_order_acquire);
+        if (r.next[s] >= head) return nullptr;
+
+        // the oldest slot may already be overwritten again
+        if (head - r.next[s] >= d.n_slots) {
+            const uint64_t oldest = head - d.n_slots + 1;
+            r.overruns[s] += oldest - r.next[s];
+            r.next[s] = oldest;
+        }
+
+        slot_header* slot = slot_at(r.base, d, r.next[s]);
+        const uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        if (seq != 2 * r.next[s] + 2) {
+            r.overruns[s]++;
+            r.next[s]++;
+            continue;
+        }
+
+        r.reading[s] = seq;
+        if (ts) *ts = slot->ts;
+        return slot_data(slot);
+    }
+}
+
+bool end_shm_read(shm_reader& r, shm_stream s) {
+    if (!r.reading[s]) return false;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    slot_header* slot = slot_at(r.base, r.header().rings[s], r.next[s]);
+    const bool intact =
+        slot->seq.load(std::memory_order_relaxed) == r.reading[s];
+
+    r.reading[s] = 0;
+    r.next[s]++;
+    if (!intact) r.overruns[s]++;
+    return intact;
+}
+
+bool read_shm_scan(shm_reader& r, scan_channels& scan, uint64_t& scan_ts) {
+    const shm_info& info = r.info;
+    if (info.scan_layout != SHM_SCAN_CHANNELS || scan.W != info.W ||
+        scan.H != info.H)
+        return false;
+
+    // a scan overwritten while it was copied is skipped for the next one
+    while (const uint8_t* slot = begin_shm_read(r, SHM_SCANS, &scan_ts)) {
+        for_each_plane(scan, [&](void* plane, size_t bytes) {
+            std::memcpy(plane, slot, bytes);
+            slot += bytes;
+        });
+        if (end_shm_read(r, SHM_SCANS)) return true;
+    }
+    return false;
+}
+
+uint64_t shm_overruns(const shm_reader& r, shm_stream s) {
+    return r.overruns[s];
+}
+
+bool shm_closed(const shm_reader& r) {
+    return r.header().closed.load(std::memory_order_acquire);
+}
+
+bool wait_shm(shm_reader& r, shm_stream s, int timeout_ms) {
+    ring_ctl& ctl = r.header().ctl[s];
+    auto available = [&] {
+        return ctl.head.load(std::memory_order_acquire) > r.next[s];
+    };
+    if (available()) return true;
+
+    using clock = std::chrono::steady_clock;
+    const auto deadline = clock::now() + std::chrono::milliseconds{timeout_ms};
+
+    ctl.waiters.fetch_add(1, std::memory_order_relaxed);
+    while (true) {
+        const uint32_t word = ctl.futex.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (available() || shm_closed(r)) break;
+
+        // wakes may also be for slots committed before the check above
+        const auto left = deadline - clock::now();
+        if (left <= clock::duration::zero()) break;
+        const auto ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+        struct timespec timeout;
+        timeout.tv_sec = ns / 1000000000;
+        timeout.tv_nsec = ns % 1000000000;
+        futex(ctl.futex, FUTEX_WAIT, word, &timeout);
+    }
+    ctl.waiters.fetch_sub(1, std::memory_order_relaxed);
+
+    return available();
+}
+}
+}
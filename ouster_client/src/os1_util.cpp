@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <cmath>
+#include <memory>
 #include <vector>
 
 #include "ouster/os1_packet.h"
+#include "ouster/os1_util.h"
 
 namespace ouster {
 namespace OS1 {
@@ -57,6 +60,120 @@ std::vector<double> make_xyz_lut(int W, int H,
     return xyz;
 }
 
+xyz_lut make_xyz_lut(int W, int H,
+                     const std::vector<double>& azimuth_angles,
+                     const std::vector<double>& altitude_angles,
+                     const std::vector<double>& transform) {
+    const std::vector<double> xyz =
+        make_xyz_lut(W, H, azimuth_angles, altitude_angles);
+    const bool has_transform = transform.size() == 16;
+
+    xyz_lut lut{W, H, {}, {}, {}, {{0, 0, 0}}};
+    std::vector<float>* planes[3] = {&lut.x, &lut.y, &lut.z};
+
+    for (int k = 0; k < 3; k++) {
+        std::vector<float>& plane = *planes[k];
+        plane.resize(W * H);
+
+        // rotate unit vectors and fold in the mm -> m conversion
+        for (int i = 0; i < W * H; i++) {
+            const double* v = &xyz[3 * i];
+            double r = v[k];
+            if (has_transform)
+                r = transform[4 * k + 0] * v[0] + transform[4 * k + 1] * v[1] +
+                    transform[4 * k + 2] * v[2];
+            plane[i] = 0.001 * r;
+        }
+
+        if (has_transform) lut.offset[k] = 0.001 * transform[4 * k + 3];
+    }
+
+    return lut;
+}
+
+void project_xyz(const xyz_lut& lut, const uint32_t* range, int first_col,
+                 int n_cols, int first_row, int n_rows, float* x, float* y,
+                 float* z) {
+    const int W = lut.W;
+    const int H = lut.H;
+    const bool has_offset =
+        lut.offset[0] != 0 || lut.offset[1] != 0 || lut.offset[2] != 0;
+    const float* offset = has_offset ? lut.offset.data() : nullptr;
+
+    // whole columns are contiguous up to the end of the scan
+    if (first_row == 0 && n_rows == H) {
+        const int n = std::min(n_cols, W - first_col);
+        const int idx = H * first_col;
+        project_pixels(range + idx, &lut.x[idx], &lut.y[idx], &lut.z[idx],
+                       offset, H * n, x, y, z);
+        if (n < n_cols)
+            project_pixels(range, lut.x.data(), lut.y.data(), lut.z.data(),
+                           offset, H * (n_cols - n), x + H * n, y + H * n,
+                           z + H * n);
+        return;
+    }
+
+    for (int j = 0; j < n_cols; j++) {
+        const int idx = H * ((first_col + j) % W) + first_row;
+        const int dst = n_rows * j;
+        project_pixels(range + idx, &lut.x[idx], &lut.y[idx], &lut.z[idx],
+                       offset, n_rows, x + dst, y + dst, z + dst);
+    }
+}
+
+void make_images(const scan_channels& scan, const std::vector<int>& px_offset,
+                 scan_images& images) {
+    const int W = scan.W;
+    const int H = scan.H;
+    const int shift = images.range_shift;
+
+    auto u16 = [](uint16_t v) { return v; };
+    auto u8 = [](uint16_t v) {
+        return static_cast<uint8_t>(std::min<int>(v, 255));
+    };
+
+    destagger(scan.range.data(), W, H, px_offset, images.range.data(),
+              [=](uint32_t r) {
+                  return static_cast<uint16_t>(std::min(r >> shift, 0xffffu));
+              });
+    destagger(scan.signal.data(), W, H, px_offset, images.signal.data(), u16);
+    destagger(scan.reflectivity.data(), W, H, px_offset,
+              images.reflectivity.data(), u16);
+    destagger(scan.noise.data(), W, H, px_offset, images.noise.data(), u16);
+
+    if (images.range8.empty()) return;
+
+    // close returns are bright; no return is black
+    destagger(scan.range.data(), W, H, px_offset, images.range8.data(),
+              [](uint32_t r) {
+                  return static_cast<uint8_t>(
+                      r ? 255 - std::min(std::lround(r * 5e-3), 255L) : 0);
+              });
+    destagger(scan.signal.data(), W, H, px_offset, images.signal8.data(), u8);
+    destagger(scan.reflectivity.data(), W, H, px_offset,
+              images.reflectivity8.data(), u8);
+    destagger(scan.noise.data(), W, H, px_offset, images.noise8.data(), u8);
+}
+
+std::function<void(const uint8_t*, scan_images&)> batch_to_images(
+    int W, int H, std::function<void(uint64_t)> f) {
+    auto scan = std::make_shared<scan_channels>(W, H);
+    const std::vector<int> px_offset = get_px_offset(W);
+
+    // images passed with the packet completing a scan
+    auto images = std::make_shared<scan_images*>(nullptr);
+
+    auto batch = batch_to_channels([=](uint64_t scan_ts) {
+        make_images(*scan, px_offset, **images);
+        f(scan_ts);
+    });
+
+    return [=](const uint8_t* packet_buf, scan_images& imgs) {
+        *images = &imgs;
+        batch(packet_buf, *scan);
+    };
+}
+
 std::vector<int> get_px_offset(int lidar_mode) {
     auto repeat = [](int n, const std::vector<int>& v) {
         std::vector<int> res{};
@@ -7,12 +7,26 @@
 
 #include <geometry_msgs/TransformStamped.h>
 #include <pcl/point_cloud.h>
+#include <ros/ros.h>
+#include <sensor_msgs/Image.h>
 #include <sensor_msgs/Imu.h>
 #include <sensor_msgs/PointCloud2.h>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+#include <atomic>
 #include <chrono>
+#include <cstring>
+#include <functional>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "ouster/os1.h"
+#include "ouster/os1_metrics.h"
+#include "ouster/os1_util.h"
+#include "ouster_ros/OS1ConfigSrv.h"
+#include "ouster_ros/PacketBatchMsg.h"
 #include "ouster_ros/PacketMsg.h"
 #include "ouster_ros/point_os1.h"
 
@@ -22,6 +36,81 @@ namespace OS1 {
 using CloudOS1 = pcl::PointCloud<PointOS1>;
 using ns = std::chrono::nanoseconds;
 
+/**
+ * Preallocated messages that are recycled once the pool holds their only
+ * reference, i.e. after every subscriber in the process and every outgoing
+ * queue has released them, so that publishing does not allocate in steady
+ * state. Messages keep the capacity of their buffers when reused. If every
+ * message is still referenced, a new one is allocated and counted in
+ * METRIC_POOL_ALLOCATIONS. Not thread safe: acquire from one thread only.
+ */
+template <typename M>
+class message_pool {
+   public:
+    /**
+     * @param n number of messages to preallocate
+     * @param init function to set up each new message, e.g. to size buffers
+     */
+    message_pool(size_t n, std::function<void(M&)> init)
+        : init_{std::move(init)} {
+        for (size_t i = 0; i < n; i++) msgs_.push_back(make());
+    }
+
+    /**
+     * Get a message not referenced outside the pool. Its contents are left as
+     * they were when it was last published
+     */
+    boost::shared_ptr<M> acquire() {
+        // messages are usually released in order, so start after the last one
+        for (size_t i = 0; i < msgs_.size(); i++) {
+            next_ = next_ + 1 < msgs_.size() ? next_ + 1 : 0;
+            if (msgs_[next_].unique()) return msgs_[next_];
+        }
+        ouster::OS1::count_metric(ouster::OS1::METRIC_POOL_ALLOCATIONS);
+        msgs_.push_back(make());
+        next_ = msgs_.size() - 1;
+        return msgs_.back();
+    }
+
+    /** number of messages owned by the pool */
+    size_t size() const { return msgs_.size(); }
+
+   private:
+    boost::shared_ptr<M> make() {
+        auto m = boost::make_shared<M>();
+        init_(*m);
+        return m;
+    }
+
+    std::function<void(M&)> init_;
+    std::vector<boost::shared_ptr<M>> msgs_;
+    size_t next_{0};
+};
+
+/**
+ * Wait for the os1_config service to be advertised and call it. Used by
+ * nodelets that need sensor configuration before subscribing to data
+ * @param nh node handle in which to look up os1_config
+ * @param cfg the service to populate with the sensor configuration
+ * @param stop checked every second while waiting; set to give up early
+ * @return whether the service was called successfully
+ */
+bool get_config(ros::NodeHandle& nh, OS1ConfigSrv& cfg,
+                const std::atomic_bool& stop);
+
+/**
+ * Run the setup of a nodelet on its own thread, so that waiting for os1_node
+ * does not block the nodelet manager. A failed setup is logged and leaves the
+ * nodelet idle rather than shutting down the manager and the other nodelets
+ * it runs; giving up because the nodelet is unloading is not a failure
+ * @param name name of the nodelet for logging
+ * @param stop set when the nodelet is unloading
+ * @param setup sets up the nodelet, returning false on failure
+ * @return the thread running setup, to be joined when the nodelet is unloaded
+ */
+std::thread start_setup(const std::string& name, const std::atomic_bool& stop,
+                        std::function<bool()> setup);
+
 /**
  * Read an imu packet into a ROS message. Blocks for up to a second if no data
  * is available.
@@ -40,6 +129,21 @@ bool read_imu_packet(const ouster::OS1::client& cli, PacketMsg& pm);
  */
 bool read_lidar_packet(const ouster::OS1::client& cli, PacketMsg& pm);
 
+/**
+ * Make a function that aggregates lidar packets into batch messages, each
+ * holding up to n_packets consecutive packets of a single frame. After the
+ * first frame received, batches cover every packet slot of a frame, including
+ * dropped packets at its start or end, so the callback may also receive
+ * batches containing only dropped slots. Packets that repeat or precede an
+ * already covered slot are ignored.
+ * @param W number of columns in the lidar scan. One of 512, 1024, or 2048.
+ * @param n_packets maximum number of packets per batch; 0 for whole frames
+ * @param f callback invoked with each completed batch
+ * @return a function taking a lidar packet buffer and its receive timestamp
+ */
+std::function<void(const uint8_t*, uint64_t)> batch_packets(
+    int W, int n_packets, std::function<void(const PacketBatchMsg::Ptr&)> f);
+
 /**
  * Parse an imu packet message into a ROS imu message
  * @param pm packet message populated by read_imu_packet
@@ -49,6 +153,16 @@ bool read_lidar_packet(const ouster::OS1::client& cli, PacketMsg& pm);
 sensor_msgs::Imu packet_to_imu_msg(const PacketMsg& pm,
                                    const std::string& frame);
 
+/**
+ * Parse an imu packet message into an existing ROS imu message, without
+ * allocating if the message was populated with the same frame before
+ * @param pm packet message populated by read_imu_packet
+ * @param frame the frame to set in the resulting ROS message
+ * @param m the message to populate
+ */
+void packet_to_imu_msg(const PacketMsg& pm, const std::string& frame,
+                       sensor_msgs::Imu& m);
+
 /**
  * Serialize a PCL point cloud to a ROS message
  * @param cloud the PCL point cloud to convert
@@ -59,6 +173,79 @@ sensor_msgs::Imu packet_to_imu_msg(const PacketMsg& pm,
 sensor_msgs::PointCloud2 cloud_to_cloud_msg(const CloudOS1& cloud, ns timestamp,
                                             const std::string& frame);
 
+/**
+ * Allocate a ROS point cloud message with the memory layout of a W x H
+ * CloudOS1, so that its data can be written in place through a PointOS1
+ * pointer instead of converting a PCL point cloud on every scan
+ * @param W number of columns in the lidar scan
+ * @param H number of rows in the lidar scan
+ * @param frame the frame to set in the resulting ROS message
+ * @return a ROS message with fields set and data sized for W * H points
+ */
+sensor_msgs::PointCloud2Ptr make_cloud_msg(uint32_t W, uint32_t H,
+                                           const std::string& frame);
+
+/**
+ * Set up an existing ROS point cloud message like make_cloud_msg
+ * @param msg the message to set up
+ * @param W number of columns in the lidar scan
+ * @param H number of rows in the lidar scan
+ * @param frame the frame to set in the message
+ */
+void init_cloud_msg(sensor_msgs::PointCloud2& msg, uint32_t W, uint32_t H,
+                    const std::string& frame);
+
+/**
+ * Change the number of points of a message set up by make_cloud_msg or
+ * init_cloud_msg, which does not allocate if its data had at least as many
+ * points before
+ * @param msg the message to resize
+ * @param W new width of the cloud
+ * @param H new height of the cloud
+ */
+void resize_cloud_msg(sensor_msgs::PointCloud2& msg, uint32_t W, uint32_t H);
+
+/**
+ * Get a pointer to the points of a message allocated by make_cloud_msg
+ * @param msg message returned by make_cloud_msg
+ * @return pointer to the first of W * H points stored in the message data
+ */
+PointOS1* cloud_msg_points(sensor_msgs::PointCloud2& msg);
+
+/**
+ * Copy the channels of a point cloud in the column-major order of a scan, as
+ * published on ~/points, into the raw channels used to make images
+ * @param cloud the point cloud of a W x H scan
+ * @param scan receives the ranges, signal, reflectivity and noise
+ */
+void cloud_to_scan_channels(const CloudOS1& cloud,
+                            ouster::OS1::scan_channels& scan);
+
+/**
+ * Copy a row-major image into a new ROS image message
+ * @param px the W * H pixels of the image
+ * @param W width of the image
+ * @param H height of the image
+ * @param encoding encoding of the pixels, e.g. mono8 or 16UC1
+ * @param stamp the timestamp to give the message
+ * @return the image message
+ */
+template <typename T>
+sensor_msgs::ImagePtr make_image_msg(const std::vector<T>& px, uint32_t W,
+                                     uint32_t H, const std::string& encoding,
+                                     const ros::Time& stamp) {
+    auto msg = boost::make_shared<sensor_msgs::Image>();
+    msg->width = W;
+    msg->height = H;
+    msg->step = W * sizeof(T);
+    msg->encoding = encoding;
+    msg->is_bigendian = 0;
+    msg->header.stamp = stamp;
+    msg->data.resize(W * H * sizeof(T));
+    std::memcpy(msg->data.data(), px.data(), msg->data.size());
+    return msg;
+}
+
 /**
  * Convert transformation matrix return by sensor to ROS transform
  * @param mat transformation matrix return by sensor
@@ -69,5 +256,27 @@ sensor_msgs::PointCloud2 cloud_to_cloud_msg(const CloudOS1& cloud, ns timestamp,
 geometry_msgs::TransformStamped transform_to_tf_msg(
     const std::vector<double>& mat, const std::string& frame,
     const std::string& child_frame);
+
+/**
+ * Periodically publish metrics of the process on /diagnostics, as key/value
+ * pairs of a status named after the node handle's namespace. Metrics are
+ * process-wide: nodelets in one manager report the same values, summed over
+ * all of their sensors, so the status carries a "scope" key and the process
+ * node name as hardware_id. The status level is WARN if packets were dropped
+ * or malformed, columns were missing, or full queues dropped items since the
+ * previous period
+ * @param nh node handle used to advertise and to create the timer
+ * @param period publishing period in seconds
+ * @param counters counters to publish
+ * @param latencies latency metrics to publish, summarized in us
+ * @param depths queue depth metrics to publish, summarized in items
+ * @return the timer publishing the metrics; publishing stops when the timer
+ * and its copies are destroyed
+ */
+ros::Timer publish_diagnostics(
+    ros::NodeHandle& nh, double period,
+    const std::vector<ouster::OS1::metric_counter>& counters,
+    const std::vector<ouster::OS1::metric_latency>& latencies,
+    const std::vector<ouster::OS1::metric_depth>& depths = {});
 }
 }
@@ -0,0 +1,99 @@
+/**
+ * @file
+ * @brief Replacement operator new and delete counting heap allocations
+ *
+ * Linked into the standalone nodes when configured with COUNT_ALLOCATIONS, so
+ * that the heap_allocations metric shows whether the steady state allocates
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "ouster/os1_metrics.h"
+
+namespace {
+void* counted_alloc(std::size_t n) noexcept {
+    ouster::OS1::count_metric(ouster::OS1::METRIC_HEAP_ALLOCATIONS);
+    return std::malloc(n ? n : 1);
+}
+
+void* counted_alloc_or_throw(std::size_t n) {
+    if (void* p = counted_alloc(n)) return p;
+    throw std::bad_alloc{};
+}
+}
+
+// every allocation and deallocation function is replaced, so each new is
+// paired with a matching delete and array, nothrow and aligned allocations
+// are counted too
+void* operator new(std::size_t n) { return counted_alloc_or_throw(n); }
+void* operator new[](std::size_t n) { return counted_alloc_or_throw(n); }
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept {
+    return counted_alloc(n);
+}
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept {
+    return counted_alloc(n);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+#endif
+
+#ifdef __cpp_aligned_new
+namespace {
+void* counted_alloc(std::size_t n, std::align_val_t al) noexcept {
+    ouster::OS1::count_metric(ouster::OS1::METRIC_HEAP_ALLOCATIONS);
+    const std::size_t a =
+        std::max(static_cast<std::size_t>(al), sizeof(void*));
+    void* p = nullptr;
+    return posix_memalign(&p, a, n ? n : 1) == 0 ? p : nullptr;
+}
+
+void* counted_alloc_or_throw(std::size_t n, std::align_val_t al) {
+    if (void* p = counted_alloc(n, al)) return p;
+    throw std::bad_alloc{};
+}
+}
+
+void* operator new(std::size_t n, std::align_val_t al) {
+    return counted_alloc_or_throw(n, al);
+}
+void* operator new[](std::size_t n, std::align_val_t al) {
+    return counted_alloc_or_throw(n, al);
+}
+void* operator new(std::size_t n, std::align_val_t al,
+                   const std::nothrow_t&) noexcept {
+    return counted_alloc(n, al);
+}
+void* operator new[](std::size_t n, std::align_val_t al,
+                     const std::nothrow_t&) noexcept {
+    return counted_alloc(n, al);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::align_val_t,
+                     const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, std::align_val_t,
+                       const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+#endif
@@ -0,0 +1,178 @@
+/**
+ * @file
+ * @brief Benchmarks of the per-scan work of the ROS nodes
+ *
+ * Times converting a scan to a point cloud message the way cloud_to_cloud_msg
+ * does, compared to writing the points into a recycled message like
+ * os1_cloud_node, and the point cloud loop of img_node from ~/points to image
+ * messages, on random scans of each lidar mode. Each iteration processes one
+ * scan. Linked with the allocation counter, so benchmarks also report:
+ *   allocs/scan: operator new calls per scan
+ */
+
+#include <benchmark/benchmark.h>
+#include <pcl_conversions/pcl_conversions.h>
+#include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ouster/os1.h"
+#include "ouster/os1_metrics.h"
+#include "ouster/os1_util.h"
+#include "ouster_ros/os1_ros.h"
+#include "ouster_ros/point_os1.h"
+
+namespace OS1 = ouster::OS1;
+using ouster_ros::OS1::CloudOS1;
+using ouster_ros::OS1::PointOS1;
+
+namespace {
+
+// a scan of random points, by mode
+struct fixture {
+    std::string name;
+    int W;
+    int H;
+    CloudOS1 cloud;
+};
+
+// about a tenth of returns are missing, as in the benchmarks of ouster_client
+std::shared_ptr<const fixture> make_fixture(OS1::lidar_mode mode) {
+    auto fx = std::make_shared<fixture>();
+    fx->name = OS1::to_string(mode);
+    fx->W = OS1::n_cols_of_lidar_mode(mode);
+    fx->H = OS1::pixels_per_column;
+    fx->cloud.resize(fx->W * fx->H);
+    fx->cloud.width = fx->W;
+    fx->cloud.height = fx->H;
+
+    std::mt19937 gen{1};
+    std::uniform_real_distribution<float> xyz{-100.0f, 100.0f};
+    for (auto& pt : fx->cloud.points) {
+        const uint32_t range = gen() % 10 ? gen() % 120000 : 0;
+        pt = PointOS1::make(xyz(gen), xyz(gen), xyz(gen), gen() % 4096,
+                            gen() % 100000000, gen() % 4096, gen() % 64,
+                            gen() % 1024, range);
+    }
+    return fx;
+}
+
+uint64_t heap_allocations() {
+    return OS1::metric(OS1::METRIC_HEAP_ALLOCATIONS).load();
+}
+
+// set the counters of a benchmark processing one scan per iteration
+void report(benchmark::State& state, const fixture& fx, uint64_t allocs0) {
+    const uint64_t allocs = heap_allocations() - allocs0;
+    state.counters["points/s"] = benchmark::Counter(
+        double(fx.W) * fx.H, benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["allocs/scan"] =
+        state.iterations() ? double(allocs) / state.iterations() : 0;
+}
+
+void bm_cloud_to_cloud_msg(benchmark::State& state, const fixture& fx) {
+    const auto allocs0 = heap_allocations();
+    for (auto _ : state) {
+        auto msg = ouster_ros::OS1::cloud_to_cloud_msg(
+            fx.cloud, ouster_ros::OS1::ns{1}, "os1_lidar");
+        benchmark::DoNotOptimize(msg.data.data());
+    }
+    report(state, fx, allocs0);
+}
+
+// what os1_cloud_node does instead, with the points batched in place
+void bm_cloud_msg_in_place(benchmark::State& state, const fixture& fx) {
+    auto msg = ouster_ros::OS1::make_cloud_msg(fx.W, fx.H, "os1_lidar");
+    const auto allocs0 = heap_allocations();
+    for (auto _ : state) {
+        std::copy(fx.cloud.points.begin(), fx.cloud.points.end(),
+                  ouster_ros::OS1::cloud_msg_points(*msg));
+        msg->header.stamp.fromNSec(1);
+        benchmark::DoNotOptimize(msg->data.data());
+    }
+    report(state, fx, allocs0);
+}
+
+// the point cloud mode of img_node, from a message on ~/points to the four
+// image messages it publishes
+void bm_img_node_cloud(benchmark::State& state, const fixture& fx,
+                       bool mono8) {
+    const auto msg = ouster_ros::OS1::cloud_to_cloud_msg(
+        fx.cloud, ouster_ros::OS1::ns{1}, "os1_lidar");
+    const std::string encoding = mono8 ? "mono8" : "16UC1";
+    const auto px_offset = OS1::get_px_offset(fx.W);
+    CloudOS1 cloud;
+    OS1::scan_channels scan{fx.W, fx.H};
+    OS1::scan_images images{fx.W, fx.H, 2, mono8};
+
+    using ouster_ros::OS1::make_image_msg;
+    const auto allocs0 = heap_allocations();
+    for (auto _ : state) {
+        pcl::fromROSMsg(msg, cloud);
+        ouster_ros::OS1::cloud_to_scan_channels(cloud, scan);
+        OS1::make_images(scan, px_offset, images);
+        const ros::Time& stamp = msg.header.stamp;
+        if (mono8) {
+            benchmark::DoNotOptimize(make_image_msg(images.range8, fx.W, fx.H,
+                                                    encoding, stamp));
+            benchmark::DoNotOptimize(make_image_msg(images.noise8, fx.W, fx.H,
+                                                    encoding, stamp));
+            benchmark::DoNotOptimize(make_image_msg(
+                images.signal8, fx.W, fx.H, encoding, stamp));
+            benchmark::DoNotOptimize(make_image_msg(
+                images.reflectivity8, fx.W, fx.H, encoding, stamp));
+        } else {
+            benchmark::DoNotOptimize(
+                make_image_msg(images.range, fx.W, fx.H, encoding, stamp));
+            benchmark::DoNotOptimize(
+                make_image_msg(images.noise, fx.W, fx.H, encoding, stamp));
+            benchmark::DoNotOptimize(
+                make_image_msg(images.signal, fx.W, fx.H, encoding, stamp));
+            benchmark::DoNotOptimize(make_image_msg(
+                images.reflectivity, fx.W, fx.H, encoding, stamp));
+        }
+    }
+    report(state, fx, allocs0);
+}
+
+void register_benchmarks(std::shared_ptr<const fixture> fx) {
+    benchmark::RegisterBenchmark(
+        ("cloud_to_cloud_msg/" + fx->name).c_str(),
+        [fx](benchmark::State& state) { bm_cloud_to_cloud_msg(state, *fx); });
+    benchmark::RegisterBenchmark(
+        ("cloud_msg_in_place/" + fx->name).c_str(),
+        [fx](benchmark::State& state) { bm_cloud_msg_in_place(state, *fx); });
+    benchmark::RegisterBenchmark(
+        ("img_node_cloud_mono8/" + fx->name).c_str(),
+        [fx](benchmark::State& state) {
+            bm_img_node_cloud(state, *fx, true);
+        });
+    benchmark::RegisterBenchmark(
+        ("img_node_cloud_16UC1/" + fx->name).c_str(),
+        [fx](benchmark::State& state) {
+            bm_img_node_cloud(state, *fx, false);
+        });
+}
+}
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return EXIT_FAILURE;
+
+    const OS1::lidar_mode modes[] = {OS1::MODE_512x10, OS1::MODE_1024x10,
+                                     OS1::MODE_2048x10};
+    for (OS1::lidar_mode mode : modes) register_benchmarks(make_fixture(mode));
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return EXIT_SUCCESS;
+}
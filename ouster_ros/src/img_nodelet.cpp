@@ -0,0 +1,184 @@
+/**
+ * @file
+ * @brief Nodelet to visualize range, noise and intensity images
+ *
+ * Publishes ~/range_image, ~/noise_image, ~/intensity_image and
+ * ~/reflectivity_image.  Please bear in mind that there is rounding/clamping to
+ * display 8 bit images. For computer vision applications, use 16UC1 images.
+ *
+ * ROS Parameters
+ * packet_mode: build images straight from ~/lidar_packets or
+ *   ~/lidar_packet_batches instead of ~/points, skipping the point cloud
+ * image_encoding: either mono8 (default) or 16UC1 for full precision
+ * range_shift: 16UC1 range images are in units of 2^range_shift mm; the
+ *   default of 2 covers ranges up to 262 m
+ */
+
+#include <atomic>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nodelet/nodelet.h>
+#include <pcl/conversions.h>
+#include <pcl/point_types.h>
+#include <pcl_conversions/pcl_conversions.h>
+#include <pcl_ros/point_cloud.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <ouster/os1.h>
+#include <ouster/os1_packet.h>
+#include <ouster/os1_util.h>
+#include <ouster_ros/OS1ConfigSrv.h>
+#include <ouster_ros/PacketBatchMsg.h>
+#include <ouster_ros/PacketMsg.h>
+#include <ouster_ros/os1_ros.h>
+#include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/PointCloud2.h>
+
+namespace OS1 = ouster::OS1;
+
+using PacketMsg = ouster_ros::PacketMsg;
+using PacketBatchMsg = ouster_ros::PacketBatchMsg;
+
+using ouster_ros::OS1::make_image_msg;
+
+namespace os1_nodelets {
+
+class ImgNodelet : public nodelet::Nodelet {
+   public:
+    ~ImgNodelet() override {
+        stop_ = true;
+        if (thread_.joinable()) thread_.join();
+    }
+
+   private:
+    void onInit() override {
+        thread_ = ouster_ros::OS1::start_setup(getName(), stop_,
+                                               [this] { return setup(); });
+    }
+
+    bool setup() {
+        ros::NodeHandle& nh = getPrivateNodeHandle();
+
+        auto packet_mode = nh.param("packet_mode", false);
+        auto range_shift = nh.param("range_shift", 2);
+        encoding_ = nh.param("image_encoding", std::string{"mono8"});
+        if (encoding_ != "mono8" && encoding_ != "16UC1") {
+            ROS_ERROR("Invalid image encoding %s", encoding_.c_str());
+            return false;
+        }
+
+        ouster_ros::OS1ConfigSrv cfg{};
+        if (!ouster_ros::OS1::get_config(nh, cfg, stop_)) return false;
+
+        H_ = OS1::pixels_per_column;
+        W_ = OS1::n_cols_of_lidar_mode(
+            OS1::lidar_mode_of_string(cfg.response.lidar_mode));
+
+        px_offset_ = ouster::OS1::get_px_offset(W_);
+        scan_.reset(new OS1::scan_channels(W_, H_));
+        images_.reset(new OS1::scan_images(W_, H_, range_shift,
+                                           encoding_ == "mono8"));
+
+        range_image_pub_ = nh.advertise<sensor_msgs::Image>("range_image", 100);
+        noise_image_pub_ = nh.advertise<sensor_msgs::Image>("noise_image", 100);
+        intensity_image_pub_ =
+            nh.advertise<sensor_msgs::Image>("intensity_image", 100);
+        reflectivity_image_pub_ =
+            nh.advertise<sensor_msgs::Image>("reflectivity_image", 100);
+
+        if (!packet_mode) {
+            pc_sub_ = nh.subscribe<sensor_msgs::PointCloud2>(
+                "points", 500, &ImgNodelet::cloud_handler, this);
+            return true;
+        }
+
+        batch_images_ = OS1::batch_to_images(
+            W_, H_, [this](uint64_t scan_ts) {
+                ros::Time stamp;
+                stamp.fromNSec(scan_ts);
+                publish_images(stamp);
+            });
+
+        lidar_packet_sub_ = nh.subscribe<PacketMsg>(
+            "lidar_packets", 2048, [this](const PacketMsg::ConstPtr& pm) {
+                batch_images_(pm->buf.data(), *images_);
+            });
+        lidar_batch_sub_ = nh.subscribe<PacketBatchMsg>(
+            "lidar_packet_batches", 64,
+            [this](const PacketBatchMsg::ConstPtr& pm) {
+                const uint8_t* buf = pm->buf.data();
+                for (size_t i = 0; i < pm->receive_stamps.size(); i++)
+                    batch_images_(buf + i * OS1::lidar_packet_bytes,
+                                  *images_);
+            });
+        return true;
+    }
+
+    void cloud_handler(const sensor_msgs::PointCloud2::ConstPtr& m) {
+        pcl::fromROSMsg(*m, cloud_);
+
+        if ((int)cloud_.size() != W_ * H_) {
+            ROS_ERROR_THROTTLE(1, "Unexpected cloud size; check lidar_mode");
+            return;
+        }
+
+        // points are already in the column-major order of a scan
+        ouster_ros::OS1::cloud_to_scan_channels(cloud_, *scan_);
+        OS1::make_images(*scan_, px_offset_, *images_);
+        publish_images(m->header.stamp);
+    }
+
+    void publish_images(const ros::Time& stamp) {
+        const OS1::scan_images& img = *images_;
+        if (encoding_ == "mono8") {
+            range_image_pub_.publish(
+                make_image_msg(img.range8, W_, H_, encoding_, stamp));
+            noise_image_pub_.publish(
+                make_image_msg(img.noise8, W_, H_, encoding_, stamp));
+            intensity_image_pub_.publish(
+                make_image_msg(img.signal8, W_, H_, encoding_, stamp));
+            reflectivity_image_pub_.publish(
+                make_image_msg(img.reflectivity8, W_, H_, encoding_, stamp));
+        } else {
+            range_image_pub_.publish(
+                make_image_msg(img.range, W_, H_, encoding_, stamp));
+            noise_image_pub_.publish(
+                make_image_msg(img.noise, W_, H_, encoding_, stamp));
+            intensity_image_pub_.publish(
+                make_image_msg(img.signal, W_, H_, encoding_, stamp));
+            reflectivity_image_pub_.publish(
+                make_image_msg(img.reflectivity, W_, H_, encoding_, stamp));
+        }
+    }
+
+    int W_{0};
+    int H_{0};
+    std::string encoding_;
+    std::vector<int> px_offset_;
+    ouster_ros::OS1::CloudOS1 cloud_{};
+    std::unique_ptr<OS1::scan_channels> scan_;
+    std::unique_ptr<OS1::scan_images> images_;
+    std::function<void(const uint8_t*, OS1::scan_images&)> batch_images_;
+
+    ros::Publisher range_image_pub_;
+    ros::Publisher noise_image_pub_;
+    ros::Publisher intensity_image_pub_;
+    ros::Publisher reflectivity_image_pub_;
+    ros::Subscriber pc_sub_;
+    ros::Subscriber lidar_packet_sub_;
+    ros::Subscriber lidar_batch_sub_;
+
+    std::atomic_bool stop_{false};
+    std::thread thread_;
+};
+}
+
+PLUGINLIB_EXPORT_CLASS(os1_nodelets::ImgNodelet, nodelet::Nodelet)
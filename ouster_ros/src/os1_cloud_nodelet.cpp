@@ -0,0 +1,816 @@
+/**
+ * @file
+ * @brief Nodelet to publish OS-1 point clouds and imu topics
+ *
+ * ROS Parameters
+ * tf_prefix: prefix of the published frame names
+ * sector_columns: also publish ~/points_sector every sector_columns columns of
+ *   a scan, for consumers that cannot wait for the whole scan; 0 to disable
+ * sector_degrees: size of sectors in degrees of azimuth instead of columns;
+ *   overrides sector_columns if positive
+ * deskew: motion compensate points using ~/imu_packets; either none (default),
+ *   rotation, or full to also compensate changes of velocity during a scan
+ * decimate_col_stride, decimate_ring_stride: also publish ~/points_decimated,
+ *   keeping every n-th column or ring of a scan
+ * decimate_rings: list of rings to keep instead of decimate_ring_stride
+ * decimate_reduction: none (default), block_min or block_max to keep the
+ *   nearest or farthest return of each decimate_block x decimate_block block
+ *   of kept pixels, or voxel to keep the centroid of each cell of a
+ *   decimate_voxel_size grid, for at most decimate_max_voxels cells
+ * filter_min_range, filter_max_range: remove returns closer or farther than
+ *   these ranges in m from ~/points; 0 to disable
+ * filter_min_neighbors: remove returns with fewer of their 8 neighbors in the
+ *   range image within filter_neighbor_range m of their range
+ * filter_edge_jump: remove returns farther than a neighbor by more than this
+ *   many m, such as mixed returns at object borders; 0 to disable. Sectors
+ *   and ~/points_decimated are not filtered
+ * reorder_wait_ms: hold packets arriving after a gap for up to this many ms of
+ *   sensor time for the missing packets, also across two frames, and publish
+ *   the completeness of each scan on ~/frame_stats; 0 (default) to batch
+ *   packets in order of arrival
+ * shm_name: also publish lidar and imu packets and scans in the layout of
+ *   ~/points to the shared memory object of this name, e.g. /os1, for local
+ *   consumers outside ROS using open_shm_reader; empty (default) to disable.
+ *   Packets are stamped with their receive timestamps, or with the time
+ *   their message arrived if the sensor node had none
+ * pipeline: decode and publish ~/points on one dedicated thread each, handing
+ *   packets and scans over through queues of at most decode_queue_packets
+ *   packets (default 256) and publish_queue_scans scans (default 2), rather
+ *   than decoding in the subscriber callbacks; false (default) to disable
+ * queue_policy: what the pipeline does with a full queue: drop_oldest
+ *   (default) to drop the queued packets or scan of the oldest frame and keep
+ *   latency bounded, drop_newest, or block to slow down the previous stage
+ * decode_threads: number of threads decoding whole frames in parallel when
+ *   scans queue up, delivered to the single publish thread in order;
+ *   default 1. More than one needs deskew, decimation, filtering, sectors and
+ *   reorder_wait_ms disabled, which follow the scans across frames
+ * decode_cpus, publish_cpus: cpus the pipeline threads may run on; empty
+ *   (default) for any
+ * diagnostics_period: seconds between frame counts and decode and publish
+ *   latencies published on /diagnostics, including the latency from
+ *   receiving the last packet of a scan to its completion and to its
+ *   publication; 0 to disable
+ */
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/console.h>
+#include <ros/ros.h>
+#include <ros/service.h>
+#include <sensor_msgs/Imu.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <tf2_ros/static_transform_broadcaster.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ouster/os1_assembler.h"
+#include "ouster/os1_decimate.h"
+#include "ouster/os1_deskew.h"
+#include "ouster/os1_filter.h"
+#include "ouster/os1_frames.h"
+#include "ouster/os1_metrics.h"
+#include "ouster/os1_packet.h"
+#include "ouster/os1_pipeline.h"
+#include "ouster/os1_shm.h"
+#include "ouster/os1_util.h"
+#include "ouster_ros/CloudSectorMsg.h"
+#include "ouster_ros/FrameStatsMsg.h"
+#include "ouster_ros/OS1ConfigSrv.h"
+#include "ouster_ros/PacketBatchMsg.h"
+#include "ouster_ros/PacketMsg.h"
+#include "ouster_ros/os1_ros.h"
+
+using CloudSectorMsg = ouster_ros::CloudSectorMsg;
+using FrameStatsMsg = ouster_ros::FrameStatsMsg;
+using PacketMsg = ouster_ros::PacketMsg;
+using PacketBatchMsg = ouster_ros::PacketBatchMsg;
+using PointOS1 = ouster_ros::OS1::PointOS1;
+
+namespace OS1 = ouster::OS1;
+
+namespace {
+
+// messages preallocated for publishing; subscribers may still hold a scan
+// while the next one is batched
+const size_t cloud_pool_size = 3;
+const size_t imu_pool_size = 100;
+const size_t sector_pool_size = 16;
+
+// time in ns in the CLOCK_REALTIME domain of software receive timestamps
+uint64_t wall_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+// record the time since a packet was received, unless the clock was stepped
+// back since
+void record_since(OS1::metric_latency l, uint64_t rx_ts) {
+    const uint64_t now = wall_ns();
+    if (rx_ts && now >= rx_ts) OS1::record_latency(l, now - rx_ts);
+}
+}
+
+namespace os1_nodelets {
+
+class OS1CloudNodelet : public nodelet::Nodelet {
+   public:
+    ~OS1CloudNodelet() override {
+        stop_ = true;
+        if (thread_.joinable()) thread_.join();
+
+        // queued packets and scans are still processed
+        if (decode_queue_) decode_queue_->close();
+        if (decode_thread_.joinable()) decode_thread_.join();
+        if (publish_queue_) publish_queue_->close();
+        if (publish_thread_.joinable()) publish_thread_.join();
+    }
+
+   private:
+    // a packet or a batch of packets received but not decoded yet, with the
+    // time the message arrived for packets without a receive timestamp
+    struct packet_item {
+        PacketMsg::ConstPtr packet;
+        PacketBatchMsg::ConstPtr batch;
+        uint64_t arrival_ts;
+    };
+
+    // a complete scan with the receive time of its last packet
+    struct scan_item {
+        sensor_msgs::PointCloud2Ptr msg;
+        uint64_t rx_ts;
+    };
+
+    // the packets of one frame copied out of their messages, to be decoded
+    // by any of the decode threads
+    struct frame_packets {
+        std::vector<uint8_t> bufs;
+        size_t n;
+        uint16_t frame_id;
+        uint64_t rx_ts;
+        sensor_msgs::PointCloud2Ptr msg;
+        uint64_t scan_ts;
+        bool done;
+    };
+
+    void onInit() override {
+        thread_ = ouster_ros::OS1::start_setup(getName(), stop_,
+                                               [this] { return setup(); });
+    }
+
+    bool setup() {
+        ros::NodeHandle& nh = getPrivateNodeHandle();
+
+        auto tf_prefix = nh.param("tf_prefix", std::string{});
+        auto sensor_frame = tf_prefix + "/os1_sensor";
+        imu_frame_ = tf_prefix + "/os1_imu";
+        lidar_frame_ = tf_prefix + "/os1_lidar";
+
+        ouster_ros::OS1ConfigSrv cfg{};
+        if (!ouster_ros::OS1::get_config(nh, cfg, stop_)) return false;
+
+        W_ = OS1::n_cols_of_lidar_mode(
+            OS1::lidar_mode_of_string(cfg.response.lidar_mode));
+        H_ = OS1::pixels_per_column;
+
+        lidar_pub_ = nh.advertise<sensor_msgs::PointCloud2>("points", 10);
+        imu_pub_ = nh.advertise<sensor_msgs::Imu>("imu", 100);
+
+        int sector_cols = nh.param("sector_columns", 0);
+        const double sector_deg = nh.param("sector_degrees", 0.0);
+        if (sector_deg > 0)
+            sector_cols = std::max(std::lround(W_ * sector_deg / 360.0), 1L);
+        if (sector_cols > 0)
+            sector_pub_ = nh.advertise<CloudSectorMsg>("points_sector", 100);
+
+        const auto deskew = nh.param("deskew", std::string{"none"});
+        if (deskew == "rotation" || deskew == "full") {
+            deskewer_ = OS1::init_deskewer(
+                cfg.response.imu_to_sensor_transform,
+                cfg.response.lidar_to_sensor_transform,
+                deskew == "full" ? OS1::DESKEW_FULL : OS1::DESKEW_ROTATION);
+        } else if (deskew != "none") {
+            ROS_ERROR("Invalid deskew mode %s", deskew.c_str());
+            return false;
+        }
+
+        if (!setup_decimator(nh)) return false;
+        setup_filter(nh);
+        if (!setup_pipeline(nh)) return false;
+
+        const double diag_period = nh.param("diagnostics_period", 1.0);
+        if (diag_period > 0)
+            diag_timer_ = ouster_ros::OS1::publish_diagnostics(
+                nh, diag_period,
+                {OS1::METRIC_MISSING_COLUMNS, OS1::METRIC_FRAMES,
+                 OS1::METRIC_POOL_ALLOCATIONS, OS1::METRIC_REORDERED_PACKETS,
+                 OS1::METRIC_LATE_PACKETS, OS1::METRIC_QUEUE_DROPS,
+                 OS1::METRIC_HEAP_ALLOCATIONS},
+                {OS1::METRIC_FRAME_WAIT, OS1::METRIC_FRAME_LATENCY,
+                 OS1::METRIC_DECODE_TIME, OS1::METRIC_PUBLISH_TIME,
+                 OS1::METRIC_PUBLISH_LATENCY},
+                {OS1::METRIC_DECODE_QUEUE_DEPTH,
+                 OS1::METRIC_PUBLISH_QUEUE_DEPTH});
+
+        auto lut = OS1::make_xyz_lut(W_, H_, cfg.response.beam_azimuth_angles,
+                                     cfg.response.beam_altitude_angles, {});
+
+        // points are written directly into the message data, recycled once
+        // subscribers in the same process have released the scan
+        using ouster_ros::OS1::message_pool;
+        const std::string frame = lidar_frame_;
+        const uint32_t W = W_, H = H_;
+        const size_t n_clouds =
+            cloud_pool_size + decode_cfg_.n_threads +
+            (publish_queue_ ? publish_queue_->capacity() : 0);
+        cloud_pool_.reset(new message_pool<sensor_msgs::PointCloud2>(
+            n_clouds, [=](sensor_msgs::PointCloud2& m) {
+                ouster_ros::OS1::init_cloud_msg(m, W, H, frame);
+            }));
+        imu_pool_.reset(new message_pool<sensor_msgs::Imu>(
+            imu_pool_size, [](sensor_msgs::Imu&) {}));
+        if (sector_cols > 0)
+            sector_pool_.reset(new message_pool<CloudSectorMsg>(
+                sector_pool_size, [=](CloudSectorMsg& m) {
+                    ouster_ros::OS1::init_cloud_msg(m.cloud, sector_cols, H,
+                                                    frame);
+                }));
+        if (decimator_)
+            decimated_pool_.reset(new message_pool<sensor_msgs::PointCloud2>(
+                cloud_pool_size, [=](sensor_msgs::PointCloud2& m) {
+                    ouster_ros::OS1::init_cloud_msg(m, W, H, frame);
+                }));
+
+        const auto shm_name = nh.param("shm_name", std::string{});
+        if (!shm_name.empty()) {
+            OS1::shm_config shm_cfg{};
+            shm_cfg.scan_layout = OS1::SHM_SCAN_POINTS;
+            shm_cfg.point_bytes = sizeof(PointOS1);
+            shm_ = OS1::init_shm_publisher(shm_name, cfg.response.metadata, W_,
+                                           H_, shm_cfg);
+            if (!shm_) {
+                ROS_ERROR("Failed to create shared memory %s",
+                          shm_name.c_str());
+                return false;
+            }
+        }
+
+        msg_ = cloud_pool_->acquire();
+        it_ = ouster_ros::OS1::cloud_msg_points(*msg_);
+
+        switch (W_) {
+            case 512:
+                start_batcher<512>(lut, sector_cols);
+                break;
+            case 1024:
+                start_batcher<1024>(lut, sector_cols);
+                break;
+            default:
+                start_batcher<2048>(lut, sector_cols);
+        }
+
+        const double reorder_wait_ms = nh.param("reorder_wait_ms", 0.0);
+        if (reorder_wait_ms > 0) {
+            stats_pool_.reset(new message_pool<FrameStatsMsg>(
+                cloud_pool_size,
+                [=](FrameStatsMsg& m) { m.received.resize(W); }));
+            stats_pub_ = nh.advertise<FrameStatsMsg>("frame_stats", 10);
+            assembler_ = OS1::init_frame_assembler(
+                W_, std::llround(reorder_wait_ms * 1e6),
+                [this](const uint8_t* buf) { batch_packet_(buf); },
+                [this](const OS1::frame_stats& s) { publish_stats(s); });
+        }
+
+        if (decode_cfg_.n_threads > 1 &&
+            (deskewer_ || decimator_ || filter_ || sector_cols > 0 ||
+             assembler_)) {
+            ROS_ERROR("decode_threads needs deskew, decimation, filtering, "
+                      "sectors and reorder_wait_ms disabled");
+            return false;
+        }
+
+        if (decode_queue_) {
+            decode_thread_ = std::thread{[this] {
+                if (decode_cfg_.n_threads > 1)
+                    decode_frames_loop();
+                else
+                    decode_loop();
+            }};
+            publish_thread_ = std::thread{[this] { publish_loop(); }};
+        }
+
+        lidar_packet_sub_ = nh.subscribe<PacketMsg>(
+            "lidar_packets", 2048, [this](const PacketMsg::ConstPtr& pm) {
+                packet_item item{pm, nullptr, wall_ns()};
+                add_packets(item);
+            });
+        lidar_batch_sub_ = nh.subscribe<PacketBatchMsg>(
+            "lidar_packet_batches", 64,
+            [this](const PacketBatchMsg::ConstPtr& pm) {
+                packet_item item{nullptr, pm, wall_ns()};
+                add_packets(item);
+            });
+        imu_packet_sub_ = nh.subscribe<PacketMsg>(
+            "imu_packets", 100, [this](const PacketMsg::ConstPtr& pm) {
+                if (deskewer_) {
+                    std::lock_guard<std::mutex> lock{deskew_mtx_};
+                    OS1::add_imu_packet(*deskewer_, pm->buf.data());
+                }
+                if (shm_)
+                    OS1::publish_shm_packet(*shm_, OS1::SHM_IMU_PACKETS,
+                                            pm->buf.data(), wall_ns());
+                auto m = imu_pool_->acquire();
+                ouster_ros::OS1::packet_to_imu_msg(*pm, imu_frame_, *m);
+                imu_pub_.publish(m);
+            });
+
+        // publish transforms
+        tf_bcast_.sendTransform(ouster_ros::OS1::transform_to_tf_msg(
+            cfg.response.imu_to_sensor_transform, sensor_frame, imu_frame_));
+
+        tf_bcast_.sendTransform(ouster_ros::OS1::transform_to_tf_msg(
+            cfg.response.lidar_to_sensor_transform, sensor_frame,
+            lidar_frame_));
+
+        return true;
+    }
+
+    // decode lidar packets, or queue them for the decode thread weighed by
+    // their number and grouped by frame, so that a full queue drops frames
+    void add_packets(packet_item& item) {
+        if (!decode_queue_) {
+            decode(item);
+            return;
+        }
+
+        const std::vector<uint8_t>& buf =
+            item.packet ? item.packet->buf : item.batch->buf;
+        const size_t n = item.packet ? 1 : item.batch->receive_stamps.size();
+        const int64_t frame =
+            buf.size() >= OS1::lidar_packet_bytes
+                ? OS1::col_frame_id(OS1::nth_col(0, buf.data()))
+                : -1;
+        decode_queue_->push(item, n, frame);
+    }
+
+    void decode(const packet_item& item) {
+        std::lock_guard<std::mutex> lock{deskew_mtx_};
+        if (item.packet)
+            add_packets_(item.packet->buf.data(), nullptr, 1, item.arrival_ts);
+        if (item.batch)
+            add_packets_(item.batch->buf.data(),
+                         item.batch->receive_stamps.data(),
+                         item.batch->receive_stamps.size(), item.arrival_ts);
+    }
+
+    void decode_loop() {
+        OS1::configure_thread(decode_cfg_);
+        packet_item item{};
+        while (decode_queue_->pop(item)) {
+            decode(item);
+            // release the messages
+            item = packet_item{};
+        }
+    }
+
+    // split the queued packets into frames and decode the complete frames in
+    // parallel once n_threads of them or all packets queued are collected
+    void decode_frames_loop() {
+        OS1::configure_thread(decode_cfg_);
+        const size_t n_threads = decode_cfg_.n_threads;
+
+        // complete frames followed by the frame being collected
+        std::vector<frame_packets> frames(n_threads + 1);
+        size_t n_done = 0;
+
+        auto work = [&](int w, size_t i) {
+            if (w > 0) OS1::configure_thread(decode_cfg_);
+            decode_frame_(w, frames[i], frames[i + 1].bufs.data());
+        };
+        auto deliver = [&](int, size_t i) {
+            frame_packets& f = frames[i];
+            if (f.done) {
+                record_since(OS1::METRIC_FRAME_LATENCY, f.rx_ts);
+                PointOS1* pts = ouster_ros::OS1::cloud_msg_points(*f.msg);
+                if (shm_) publish_shm(pts, f.scan_ts);
+                f.msg->header.stamp.fromNSec(f.scan_ts);
+                scan_item scan{f.msg, f.rx_ts};
+                publish_queue_->push(scan);
+            }
+            f.msg.reset();
+        };
+        auto run = [&] {
+            for (size_t i = 0; i < n_done; i++)
+                frames[i].msg = cloud_pool_->acquire();
+            OS1::run_ordered(n_done, n_done, work, deliver);
+            std::swap(frames[0], frames[n_done]);
+            n_done = 0;
+        };
+
+        auto add = [&](const uint8_t* buf, uint64_t ts) {
+            if (shm_)
+                OS1::publish_shm_packet(*shm_, OS1::SHM_LIDAR_PACKETS, buf,
+                                        ts);
+            const uint16_t f_id = OS1::col_frame_id(OS1::nth_col(0, buf));
+            frame_packets* f = &frames[n_done];
+            if (f->n && f_id != f->frame_id) {
+                // late packets of the previous frame are dropped like the
+                // batcher drops them
+                if (static_cast<uint16_t>(f_id + 1) == f->frame_id) return;
+                f = &frames[++n_done];
+                f->bufs.clear();
+                f->n = 0;
+            }
+            f->frame_id = f_id;
+            f->bufs.insert(f->bufs.end(), buf, buf + OS1::lidar_packet_bytes);
+            f->n++;
+            f->rx_ts = ts;
+            if (n_done == n_threads) run();
+        };
+
+        packet_item item{};
+        while (decode_queue_->pop(item)) {
+            if (item.packet &&
+                item.packet->buf.size() >= OS1::lidar_packet_bytes)
+                add(item.packet->buf.data(), item.arrival_ts);
+            if (item.batch) {
+                const auto& ts = item.batch->receive_stamps;
+                const uint8_t* bufs = item.batch->buf.data();
+                for (size_t i = 0; i < ts.size() &&
+                                   (i + 1) * OS1::lidar_packet_bytes <=
+                                       item.batch->buf.size();
+                     i++)
+                    add(bufs + i * OS1::lidar_packet_bytes,
+                        ts[i] ? ts[i] : item.arrival_ts);
+            }
+            // release the messages
+            item = packet_item{};
+            if (n_done > 0 && decode_queue_->size() == 0) run();
+        }
+    }
+
+    void publish_loop() {
+        OS1::configure_thread(publish_cfg_);
+        scan_item scan{};
+        while (publish_queue_->pop(scan)) {
+            publish_points(scan.msg, scan.rx_ts);
+            // return the scan to the pool once subscribers release it
+            scan.msg.reset();
+        }
+    }
+
+    void publish_points(const sensor_msgs::PointCloud2Ptr& m, uint64_t rx_ts) {
+        const uint64_t t = OS1::metrics_now();
+        lidar_pub_.publish(m);
+        OS1::record_latency(OS1::METRIC_PUBLISH_TIME, OS1::metrics_now() - t);
+        record_since(OS1::METRIC_PUBLISH_LATENCY, rx_ts);
+    }
+
+    // batch lidar packets with a batcher specialized for scans of W
+    // columns, so that batching a packet needs no indirect call
+    template <int W>
+    void start_batcher(const OS1::xyz_lut& lut, int sector_cols) {
+        // a lambda rather than &PointOS1::make, so construction is inlined
+        auto make = [](float x, float y, float z, float i, uint32_t t,
+                       uint16_t reflectivity, uint8_t ring, uint16_t noise,
+                       uint32_t range) {
+            return PointOS1::make(x, y, z, i, t, reflectivity, ring, noise,
+                                  range);
+        };
+        auto b = OS1::make_scan_batcher<W, OS1::pixels_per_column, PointOS1*>(
+            lut, {}, make, [this](uint64_t scan_ts) {
+                // the packet completing the scan belongs to the next one
+                const uint64_t rx_ts = last_rx_ts_;
+                record_since(OS1::METRIC_FRAME_LATENCY, rx_ts);
+                if (filter_) filter_points();
+                if (shm_) publish_shm(it_, scan_ts);
+                msg_->header.stamp.fromNSec(scan_ts);
+                if (publish_queue_) {
+                    scan_item scan{msg_, rx_ts};
+                    publish_queue_->push(scan);
+                } else {
+                    publish_points(msg_, rx_ts);
+                }
+                if (decimator_) publish_decimated(scan_ts);
+
+                msg_ = cloud_pool_->acquire();
+                it_ = ouster_ros::OS1::cloud_msg_points(*msg_);
+            },
+            sector_cols,
+            [this](const OS1::scan_sector& s) { publish_sector(s); },
+            [this](uint64_t scan_ts, uint64_t ts, int m_id,
+                   OS1::px_column& px) {
+                if (deskewer_) OS1::deskew_column(*deskewer_, scan_ts, ts, px);
+                if (decimator_)
+                    OS1::decimate_column(*decimator_, scan_ts, ts, m_id, px);
+                if (filter_)
+                    std::copy(px.range, px.range + H_,
+                              range_.begin() + H_ * m_id);
+            });
+        auto batcher = std::make_shared<decltype(b)>(std::move(b));
+        if (decode_cfg_.n_threads > 1) start_frame_batchers<W>(lut, make);
+
+        batch_packet_ = [this, batcher](const uint8_t* buf) {
+            (*batcher)(buf, it_);
+        };
+        add_packets_ = [this, batcher](const uint8_t* bufs,
+                                       const uint64_t* ts, size_t n,
+                                       uint64_t arrival_ts) {
+            for (size_t i = 0; i < n; i++) {
+                const uint8_t* buf = bufs + i * OS1::lidar_packet_bytes;
+                const uint64_t rx_ts = ts && ts[i] ? ts[i] : arrival_ts;
+                if (shm_)
+                    OS1::publish_shm_packet(*shm_, OS1::SHM_LIDAR_PACKETS,
+                                            buf, rx_ts);
+                if (assembler_)
+                    OS1::add_lidar_packet(*assembler_, buf);
+                else
+                    (*batcher)(buf, it_);
+                last_rx_ts_ = rx_ts;
+            }
+        };
+    }
+
+    // one batcher per decode thread, each batching a whole frame into the
+    // message of the frame. The first packet of the next frame completes it
+    // and is batched into scratch
+    template <int W, typename C>
+    void start_frame_batchers(const OS1::xyz_lut& lut, const C& make) {
+        struct frame_scan {
+            PointOS1* it;
+            std::vector<PointOS1> scratch;
+            uint64_t scan_ts;
+            bool done;
+        };
+
+        const size_t n = decode_cfg_.n_threads;
+        auto scans = std::make_shared<std::vector<frame_scan>>(n);
+        auto make_batcher = [&](frame_scan* fs) {
+            fs->scratch.resize(W_ * H_);
+            return OS1::make_scan_batcher<W, OS1::pixels_per_column,
+                                          PointOS1*>(
+                lut, {}, make, [fs](uint64_t scan_ts) {
+                    fs->scan_ts = scan_ts;
+                    fs->done = true;
+                    fs->it = fs->scratch.data();
+                });
+        };
+        using batcher_type = decltype(make_batcher(nullptr));
+        auto batchers = std::make_shared<std::vector<batcher_type>>();
+        for (size_t w = 0; w < n; w++)
+            batchers->push_back(make_batcher(&(*scans)[w]));
+
+        decode_frame_ = [scans, batchers](int w, frame_packets& f,
+                                          const uint8_t* next) {
+            frame_scan& fs = (*scans)[w];
+            batcher_type& batch = (*batchers)[w];
+            fs.it = ouster_ros::OS1::cloud_msg_points(*f.msg);
+            fs.done = false;
+            batch.reset();
+            for (size_t i = 0; i < f.n; i++)
+                batch(f.bufs.data() + i * OS1::lidar_packet_bytes, fs.it);
+            batch(next, fs.it);
+            f.scan_ts = fs.scan_ts;
+            f.done = fs.done;
+        };
+    }
+
+    bool setup_decimator(ros::NodeHandle& nh) {
+        OS1::decimate_config cfg{};
+        cfg.col_stride = nh.param("decimate_col_stride", 1);
+        cfg.rings = nh.param("decimate_rings", std::vector<int>{});
+        const int ring_stride = nh.param("decimate_ring_stride", 1);
+        if (cfg.rings.empty() && ring_stride > 1)
+            for (uint32_t r = 0; r < H_; r += ring_stride)
+                cfg.rings.push_back(r);
+        cfg.block = nh.param("decimate_block", 2);
+        cfg.voxel_size = nh.param("decimate_voxel_size", 0.2);
+        cfg.max_voxels = nh.param("decimate_max_voxels", 65536);
+
+        const auto reduction =
+            nh.param("decimate_reduction", std::string{"none"});
+        if (reduction == "none")
+            cfg.reduction = OS1::REDUCE_NONE;
+        else if (reduction == "block_min")
+            cfg.reduction = OS1::REDUCE_BLOCK_MIN;
+        else if (reduction == "block_max")
+            cfg.reduction = OS1::REDUCE_BLOCK_MAX;
+        else if (reduction == "voxel")
+            cfg.reduction = OS1::REDUCE_VOXEL;
+        else {
+            ROS_ERROR("Invalid decimate reduction %s", reduction.c_str());
+            return false;
+        }
+
+        // the reduced cloud is only published if there is something to reduce
+        if (cfg.col_stride == 1 && cfg.rings.empty() &&
+            cfg.reduction == OS1::REDUCE_NONE)
+            return true;
+
+        decimator_ = OS1::init_decimator(W_, H_, cfg);
+        if (!decimator_) {
+            ROS_ERROR("Invalid decimation parameters");
+            return false;
+        }
+        decimated_pub_ =
+            nh.advertise<sensor_msgs::PointCloud2>("points_decimated", 10);
+        return true;
+    }
+
+    bool setup_pipeline(ros::NodeHandle& nh) {
+        if (!nh.param("pipeline", false)) return true;
+
+        OS1::queue_policy policy;
+        const auto policy_name =
+            nh.param("queue_policy", std::string{"drop_oldest"});
+        if (policy_name == "drop_oldest")
+            policy = OS1::QUEUE_DROP_OLDEST;
+        else if (policy_name == "drop_newest")
+            policy = OS1::QUEUE_DROP_NEWEST;
+        else if (policy_name == "block")
+            policy = OS1::QUEUE_BLOCK;
+        else {
+            ROS_ERROR("Invalid queue policy %s", policy_name.c_str());
+            return false;
+        }
+
+        const int n_packets = nh.param("decode_queue_packets", 256);
+        const int n_scans = nh.param("publish_queue_scans", 2);
+        decode_cfg_.n_threads = nh.param("decode_threads", 1);
+        decode_cfg_.cpus = nh.param("decode_cpus", std::vector<int>{});
+        publish_cfg_.cpus = nh.param("publish_cpus", std::vector<int>{});
+        if (n_packets < 1 || n_scans < 1 || decode_cfg_.n_threads < 1) {
+            ROS_ERROR("Invalid pipeline parameters");
+            return false;
+        }
+
+        decode_queue_.reset(new OS1::bounded_queue<packet_item>(
+            n_packets, policy, OS1::METRIC_DECODE_QUEUE_DEPTH));
+        publish_queue_.reset(new OS1::bounded_queue<scan_item>(
+            n_scans, policy, OS1::METRIC_PUBLISH_QUEUE_DEPTH));
+        return true;
+    }
+
+    void setup_filter(ros::NodeHandle& nh) {
+        auto mm = [&](const std::string& name, double def) {
+            return static_cast<uint32_t>(
+                std::max(std::lround(nh.param(name, def) * 1000), 0L));
+        };
+
+        OS1::filter_config cfg{};
+        cfg.min_range = mm("filter_min_range", 0.0);
+        cfg.max_range = mm("filter_max_range", 0.0);
+        cfg.min_neighbors = nh.param("filter_min_neighbors", 0);
+        cfg.neighbor_range = mm("filter_neighbor_range", 0.5);
+        cfg.edge_jump = mm("filter_edge_jump", 0.0);
+
+        if (cfg.min_range == 0 && cfg.max_range == 0 &&
+            cfg.min_neighbors <= 0 && cfg.edge_jump == 0)
+            return;
+
+        filter_ = OS1::init_filter(W_, H_, OS1::get_px_offset(W_), cfg);
+        range_.assign(W_ * H_, 0);
+    }
+
+    // remove flagged returns from the scan, keeping the cloud organized
+    void filter_points() {
+        const std::vector<uint8_t>& flags =
+            OS1::filter_scan(*filter_, range_.data());
+        for (size_t i = 0; i < flags.size(); i++)
+            if (flags[i]) it_[i] = PointOS1{};
+
+        // missing columns of the next scan have no returns
+        std::fill(range_.begin(), range_.end(), 0);
+    }
+
+    // copy the reduced scan into a recycled message
+    void publish_decimated(uint64_t scan_ts) {
+        const OS1::decimated_scan& s = OS1::finish_decimated(*decimator_);
+        auto m = decimated_pool_->acquire();
+        ouster_ros::OS1::resize_cloud_msg(*m, s.W, s.H);
+        m->header.stamp.fromNSec(scan_ts);
+        PointOS1* pts = ouster_ros::OS1::cloud_msg_points(*m);
+        for (int i = 0; i < s.W * s.H; i++)
+            pts[i] = PointOS1::make(s.x[i], s.y[i], s.z[i], s.signal[i],
+                                    s.t[i], s.reflectivity[i], s.ring[i],
+                                    s.noise[i], s.range[i]);
+        decimated_pub_.publish(m);
+    }
+
+    void publish_stats(const OS1::frame_stats& s) {
+        if (s.cols_received < s.n_cols)
+            ROS_WARN_THROTTLE(1, "Scan of frame %u incomplete: %d of %d "
+                              "columns received",
+                              s.frame_id, s.cols_received, s.n_cols);
+
+        auto m = stats_pool_->acquire();
+        m->header.stamp.fromNSec(s.scan_ts);
+        m->header.frame_id = lidar_frame_;
+        m->frame_id = s.frame_id;
+        m->columns = s.n_cols;
+        m->columns_received = s.cols_received;
+        m->reordered_packets = s.reordered_packets;
+        m->late_packets = s.late_packets;
+        m->duplicate_packets = s.duplicate_packets;
+        std::copy(s.received.begin(), s.received.end(), m->received.begin());
+        stats_pub_.publish(m);
+    }
+
+    // copy the scan to shared memory once for all local readers
+    void publish_shm(const PointOS1* scan, uint64_t scan_ts) {
+        auto pts = reinterpret_cast<PointOS1*>(
+            OS1::begin_shm_write(*shm_, OS1::SHM_SCANS));
+        std::copy(scan, scan + W_ * H_, pts);
+        OS1::commit_shm_write(*shm_, OS1::SHM_SCANS, scan_ts);
+    }
+
+    // copy the points of a sector out of the scan being batched
+    void publish_sector(const OS1::scan_sector& s) {
+        auto m = sector_pool_->acquire();
+        m->first_col = s.first_col;
+        m->n_cols = s.n_cols;
+        m->scan_ts = s.scan_ts;
+        m->first_ts = s.first_ts;
+        m->last_ts = s.last_ts;
+
+        ouster_ros::OS1::resize_cloud_msg(m->cloud, s.n_cols, H_);
+        m->cloud.header.stamp.fromNSec(s.scan_ts);
+        const PointOS1* first = it_ + H_ * s.first_col;
+        std::copy(first, first + H_ * s.n_cols,
+                  ouster_ros::OS1::cloud_msg_points(m->cloud));
+
+        sector_pub_.publish(m);
+    }
+
+    uint32_t W_{0};
+    uint32_t H_{0};
+    std::string imu_frame_;
+    std::string lidar_frame_;
+
+    // recycled messages, so publishing does not allocate in steady state
+    std::unique_ptr<ouster_ros::OS1::message_pool<sensor_msgs::PointCloud2>>
+        cloud_pool_;
+    std::unique_ptr<ouster_ros::OS1::message_pool<sensor_msgs::Imu>> imu_pool_;
+    std::unique_ptr<ouster_ros::OS1::message_pool<CloudSectorMsg>> sector_pool_;
+    std::unique_ptr<ouster_ros::OS1::message_pool<sensor_msgs::PointCloud2>>
+        decimated_pool_;
+    std::unique_ptr<ouster_ros::OS1::message_pool<FrameStatsMsg>> stats_pool_;
+
+    sensor_msgs::PointCloud2Ptr msg_;
+    PointOS1* it_{nullptr};
+    // batch one packet, or route packets through the assembler if any
+    std::function<void(const uint8_t*)> batch_packet_;
+    std::function<void(const uint8_t*, const uint64_t*, size_t, uint64_t)>
+        add_packets_;
+    std::shared_ptr<OS1::frame_assembler> assembler_;
+    // batch a frame on one of the decode threads, given the first packet of
+    // the next frame
+    std::function<void(int, frame_packets&, const uint8_t*)> decode_frame_;
+    // receive time of the packet batched last, which is the last packet of
+    // a scan while the next packet completes it
+    uint64_t last_rx_ts_{0};
+
+    // shared by the imu and lidar callbacks, which may run concurrently
+    std::shared_ptr<OS1::deskewer> deskewer_;
+    std::mutex deskew_mtx_;
+
+    std::shared_ptr<OS1::decimator> decimator_;
+    std::shared_ptr<OS1::scan_filter> filter_;
+    std::vector<uint32_t> range_;
+    std::shared_ptr<OS1::shm_publisher> shm_;
+
+    // decode and publish stages of the pipeline, if enabled. Frames may be
+    // decoded on several threads, but scans are published from a single
+    // thread so ~/points stays in order
+    std::unique_ptr<OS1::bounded_queue<packet_item>> decode_queue_;
+    std::unique_ptr<OS1::bounded_queue<scan_item>> publish_queue_;
+    OS1::thread_config decode_cfg_;
+    OS1::thread_config publish_cfg_;
+    std::thread decode_thread_;
+    std::thread publish_thread_;
+
+    ros::Publisher lidar_pub_;
+    ros::Publisher imu_pub_;
+    ros::Publisher sector_pub_;
+    ros::Publisher decimated_pub_;
+    ros::Publisher stats_pub_;
+    ros::Subscriber lidar_packet_sub_;
+    ros::Subscriber lidar_batch_sub_;
+    ros::Subscriber imu_packet_sub_;
+    tf2_ros::StaticTransformBroadcaster tf_bcast_;
+    ros::Timer diag_timer_;
+
+    std::atomic_bool stop_{false};
+    std::thread thread_;
+};
+}
+
+PLUGINLIB_EXPORT_CLASS(os1_nodelets::OS1CloudNodelet, nodelet::Nodelet)
@@ -0,0 +1,475 @@
+/**
+ * @file
+ * @brief Nodelet to publish raw OS-1 output on ROS topics
+ *
+ * ROS Parameters
+ * os1_hostname: hostname or IP in dotted decimal form of the sensor
+ * os1_udp_dest: hostname or IP where the sensor will send data packets
+ * os1_lidar_port: port to which the sensor should send lidar data
+ * os1_imu_port: port to which the sensor should send imu data
+ * os1_rcvbuf_bytes: kernel receive buffer size for the data sockets
+ * os1_busy_poll_us: busy-poll time for reads on the data sockets
+ * os1_hw_timestamps: request hardware receive timestamps from the NIC
+ * os1_recv_cpu: cpu to pin the receiving thread to, or -1 to not pin
+ * os1_recv_priority: SCHED_FIFO priority of the receiving thread, or 0 to
+ *   keep the default scheduler
+ * fast_start: only reconfigure and reinitialize the sensor if its active config
+ *   differs, and take intrinsics from the metadata file if it was written for
+ *   the same sensor and firmware
+ * lidar_packet_batch: lidar packets per message on ~/lidar_packet_batches; 0
+ *   to publish each packet on ~/lidar_packets, -1 for one batch per frame
+ * capture_file: record raw packets to this file; in replay mode, publish the
+ *   packets of this file instead of waiting for replayed topics
+ * replay_rate: capture replay speed relative to real time; 0 for as fast as
+ *   possible
+ * replay_start_frame: index of the first frame of the capture to replay
+ * diagnostics_period: seconds between packet counts published on
+ *   /diagnostics; 0 to disable
+ */
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/console.h>
+#include <ros/ros.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "ouster/os1_capture.h"
+#include "ouster/os1_metrics.h"
+#include "ouster/os1_packet.h"
+#include "ouster/os1_ring.h"
+#include "ouster/os1_util.h"
+#include "ouster_ros/OS1ConfigSrv.h"
+#include "ouster_ros/PacketBatchMsg.h"
+#include "ouster_ros/PacketMsg.h"
+#include "ouster_ros/os1_ros.h"
+
+using PacketMsg = ouster_ros::PacketMsg;
+using PacketBatchMsg = ouster_ros::PacketBatchMsg;
+using OS1ConfigSrv = ouster_ros::OS1ConfigSrv;
+namespace OS1 = ouster::OS1;
+
+namespace {
+
+// fill in values that could not be parsed from metadata
+void populate_metadata_defaults(OS1::sensor_info& info,
+                                const std::string& specified_lidar_mode) {
+    if (!info.hostname.size()) info.hostname = "UNKNOWN";
+
+    if (!info.sn.size()) info.sn = "UNKNOWN";
+
+    OS1::version v = OS1::version_of_string(info.fw_rev);
+    if (v == OS1::invalid_version)
+        ROS_WARN("Unknown sensor firmware version; output may not be reliable");
+    else if (v < OS1::min_version)
+        ROS_WARN("Firmware < %s not supported; output may not be reliable",
+                 to_string(OS1::min_version).c_str());
+
+    if (!info.mode) {
+        ROS_WARN(
+            "Lidar mode not found in metadata; output may not be reliable");
+        info.mode = OS1::lidar_mode_of_string(specified_lidar_mode);
+    }
+
+    if (info.beam_azimuth_angles.empty() || info.beam_altitude_angles.empty()) {
+        ROS_WARN("Beam angles not found in metadata; using design values");
+        info.beam_azimuth_angles = OS1::beam_azimuth_angles;
+        info.beam_altitude_angles = OS1::beam_altitude_angles;
+    }
+
+    if (info.imu_to_sensor_transform.empty() ||
+        info.lidar_to_sensor_transform.empty()) {
+        ROS_WARN("Frame transforms not found in metadata; using design values");
+        info.imu_to_sensor_transform = OS1::imu_to_sensor_transform;
+        info.lidar_to_sensor_transform = OS1::lidar_to_sensor_transform;
+    }
+}
+
+// try to read metadata file
+std::string read_metadata(const std::string& meta_file) {
+    if (meta_file.size()) {
+        ROS_INFO("Reading metadata from %s", meta_file.c_str());
+    } else {
+        ROS_WARN("No metadata file specified");
+        return "";
+    }
+
+    std::stringstream buf{};
+    std::ifstream ifs{};
+    ifs.open(meta_file);
+    buf << ifs.rdbuf();
+    ifs.close();
+
+    if (!ifs)
+        ROS_WARN("Failed to read %s; check that the path is valid",
+                 meta_file.c_str());
+
+    return buf.str();
+}
+
+// try to write metadata file
+void write_metadata(const std::string& meta_file, const std::string& metadata) {
+    std::ofstream ofs;
+    ofs.open(meta_file);
+    ofs << metadata << std::endl;
+    ofs.close();
+    if (ofs) {
+        ROS_INFO("Wrote metadata to %s", meta_file.c_str());
+    } else {
+        ROS_WARN("Failed to write metadata to %s; check that the path is valid",
+                 meta_file.c_str());
+    }
+}
+
+// messages preallocated for publishing packets; about half a 2048 column
+// frame of lidar packets and a second of imu packets
+const size_t lidar_pool_size = 64;
+const size_t imu_pool_size = 100;
+
+// copy a packet into a recycled message, which is handed to intra-process
+// subscribers without serialization
+PacketMsg::Ptr make_packet_msg(ouster_ros::OS1::message_pool<PacketMsg>& pool,
+                               const uint8_t* buf, size_t bytes) {
+    auto msg = pool.acquire();
+    msg->buf.resize(bytes + 1);
+    std::copy(buf, buf + bytes, msg->buf.begin());
+    return msg;
+}
+
+ouster_ros::OS1::message_pool<PacketMsg> packet_pool(size_t n, size_t bytes) {
+    return {n, [bytes](PacketMsg& m) { m.buf.resize(bytes + 1); }};
+}
+}
+
+namespace os1_nodelets {
+
+class OS1Nodelet : public nodelet::Nodelet {
+   public:
+    ~OS1Nodelet() override {
+        stop_ = true;
+        if (thread_.joinable()) thread_.join();
+    }
+
+   private:
+    void onInit() override {
+        ros::NodeHandle& nh = getPrivateNodeHandle();
+
+        // empty indicates "not set" since roslaunch xml can't optionally set
+        // params
+        auto hostname = nh.param("os1_hostname", std::string{});
+        auto udp_dest = nh.param("os1_udp_dest", std::string{});
+        auto lidar_port = nh.param("os1_lidar_port", 7501);
+        auto imu_port = nh.param("os1_imu_port", 7502);
+        auto replay = nh.param("replay", false);
+        auto lidar_mode = nh.param("lidar_mode", std::string{});
+
+        OS1::client_options opts{};
+        opts.rcvbuf_bytes = nh.param("os1_rcvbuf_bytes", 0);
+        opts.busy_poll_us = nh.param("os1_busy_poll_us", 0);
+        if (nh.param("os1_hw_timestamps", false))
+            opts.timestamps = OS1::TIMESTAMP_HARDWARE;
+        opts.recv_cpu = nh.param("os1_recv_cpu", -1);
+        opts.recv_priority = nh.param("os1_recv_priority", 0);
+        fast_start_ = nh.param("fast_start", false);
+        lidar_packet_batch_ = nh.param("lidar_packet_batch", 0);
+        capture_file_ = nh.param("capture_file", std::string{});
+
+        const double diag_period = nh.param("diagnostics_period", 1.0);
+        if (diag_period > 0)
+            diag_timer_ = ouster_ros::OS1::publish_diagnostics(
+                nh, diag_period,
+                {OS1::METRIC_LIDAR_PACKETS, OS1::METRIC_IMU_PACKETS,
+                 OS1::METRIC_DROPPED_PACKETS, OS1::METRIC_MALFORMED_PACKETS,
+                 OS1::METRIC_POOL_ALLOCATIONS, OS1::METRIC_HEAP_ALLOCATIONS},
+                {}, {OS1::METRIC_RECEIVE_QUEUE_DEPTH});
+
+        // fall back to metadata file name based on hostname, if available
+        meta_file_ = nh.param("metadata", std::string{});
+        if (!meta_file_.size() && hostname.size())
+            meta_file_ = hostname + ".json";
+
+        if (lidar_mode.size()) {
+            if (replay)
+                ROS_WARN("Lidar mode set in replay mode. May be ignored");
+        } else {
+            lidar_mode = OS1::to_string(OS1::MODE_1024x10);
+        }
+
+        if (!OS1::lidar_mode_of_string(lidar_mode)) {
+            ROS_ERROR("Invalid lidar mode %s", lidar_mode.c_str());
+            return;
+        }
+
+        if (!replay && (!hostname.size() || !udp_dest.size())) {
+            ROS_ERROR("Must specify both hostname and udp destination");
+            return;
+        }
+
+        if (replay && capture_file_.size()) {
+            ROS_INFO("Replaying %s", capture_file_.c_str());
+
+            auto rate = nh.param("replay_rate", 1.0);
+            auto start_frame = nh.param("replay_start_frame", 0);
+            thread_ = ouster_ros::OS1::start_setup(
+                getName(), stop_,
+                [=] { return replay_file(rate, start_frame); });
+            return;
+        }
+
+        if (replay) {
+            ROS_INFO("Running in replay mode");
+
+            // populate info for config service
+            metadata_ = read_metadata(meta_file_);
+            info_ = OS1::parse_metadata(metadata_);
+            populate_metadata_defaults(info_, lidar_mode);
+
+            ROS_INFO("Using lidar_mode: %s",
+                     OS1::to_string(info_.mode).c_str());
+            ROS_INFO("Sensor sn: %s firmware rev: %s", info_.sn.c_str(),
+                     info_.fw_rev.c_str());
+
+            // just serve config service
+            advertise_config(nh);
+            return;
+        }
+
+        // configuring the sensor blocks, so leave the manager thread free
+        thread_ = ouster_ros::OS1::start_setup(getName(), stop_, [=] {
+            return run(hostname, udp_dest, lidar_mode, lidar_port, imu_port,
+                       opts);
+        });
+    }
+
+    void advertise_config(ros::NodeHandle& nh) {
+        srv_ = nh.advertiseService<OS1ConfigSrv::Request,
+                                   OS1ConfigSrv::Response>(
+            "os1_config",
+            [this](OS1ConfigSrv::Request&, OS1ConfigSrv::Response& res) {
+                res.hostname = info_.hostname;
+                res.lidar_mode = to_string(info_.mode);
+                res.beam_azimuth_angles = info_.beam_azimuth_angles;
+                res.beam_altitude_angles = info_.beam_altitude_angles;
+                res.imu_to_sensor_transform = info_.imu_to_sensor_transform;
+                res.lidar_to_sensor_transform =
+                    info_.lidar_to_sensor_transform;
+                res.metadata = metadata_;
+                return true;
+            });
+    }
+
+    bool run(const std::string& hostname, const std::string& udp_dest,
+             const std::string& lidar_mode, int lidar_port, int imu_port,
+             const OS1::client_options& opts) {
+        ros::NodeHandle& nh = getPrivateNodeHandle();
+
+        ROS_INFO("Connecting to sensor at %s...", hostname.c_str());
+
+        ROS_INFO("Sending data to %s using lidar_mode: %s", udp_dest.c_str(),
+                 lidar_mode.c_str());
+
+        std::shared_ptr<OS1::client> cli;
+        if (fast_start_) {
+            // metadata written by a previous run, if any
+            cli = OS1::init_client_fast(
+                hostname, udp_dest, read_metadata(meta_file_),
+                OS1::lidar_mode_of_string(lidar_mode), lidar_port, imu_port,
+                opts);
+        } else {
+            cli = OS1::init_client(hostname, udp_dest,
+                                   OS1::lidar_mode_of_string(lidar_mode),
+                                   lidar_port, imu_port, opts);
+        }
+
+        if (!cli) {
+            ROS_ERROR("Failed to initialize sensor at: %s", hostname.c_str());
+            return false;
+        }
+        ROS_INFO("Sensor configured successfully, waiting for data...");
+
+        // write metadata file to cwd (usually ~/.ros)
+        metadata_ = OS1::get_metadata(*cli);
+        write_metadata(meta_file_, metadata_);
+
+        // populate sensor info
+        info_ = OS1::parse_metadata(metadata_);
+        populate_metadata_defaults(info_, "");
+
+        ROS_INFO("Sensor sn: %s firmware rev: %s", info_.sn.c_str(),
+                 info_.fw_rev.c_str());
+
+        if (capture_file_.size()) {
+            writer_ = OS1::open_capture_writer(capture_file_, metadata_);
+            if (!writer_) {
+                ROS_ERROR("Failed to open capture %s", capture_file_.c_str());
+                return false;
+            }
+            ROS_INFO("Recording packets to %s", capture_file_.c_str());
+        }
+
+        advertise_config(nh);
+
+        // publish packet messages from the sensor
+        return connection_loop(nh, cli);
+    }
+
+    bool replay_file(double rate, int start_frame) {
+        ros::NodeHandle& nh = getPrivateNodeHandle();
+
+        auto cap = OS1::open_capture(capture_file_);
+        if (!cap) {
+            ROS_ERROR("Failed to open capture %s", capture_file_.c_str());
+            return false;
+        }
+
+        // the capture carries the metadata of the sensor it was recorded from
+        metadata_ = OS1::capture_metadata(*cap);
+        info_ = OS1::parse_metadata(metadata_);
+        populate_metadata_defaults(info_, "");
+
+        ROS_INFO("Using lidar_mode: %s", OS1::to_string(info_.mode).c_str());
+        ROS_INFO("Sensor sn: %s firmware rev: %s", info_.sn.c_str(),
+                 info_.fw_rev.c_str());
+
+        const auto& frames = OS1::capture_frames(*cap);
+        ROS_INFO("Capture has %lu packets in %lu frames",
+                 (unsigned long)OS1::capture_size(*cap),
+                 (unsigned long)frames.size());
+
+        size_t first = 0;
+        if (start_frame > 0) {
+            if (size_t(start_frame) >= frames.size()) {
+                ROS_ERROR("Capture has no frame %d", start_frame);
+                return false;
+            }
+            first = frames[start_frame].first_packet;
+        }
+
+        advertise_config(nh);
+        advertise_packets(nh);
+
+        // packets are published straight from the mapped file
+        OS1::replay_capture(*cap, first, OS1::capture_size(*cap), rate,
+                            [this](const OS1::capture_packet& p) {
+                                if (p.type == OS1::LIDAR_PACKET)
+                                    publish_lidar_packet(p.buf, p.ts);
+                                else
+                                    publish_imu_packet(p.buf);
+                                return ros::ok() && !stop_;
+                            });
+
+        ROS_INFO("Finished replaying %s", capture_file_.c_str());
+        return true;
+    }
+
+    void advertise_packets(ros::NodeHandle& nh) {
+        if (lidar_packet_batch_) {
+            lidar_batch_pub_ =
+                nh.advertise<PacketBatchMsg>("lidar_packet_batches", 64);
+            lidar_batch_ = ouster_ros::OS1::batch_packets(
+                OS1::n_cols_of_lidar_mode(info_.mode),
+                std::max(lidar_packet_batch_, 0),
+                [this](const PacketBatchMsg::Ptr& m) {
+                    lidar_batch_pub_.publish(m);
+                });
+        } else {
+            lidar_packet_pub_ = nh.advertise<PacketMsg>("lidar_packets", 1280);
+        }
+        imu_packet_pub_ = nh.advertise<PacketMsg>("imu_packets", 100);
+    }
+
+    void publish_lidar_packet(const uint8_t* buf, uint64_t ts) {
+        if (lidar_batch_)
+            lidar_batch_(buf, ts);
+        else
+            lidar_packet_pub_.publish(make_packet_msg(
+                lidar_packet_pool_, buf, OS1::lidar_packet_bytes));
+    }
+
+    void publish_imu_packet(const uint8_t* buf) {
+        imu_packet_pub_.publish(
+            make_packet_msg(imu_packet_pool_, buf, OS1::imu_packet_bytes));
+    }
+
+    bool connection_loop(ros::NodeHandle& nh,
+                         std::shared_ptr<OS1::client> cli) {
+        advertise_packets(nh);
+
+        // read packets on a separate thread so publishing never delays
+        // receiving
+        auto rcv = OS1::start_receiver(cli);
+        if (!rcv) {
+            ROS_ERROR("Failed to start packet receiver");
+            return false;
+        }
+        OS1::packet_ring& lidar_ring = OS1::lidar_ring(*rcv);
+        OS1::packet_ring& imu_ring = OS1::imu_ring(*rcv);
+
+        uint64_t n_dropped = 0;
+        uint64_t n_overflows = 0;
+
+        while (ros::ok() && !stop_) {
+            auto state = OS1::wait_receiver(*rcv);
+            if (state & OS1::ERROR) {
+                ROS_ERROR("receiver: returned error");
+                return false;
+            }
+            OS1::record_depth(OS1::METRIC_RECEIVE_QUEUE_DEPTH,
+                              lidar_ring.size());
+            uint64_t ts;
+            while (const uint8_t* buf = lidar_ring.front(&ts)) {
+                if (writer_ && !OS1::write_lidar_packet(*writer_, buf, ts))
+                    return false;
+                publish_lidar_packet(buf, ts);
+                lidar_ring.pop();
+            }
+            while (const uint8_t* buf = imu_ring.front(&ts)) {
+                if (writer_ && !OS1::write_imu_packet(*writer_, buf, ts))
+                    return false;
+                publish_imu_packet(buf);
+                imu_ring.pop();
+            }
+            if (OS1::get_dropped_packets(*cli) != n_dropped) {
+                n_dropped = OS1::get_dropped_packets(*cli);
+                ROS_WARN_THROTTLE(1, "Kernel dropped %lu packets; consider "
+                                     "increasing os1_rcvbuf_bytes",
+                                  (unsigned long)n_dropped);
+            }
+            if (lidar_ring.overflows() + imu_ring.overflows() != n_overflows) {
+                n_overflows = lidar_ring.overflows() + imu_ring.overflows();
+                ROS_WARN_THROTTLE(1,
+                                  "Dropped %lu packets waiting to be published",
+                                  (unsigned long)n_overflows);
+            }
+        }
+        return true;
+    }
+
+    OS1::sensor_info info_{};
+    std::string metadata_;
+    std::string meta_file_;
+    int lidar_packet_batch_{0};
+    bool fast_start_{false};
+    std::string capture_file_;
+    std::shared_ptr<OS1::capture_writer> writer_;
+    ros::ServiceServer srv_;
+    ros::Publisher lidar_packet_pub_;
+    ros::Publisher lidar_batch_pub_;
+    ros::Publisher imu_packet_pub_;
+    ros::Timer diag_timer_;
+    ouster_ros::OS1::message_pool<PacketMsg> lidar_packet_pool_{
+        packet_pool(lidar_pool_size, OS1::lidar_packet_bytes)};
+    ouster_ros::OS1::message_pool<PacketMsg> imu_packet_pool_{
+        packet_pool(imu_pool_size, OS1::imu_packet_bytes)};
+    std::function<void(const uint8_t*, uint64_t)> lidar_batch_;
+    std::atomic_bool stop_{false};
+    std::thread thread_;
+};
+}
+
+PLUGINLIB_EXPORT_CLASS(os1_nodelets::OS1Nodelet, nodelet::Nodelet)
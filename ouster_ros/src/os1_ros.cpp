@@ -1,10 +1,16 @@
+#include <diagnostic_msgs/DiagnosticArray.h>
 #include <pcl_conversions/pcl_conversions.h>
 #include <ros/ros.h>
+#include <boost/make_shared.hpp>
 #include <tf2/LinearMath/Transform.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
 #include <cassert>
+#include <cstdio>
+#include <memory>
+#include <utility>
 
 #include "ouster/os1.h"
+#include "ouster/os1_metrics.h"
 #include "ouster/os1_packet.h"
 #include "ouster/os1_util.h"
 #include "ouster_ros/os1_ros.h"
@@ -14,6 +20,126 @@ namespace OS1 {
 
 using namespace ouster::OS1;
 
+namespace {
+
+// batch messages preallocated by batch_packets
+const size_t batch_pool_size = 8;
+
+// state of the function returned by batch_packets
+struct packet_batcher {
+    int slots_per_frame;
+    size_t max_received;
+    std::function<void(const PacketBatchMsg::Ptr&)> f;
+
+    message_pool<PacketBatchMsg> pool;
+    PacketBatchMsg::Ptr msg{};
+    int32_t cur_f_id{-1};
+    int next_slot{0};
+
+    packet_batcher(int slots, size_t max,
+                   std::function<void(const PacketBatchMsg::Ptr&)> fn)
+        : slots_per_frame{slots},
+          max_received{max},
+          f{fn},
+          pool{batch_pool_size, [slots, max](PacketBatchMsg& m) {
+                   m.receive_stamps.reserve(max);
+                   m.dropped.reserve((slots + 7) / 8);
+                   m.buf.reserve(max * lidar_packet_bytes);
+               }} {}
+
+    void start() {
+        msg = pool.acquire();
+        msg->frame_id = cur_f_id;
+        msg->first_packet = next_slot;
+        msg->n_packets = 0;
+        msg->receive_stamps.clear();
+        msg->dropped.clear();
+        msg->buf.clear();
+    }
+
+    // add the next slot to the batch
+    void cover(bool received) {
+        const int i = msg->n_packets++;
+        if (i % 8 == 0) msg->dropped.push_back(0);
+        if (!received) msg->dropped.back() |= 1 << (i % 8);
+        next_slot++;
+    }
+
+    void flush() {
+        f(msg);
+        msg.reset();
+    }
+
+    // publish the remaining slots of the current frame as dropped
+    void finish_frame() {
+        if (next_slot >= slots_per_frame) return;
+        if (!msg) start();
+        while (next_slot < slots_per_frame) cover(false);
+        flush();
+    }
+
+    void operator()(const uint8_t* buf, uint64_t ts) {
+        const uint8_t* col_buf = nth_col(0, buf);
+        const uint16_t f_id = col_frame_id(col_buf);
+        const int slot = col_measurement_id(col_buf) / columns_per_buffer;
+
+        // drop out-of-bounds data in case of misconfiguration
+        if (slot >= slots_per_frame) return;
+
+        if (f_id != cur_f_id) {
+            // the first frame is only covered from the first packet received
+            if (cur_f_id != -1) {
+                finish_frame();
+                next_slot = 0;
+            } else {
+                next_slot = slot;
+            }
+            cur_f_id = f_id;
+        }
+
+        if (slot < next_slot) return;
+
+        if (!msg) start();
+        while (next_slot < slot) cover(false);
+        cover(true);
+        msg->receive_stamps.push_back(ts);
+        msg->buf.insert(msg->buf.end(), buf, buf + lidar_packet_bytes);
+
+        if (msg->receive_stamps.size() == max_received ||
+            next_slot == slots_per_frame)
+            flush();
+    }
+};
+}
+
+bool get_config(ros::NodeHandle& nh, OS1ConfigSrv& cfg,
+                const std::atomic_bool& stop) {
+    auto client = nh.serviceClient<OS1ConfigSrv>("os1_config");
+    while (!client.waitForExistence(ros::Duration(1.0)))
+        if (stop || !ros::ok()) return false;
+
+    if (!client.call(cfg)) {
+        ROS_ERROR("Calling os1 config service failed");
+        return false;
+    }
+    return true;
+}
+
+std::thread start_setup(const std::string& name, const std::atomic_bool& stop,
+                        std::function<bool()> setup) {
+    return std::thread{[name, &stop, setup] {
+        if (!setup() && !stop)
+            ROS_ERROR("Failed to set up %s; it will stay idle", name.c_str());
+    }};
+}
+
+std::function<void(const uint8_t*, uint64_t)> batch_packets(
+    int W, int n_packets, std::function<void(const PacketBatchMsg::Ptr&)> f) {
+    const int slots_per_frame = W / columns_per_buffer;
+    const int max_received = n_packets > 0 ? n_packets : slots_per_frame;
+    return packet_batcher(slots_per_frame, max_received, f);
+}
+
 bool read_imu_packet(const client& cli, PacketMsg& m) {
     m.buf.resize(imu_packet_bytes + 1);
     return read_imu_packet(cli, m.buf.data());
@@ -26,8 +152,14 @@ bool read_lidar_packet(const client& cli, PacketMsg& m) {
 
 sensor_msgs::Imu packet_to_imu_msg(const PacketMsg& p,
                                    const std::string& frame) {
-    const double standard_g = 9.80665;
     sensor_msgs::Imu m;
+    packet_to_imu_msg(p, frame, m);
+    return m;
+}
+
+void packet_to_imu_msg(const PacketMsg& p, const std::string& frame,
+                       sensor_msgs::Imu& m) {
+    const double standard_g = 9.80665;
     const uint8_t* buf = p.buf.data();
 
     m.header.stamp.fromNSec(imu_gyro_ts(buf));
@@ -55,8 +187,6 @@ sensor_msgs::Imu packet_to_imu_msg(const PacketMsg& p,
         m.linear_acceleration_covariance[i] = 0.01;
         m.angular_velocity_covariance[i] = 6e-4;
     }
-
-    return m;
 }
 
 sensor_msgs::PointCloud2 cloud_to_cloud_msg(const CloudOS1& cloud, ns timestamp,
@@ -68,6 +198,47 @@ sensor_msgs::PointCloud2 cloud_to_cloud_msg(const CloudOS1& cloud, ns timestamp,
     return msg;
 }
 
+void cloud_to_scan_channels(const CloudOS1& cloud,
+                            ouster::OS1::scan_channels& scan) {
+    assert(cloud.size() == scan.range.size());
+    for (size_t i = 0; i < cloud.size(); i++) {
+        const auto& pt = cloud[i];
+        scan.range[i] = pt.range;
+        scan.signal[i] = pt.intensity;
+        scan.reflectivity[i] = pt.reflectivity;
+        scan.noise[i] = pt.noise;
+    }
+}
+
+sensor_msgs::PointCloud2Ptr make_cloud_msg(uint32_t W, uint32_t H,
+                                           const std::string& frame) {
+    auto msg = boost::make_shared<sensor_msgs::PointCloud2>();
+    init_cloud_msg(*msg, W, H, frame);
+    return msg;
+}
+
+void init_cloud_msg(sensor_msgs::PointCloud2& msg, uint32_t W, uint32_t H,
+                    const std::string& frame) {
+    // fields and point step exactly as produced by pcl::toROSMsg
+    pcl::toROSMsg(CloudOS1{}, msg);
+
+    msg.header.frame_id = frame;
+    resize_cloud_msg(msg, W, H);
+}
+
+void resize_cloud_msg(sensor_msgs::PointCloud2& msg, uint32_t W, uint32_t H) {
+    msg.width = W;
+    msg.height = H;
+    msg.row_step = msg.point_step * W;
+    msg.data.resize(msg.row_step * H);
+}
+
+PointOS1* cloud_msg_points(sensor_msgs::PointCloud2& msg) {
+    // toROSMsg stores points as raw PointOS1 values, padding included
+    assert(msg.point_step == sizeof(PointOS1));
+    return reinterpret_cast<PointOS1*>(msg.data.data());
+}
+
 geometry_msgs::TransformStamped transform_to_tf_msg(
     const std::vector<double>& mat, const std::string& frame,
     const std::string& child_frame) {
@@ -87,5 +258,83 @@ geometry_msgs::TransformStamped transform_to_tf_msg(
 
     return msg;
 }
+ros::Timer publish_diagnostics(ros::NodeHandle& nh, double period,
+                               const std::vector<metric_counter>& counters,
+                               const std::vector<metric_latency>& latencies,
+                               const std::vector<metric_depth>& depths) {
+    auto pub = nh.advertise<diagnostic_msgs::DiagnosticArray>(
+        "/diagnostics", 1);
+    const std::string name = nh.getNamespace();
+    const std::string process = ros::this_node::getName();
+
+    // counters as of the previous period, to detect new data loss
+    auto prev = std::make_shared<metrics_snapshot>(get_metrics());
+
+    auto us = [](uint64_t ns) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.1f", ns / 1e3);
+        return std::string{buf};
+    };
+
+    return nh.createTimer(
+        ros::Duration(period), [=](const ros::TimerEvent&) {
+            const metrics_snapshot m = get_metrics();
+
+            diagnostic_msgs::DiagnosticStatus status;
+            status.name = name;
+            status.level = diagnostic_msgs::DiagnosticStatus::OK;
+            status.message = "OK";
+            status.hardware_id = process;
+            diagnostic_msgs::KeyValue scope;
+            scope.key = "scope";
+            scope.value = "process " + process;
+            status.values.push_back(scope);
+            for (metric_counter c : counters) {
+                diagnostic_msgs::KeyValue kv;
+                kv.key = to_string(c);
+                kv.value = std::to_string(m.counters[c]);
+                status.values.push_back(kv);
+
+                const bool lost = c == METRIC_DROPPED_PACKETS ||
+                                  c == METRIC_MALFORMED_PACKETS ||
+                                  c == METRIC_MISSING_COLUMNS ||
+                                  c == METRIC_QUEUE_DROPS;
+                if (lost && m.counters[c] != prev->counters[c]) {
+                    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+                    status.message = "Data lost";
+                }
+                prev->counters[c] = m.counters[c];
+            }
+            for (metric_latency l : latencies) {
+                const latency_summary& s = m.latencies[l];
+                const std::pair<const char*, uint64_t> values[] = {
+                    {"_mean_us", s.mean}, {"_p50_us", s.p50},
+                    {"_p90_us", s.p90},   {"_p99_us", s.p99},
+                    {"_max_us", s.max}};
+                for (const auto& v : values) {
+                    diagnostic_msgs::KeyValue kv;
+                    kv.key = std::string{to_string(l)} + v.first;
+                    kv.value = us(v.second);
+                    status.values.push_back(kv);
+                }
+            }
+            for (metric_depth d : depths) {
+                const latency_summary& s = m.depths[d];
+                const std::pair<const char*, uint64_t> values[] = {
+                    {"_mean", s.mean}, {"_p99", s.p99}, {"_max", s.max}};
+                for (const auto& v : values) {
+                    diagnostic_msgs::KeyValue kv;
+                    kv.key = std::string{to_string(d)} + v.first;
+                    kv.value = std::to_string(v.second);
+                    status.values.push_back(kv);
+                }
+            }
+
+            diagnostic_msgs::DiagnosticArray msg;
+            msg.header.stamp = ros::Time::now();
+            msg.status.push_back(status);
+            pub.publish(msg);
+        });
+}
 }
 }
@@ -0,0 +1,154 @@
+/**
+ * @file
+ * @brief Nodelet to publish OS-1 point clouds from compressed scans
+ *
+ * Decodes scans published by scan_encoder_node on ~/compressed_scan and
+ * publishes them on ~/points in the same layout as os1_cloud_node, computing
+ * xyz with the lookup table of the sensor from ~/os1_config.
+ *
+ * ROS Parameters
+ * tf_prefix: prefix of the frame name of the points
+ */
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/console.h>
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ouster/os1_codec.h"
+#include "ouster/os1_packet.h"
+#include "ouster/os1_util.h"
+#include "ouster_ros/CompressedScanMsg.h"
+#include "ouster_ros/OS1ConfigSrv.h"
+#include "ouster_ros/os1_ros.h"
+#include "ouster_ros/point_os1.h"
+
+using CompressedScanMsg = ouster_ros::CompressedScanMsg;
+using PointOS1 = ouster_ros::OS1::PointOS1;
+
+namespace OS1 = ouster::OS1;
+
+namespace {
+
+// subscribers in the same process may still hold a scan while the next one is
+// decoded
+const size_t cloud_pool_size = 3;
+}
+
+namespace os1_nodelets {
+
+class ScanDecoderNodelet : public nodelet::Nodelet {
+   public:
+    ~ScanDecoderNodelet() override {
+        stop_ = true;
+        if (thread_.joinable()) thread_.join();
+    }
+
+   private:
+    void onInit() override {
+        thread_ = ouster_ros::OS1::start_setup(getName(), stop_,
+                                               [this] { return setup(); });
+    }
+
+    bool setup() {
+        ros::NodeHandle& nh = getPrivateNodeHandle();
+
+        const auto frame =
+            nh.param("tf_prefix", std::string{}) + "/os1_lidar";
+
+        ouster_ros::OS1ConfigSrv cfg{};
+        if (!ouster_ros::OS1::get_config(nh, cfg, stop_)) return false;
+
+        W_ = OS1::n_cols_of_lidar_mode(
+            OS1::lidar_mode_of_string(cfg.response.lidar_mode));
+        H_ = OS1::pixels_per_column;
+
+        // the same table as os1_cloud_node, so points are identical
+        lut_ = OS1::make_xyz_lut(W_, H_, cfg.response.beam_azimuth_angles,
+                                 cfg.response.beam_altitude_angles, {});
+        codec_ = OS1::init_codec(W_, H_, OS1::CODEC_ALL, 1);
+        if (!codec_) return false;
+        scan_.reset(new OS1::scan_channels(W_, H_));
+        x_.resize(W_ * H_);
+        y_.resize(W_ * H_);
+        z_.resize(W_ * H_);
+
+        const uint32_t W = W_, H = H_;
+        cloud_pool_.reset(
+            new ouster_ros::OS1::message_pool<sensor_msgs::PointCloud2>(
+                cloud_pool_size, [=](sensor_msgs::PointCloud2& m) {
+                    ouster_ros::OS1::init_cloud_msg(m, W, H, frame);
+                }));
+
+        lidar_pub_ = nh.advertise<sensor_msgs::PointCloud2>("points", 10);
+        scan_sub_ = nh.subscribe<CompressedScanMsg>(
+            "compressed_scan", 10,
+            [this](const CompressedScanMsg::ConstPtr& m) {
+                publish_points(*m);
+            });
+        return true;
+    }
+
+    void publish_points(const CompressedScanMsg& msg) {
+        if (msg.width != W_ || msg.height != H_) {
+            ROS_ERROR_THROTTLE(1, "Unexpected scan size; check lidar_mode");
+            return;
+        }
+        uint64_t scan_ts;
+        if (!OS1::decode_scan(*codec_, msg.data.data(), msg.data.size(),
+                              *scan_, scan_ts))
+            return;
+
+        const OS1::scan_channels& s = *scan_;
+        OS1::project_xyz(lut_, s.range.data(), x_.data(), y_.data(),
+                         z_.data());
+
+        auto m = cloud_pool_->acquire();
+        m->header.stamp = msg.header.stamp;
+        PointOS1* pts = ouster_ros::OS1::cloud_msg_points(*m);
+        for (uint32_t j = 0; j < W_; j++) {
+            PointOS1* col = pts + H_ * j;
+            // missing columns are empty, as batched by os1_cloud_node
+            if (!s.col_ts[j]) {
+                std::fill(col, col + H_, PointOS1{});
+                continue;
+            }
+            const uint32_t t = s.col_ts[j] - scan_ts;
+            for (uint32_t i = 0; i < H_; i++) {
+                const uint32_t idx = H_ * j + i;
+                col[i] = PointOS1::make(x_[idx], y_[idx], z_[idx],
+                                        s.signal[idx], t, s.reflectivity[idx],
+                                        i, s.noise[idx], s.range[idx]);
+            }
+        }
+        lidar_pub_.publish(m);
+    }
+
+    uint32_t W_{0};
+    uint32_t H_{0};
+    OS1::xyz_lut lut_;
+    std::shared_ptr<OS1::scan_codec> codec_;
+    std::unique_ptr<OS1::scan_channels> scan_;
+    std::vector<float> x_;
+    std::vector<float> y_;
+    std::vector<float> z_;
+
+    std::unique_ptr<ouster_ros::OS1::message_pool<sensor_msgs::PointCloud2>>
+        cloud_pool_;
+
+    ros::Publisher lidar_pub_;
+    ros::Subscriber scan_sub_;
+
+    std::atomic_bool stop_{false};
+    std::thread thread_;
+};
+}
+
+PLUGINLIB_EXPORT_CLASS(os1_nodelets::ScanDecoderNodelet, nodelet::Nodelet)
@@ -0,0 +1,27 @@
+/**
+ * @file
+ * @brief Example node to publish compressed OS-1 scans for remote consumers
+ *
+ * Runs the ouster_ros/ScanEncoderNodelet nodelet in its own process; see the
+ * nodelet source for parameters
+ */
+
+#include <nodelet/loader.h>
+#include <ros/ros.h>
+#include <string>
+
+int main(int argc, char** argv) {
+    ros::init(argc, argv, "scan_encoder_node");
+
+    nodelet::Loader loader{};
+    nodelet::M_string remap(ros::names::getRemappings());
+    nodelet::V_string nargv{};
+    const std::string type = "ouster_ros/ScanEncoderNodelet";
+    if (!loader.load(ros::this_node::getName(), type, remap, nargv)) {
+        ROS_ERROR("Failed to load nodelet %s", type.c_str());
+        return EXIT_FAILURE;
+    }
+
+    ros::spin();
+    return EXIT_SUCCESS;
+}
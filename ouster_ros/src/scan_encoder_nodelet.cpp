@@ -0,0 +1,150 @@
+/**
+ * @file
+ * @brief Nodelet to publish compressed OS-1 scans for remote consumers
+ *
+ * Batches ~/lidar_packets or ~/lidar_packet_batches into scans and publishes
+ * each losslessly compressed on ~/compressed_scan, from which
+ * scan_decoder_node reconstructs the points. Scans are not deskewed or
+ * filtered.
+ *
+ * ROS Parameters
+ * tf_prefix: prefix of the frame name of the points
+ * compressed_channels: channels encoded in addition to ranges; any of signal,
+ *   reflectivity and noise (default all three). Other channels are decoded as
+ *   zero
+ * compression_level: deflate level from 1 (fastest, default) to 9 (smallest)
+ */
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/console.h>
+#include <ros/ros.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ouster/os1_codec.h"
+#include "ouster/os1_packet.h"
+#include "ouster/os1_util.h"
+#include "ouster_ros/CompressedScanMsg.h"
+#include "ouster_ros/OS1ConfigSrv.h"
+#include "ouster_ros/PacketBatchMsg.h"
+#include "ouster_ros/PacketMsg.h"
+#include "ouster_ros/os1_ros.h"
+
+using CompressedScanMsg = ouster_ros::CompressedScanMsg;
+using PacketMsg = ouster_ros::PacketMsg;
+using PacketBatchMsg = ouster_ros::PacketBatchMsg;
+
+namespace OS1 = ouster::OS1;
+
+namespace {
+
+// subscribers in the same process may still hold a scan while the next one is
+// encoded
+const size_t scan_pool_size = 3;
+}
+
+namespace os1_nodelets {
+
+class ScanEncoderNodelet : public nodelet::Nodelet {
+   public:
+    ~ScanEncoderNodelet() override {
+        stop_ = true;
+        if (thread_.joinable()) thread_.join();
+    }
+
+   private:
+    void onInit() override {
+        thread_ = ouster_ros::OS1::start_setup(getName(), stop_,
+                                               [this] { return setup(); });
+    }
+
+    bool setup() {
+        ros::NodeHandle& nh = getPrivateNodeHandle();
+
+        const auto frame =
+            nh.param("tf_prefix", std::string{}) + "/os1_lidar";
+
+        uint8_t channels = 0;
+        for (const auto& ch : nh.param(
+                 "compressed_channels",
+                 std::vector<std::string>{"signal", "reflectivity", "noise"})) {
+            if (ch == "signal")
+                channels |= OS1::CODEC_SIGNAL;
+            else if (ch == "reflectivity")
+                channels |= OS1::CODEC_REFLECTIVITY;
+            else if (ch == "noise")
+                channels |= OS1::CODEC_NOISE;
+            else {
+                ROS_ERROR("Invalid compressed channel %s", ch.c_str());
+                return false;
+            }
+        }
+
+        ouster_ros::OS1ConfigSrv cfg{};
+        if (!ouster_ros::OS1::get_config(nh, cfg, stop_)) return false;
+
+        const int W = OS1::n_cols_of_lidar_mode(
+            OS1::lidar_mode_of_string(cfg.response.lidar_mode));
+        const int H = OS1::pixels_per_column;
+
+        codec_ = OS1::init_codec(W, H, channels,
+                                 nh.param("compression_level", 1));
+        if (!codec_) {
+            ROS_ERROR("Invalid compression parameters");
+            return false;
+        }
+        scan_.reset(new OS1::scan_channels(W, H));
+        scan_pool_.reset(new ouster_ros::OS1::message_pool<CompressedScanMsg>(
+            scan_pool_size, [=](CompressedScanMsg& m) {
+                m.header.frame_id = frame;
+                m.width = W;
+                m.height = H;
+            }));
+
+        scan_pub_ = nh.advertise<CompressedScanMsg>("compressed_scan", 10);
+
+        // the scan is encoded before columns of the next one are added
+        batch_and_publish_ = OS1::batch_to_channels([this](uint64_t scan_ts) {
+            auto m = scan_pool_->acquire();
+            m->header.stamp.fromNSec(scan_ts);
+            if (OS1::encode_scan(*codec_, *scan_, scan_ts, m->data))
+                scan_pub_.publish(m);
+        });
+
+        lidar_packet_sub_ = nh.subscribe<PacketMsg>(
+            "lidar_packets", 2048, [this](const PacketMsg::ConstPtr& pm) {
+                batch_and_publish_(pm->buf.data(), *scan_);
+            });
+        lidar_batch_sub_ = nh.subscribe<PacketBatchMsg>(
+            "lidar_packet_batches", 64,
+            [this](const PacketBatchMsg::ConstPtr& pm) {
+                const uint8_t* buf = pm->buf.data();
+                for (size_t i = 0; i < pm->receive_stamps.size(); i++)
+                    batch_and_publish_(buf + i * OS1::lidar_packet_bytes,
+                                       *scan_);
+            });
+        return true;
+    }
+
+    std::shared_ptr<OS1::scan_codec> codec_;
+    std::unique_ptr<OS1::scan_channels> scan_;
+    std::unique_ptr<ouster_ros::OS1::message_pool<CompressedScanMsg>>
+        scan_pool_;
+    std::function<void(const uint8_t*, OS1::scan_channels&)>
+        batch_and_publish_;
+
+    ros::Publisher scan_pub_;
+    ros::Subscriber lidar_packet_sub_;
+    ros::Subscriber lidar_batch_sub_;
+
+    std::atomic_bool stop_{false};
+    std::thread thread_;
+};
+}
+
+PLUGINLIB_EXPORT_CLASS(os1_nodelets::ScanEncoderNodelet, nodelet::Nodelet)
@@ -0,0 +1,102 @@
+/**
+ * Nodelet to visualize OS1 lidar data
+ *
+ * ROS Parameters
+ * lidar_mode: width of lidar scan - either 512, 1024 (default) or 2048
+ */
+
+#include <nodelet/nodelet.h>
+#include <pcl_ros/point_cloud.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/console.h>
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <thread>
+#include <utility>
+
+#include "ouster/os1_packet.h"
+#include "ouster/viz.h"
+#include "ouster_ros/OS1ConfigSrv.h"
+#include "ouster_ros/os1_ros.h"
+#include "ouster_ros/point_os1.h"
+
+using CloudOS1 = ouster_ros::OS1::CloudOS1;
+using PointOS1 = ouster_ros::OS1::PointOS1;
+
+namespace viz = ouster::viz;
+namespace OS1 = ouster::OS1;
+
+namespace os1_nodelets {
+
+class VizNodelet : public nodelet::Nodelet {
+   public:
+    ~VizNodelet() override {
+        stop_ = true;
+        if (thread_.joinable()) thread_.join();
+        if (vh_) viz::shutdown(*vh_);
+        if (render_.joinable()) render_.join();
+    }
+
+   private:
+    void onInit() override {
+        thread_ = ouster_ros::OS1::start_setup(getName(), stop_,
+                                               [this] { return setup(); });
+    }
+
+    bool setup() {
+        ros::NodeHandle& nh = getPrivateNodeHandle();
+
+        ouster_ros::OS1ConfigSrv cfg{};
+        if (!ouster_ros::OS1::get_config(nh, cfg, stop_)) return false;
+
+        H_ = OS1::pixels_per_column;
+        W_ = OS1::n_cols_of_lidar_mode(
+            OS1::lidar_mode_of_string(cfg.response.lidar_mode));
+
+        vh_ = viz::init_viz(W_, H_);
+        ls_.reset(new ouster::CompactLidarScan(W_, H_, true));
+
+        pc_sub_ = nh.subscribe<sensor_msgs::PointCloud2>(
+            "points", 10, &VizNodelet::cloud_handler, this);
+
+        // closing the window only stops this nodelet
+        render_ = std::thread([this] { viz::run_viz(*vh_); });
+        return true;
+    }
+
+    void cloud_handler(const sensor_msgs::PointCloud2::ConstPtr& m) {
+        pcl::fromROSMsg(*m, cloud_);
+
+        if ((int)cloud_.size() != W_ * H_) {
+            ROS_ERROR_THROTTLE(1, "Unexpected cloud size; check lidar_mode");
+            return;
+        }
+
+        std::transform(cloud_.begin(), cloud_.end(), ls_->begin(),
+                       [](const PointOS1& p) {
+                           return ouster::CompactLidarScan::make_val(
+                               p.x, p.y, p.z, p.intensity, p.t, p.reflectivity,
+                               p.ring, p.noise, p.range);
+                       });
+
+        viz::update(*vh_, ls_);
+    }
+
+    int W_{0};
+    int H_{0};
+    std::shared_ptr<viz::VizHandle> vh_;
+    std::unique_ptr<ouster::CompactLidarScan> ls_;
+    CloudOS1 cloud_{};
+
+    ros::Subscriber pc_sub_;
+
+    std::atomic_bool stop_{false};
+    std::thread thread_;
+    std::thread render_;
+};
+}
+
+PLUGINLIB_EXPORT_CLASS(os1_nodelets::VizNodelet, nodelet::Nodelet)
@@ -6,10 +6,14 @@
 #pragma once
 
 #include <Eigen/Eigen>
+#include <cstddef>
+#include <cstdint>
 #include <iterator>
 #include <utility>
 #include <vector>
 
+#include "ouster/os1_util.h"
+
 namespace ouster {
 
 struct LidarScan {
@@ -78,4 +82,228 @@ struct LidarScan {
         friend class LidarScan;
     };
 };
+
+/**
+ * Holds lidar data in column-major order like LidarScan, with each field in
+ * its own contiguous, aligned plane of its native width: 10 bytes per point
+ * instead of 48. Cartesian coordinates are optional; they are either stored
+ * when batching, if the scan is constructed with xyz, or computed later from
+ * the ranges with project().
+ */
+struct CompactLidarScan {
+    template <typename T>
+    using Plane = Eigen::Array<T, Eigen::Dynamic, 1>;
+
+    struct Point {
+        float x;
+        float y;
+        float z;
+        uint16_t intensity;
+        uint16_t reflectivity;
+        uint16_t noise;
+        uint32_t range;
+    };
+
+    const ssize_t W;
+    const ssize_t H;
+
+    CompactLidarScan(size_t w, size_t h, bool xyz = false)
+        : W(w),
+          H(h),
+          range_{Plane<uint32_t>::Zero(w * h)},
+          intensity_{Plane<uint16_t>::Zero(w * h)},
+          reflectivity_{Plane<uint16_t>::Zero(w * h)},
+          noise_{Plane<uint16_t>::Zero(w * h)} {
+        if (xyz) alloc_xyz();
+    }
+
+    Plane<uint32_t>& range() { return range_; }
+    Plane<uint16_t>& intensity() { return intensity_; }
+    Plane<uint16_t>& reflectivity() { return reflectivity_; }
+    Plane<uint16_t>& noise() { return noise_; }
+    const Plane<uint32_t>& range() const { return range_; }
+    const Plane<uint16_t>& intensity() const { return intensity_; }
+    const Plane<uint16_t>& reflectivity() const { return reflectivity_; }
+    const Plane<uint16_t>& noise() const { return noise_; }
+
+    /** whether x, y and z are stored; they are empty otherwise */
+    bool has_xyz() const { return x_.size() != 0; }
+
+    Plane<float>& x() { return x_; }
+    Plane<float>& y() { return y_; }
+    Plane<float>& z() { return z_; }
+    const Plane<float>& x() const { return x_; }
+    const Plane<float>& y() const { return y_; }
+    const Plane<float>& z() const { return z_; }
+
+    /**
+     * Compute and store x, y, z in m from the ranges, as batch_to_iter would
+     * @param lut lookup table with the same dimensions as the scan
+     */
+    void project(const OS1::xyz_lut& lut) {
+        if (!has_xyz()) alloc_xyz();
+        OS1::project_xyz(lut, range_.data(), x_.data(), y_.data(), z_.data());
+    }
+
+    static inline Point make_val(float x, float y, float z,
+                                 uint16_t intensity, uint32_t,
+                                 uint16_t reflectivity, uint8_t,
+                                 uint16_t noise, uint32_t range) {
+        return Point{x, y, z, intensity, reflectivity, noise, range};
+    }
+
+    class iterator;
+
+    /**
+     * Proxy for the point at an index, readable and assignable as a Point.
+     * Coordinates assigned to a scan without xyz are dropped
+     */
+    class reference {
+       public:
+        reference& operator=(const Point& p) {
+            ls_->range_[i_] = p.range;
+            ls_->intensity_[i_] = p.intensity;
+            ls_->reflectivity_[i_] = p.reflectivity;
+            ls_->noise_[i_] = p.noise;
+            if (ls_->has_xyz()) {
+                ls_->x_[i_] = p.x;
+                ls_->y_[i_] = p.y;
+                ls_->z_[i_] = p.z;
+            }
+            return *this;
+        }
+
+        reference& operator=(const reference& other) {
+            return *this = static_cast<Point>(other);
+        }
+
+        operator Point() const {
+            const bool xyz = ls_->has_xyz();
+            return Point{xyz ? ls_->x_[i_] : 0.0f,
+                         xyz ? ls_->y_[i_] : 0.0f,
+                         xyz ? ls_->z_[i_] : 0.0f,
+                         ls_->intensity_[i_],
+                         ls_->reflectivity_[i_],
+                         ls_->noise_[i_],
+                         ls_->range_[i_]};
+        }
+
+        friend void swap(reference a, reference b) {
+            const Point tmp = a;
+            a = static_cast<Point>(b);
+            b = tmp;
+        }
+
+       private:
+        reference(CompactLidarScan* ls, std::ptrdiff_t i) : ls_{ls}, i_{i} {}
+        CompactLidarScan* ls_;
+        std::ptrdiff_t i_;
+
+        friend class iterator;
+    };
+
+    /**
+     * Random-access iterator over the points of a scan in column-major order
+     */
+    class iterator {
+       public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = CompactLidarScan::Point;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = CompactLidarScan::reference;
+
+        iterator() : ls_{nullptr}, i_{0} {}
+
+        reference operator*() const { return reference{ls_, i_}; }
+        reference operator[](difference_type n) const {
+            return reference{ls_, i_ + n};
+        }
+
+        iterator& operator++() {
+            i_++;
+            return *this;
+        }
+        iterator& operator--() {
+            i_--;
+            return *this;
+        }
+        iterator operator++(int) {
+            iterator tmp = *this;
+            i_++;
+            return tmp;
+        }
+        iterator operator--(int) {
+            iterator tmp = *this;
+            i_--;
+            return tmp;
+        }
+        iterator& operator+=(difference_type n) {
+            i_ += n;
+            return *this;
+        }
+        iterator& operator-=(difference_type n) {
+            i_ -= n;
+            return *this;
+        }
+
+        friend iterator operator+(iterator it, difference_type n) {
+            return it += n;
+        }
+        friend iterator operator+(difference_type n, iterator it) {
+            return it += n;
+        }
+        friend iterator operator-(iterator it, difference_type n) {
+            return it -= n;
+        }
+        friend difference_type operator-(const iterator& lhs,
+                                         const iterator& rhs) {
+            return lhs.i_ - rhs.i_;
+        }
+
+        friend bool operator==(const iterator& lhs, const iterator& rhs) {
+            return lhs.i_ == rhs.i_;
+        }
+        friend bool operator!=(const iterator& lhs, const iterator& rhs) {
+            return lhs.i_ != rhs.i_;
+        }
+        friend bool operator<(const iterator& lhs, const iterator& rhs) {
+            return lhs.i_ < rhs.i_;
+        }
+        friend bool operator>(const iterator& lhs, const iterator& rhs) {
+            return lhs.i_ > rhs.i_;
+        }
+        friend bool operator<=(const iterator& lhs, const iterator& rhs) {
+            return lhs.i_ <= rhs.i_;
+        }
+        friend bool operator>=(const iterator& lhs, const iterator& rhs) {
+            return lhs.i_ >= rhs.i_;
+        }
+
+       private:
+        iterator(CompactLidarScan* ls, difference_type i) : ls_{ls}, i_{i} {}
+        CompactLidarScan* ls_;
+        difference_type i_;
+
+        friend struct CompactLidarScan;
+    };
+
+    iterator begin() { return iterator{this, 0}; }
+    iterator end() { return iterator{this, W * H}; }
+
+   private:
+    void alloc_xyz() {
+        x_ = Plane<float>::Zero(W * H);
+        y_ = Plane<float>::Zero(W * H);
+        z_ = Plane<float>::Zero(W * H);
+    }
+
+    Plane<uint32_t> range_;
+    Plane<uint16_t> intensity_;
+    Plane<uint16_t> reflectivity_;
+    Plane<uint16_t> noise_;
+    Plane<float> x_;
+    Plane<float> y_;
+    Plane<float> z_;
+};
 }
@@ -9,6 +9,7 @@
 #include <vector>
 
 #include "ouster/lidar_scan.h"
+#include "ouster/os1_util.h"
 
 namespace ouster {
 namespace viz {
@@ -26,12 +27,25 @@ struct VizHandle;
  */
 std::shared_ptr<VizHandle> init_viz(int W, int H);
 
+/**
+ * Initialize an instance of the visualizer that computes points from ranges.
+ * With the OpenGL2 backend of vtk 8 or later, the directions of the lookup
+ * table are uploaded once and points are projected and colored in shaders, so
+ * only ranges and intensities are uploaded per frame
+ * @param lut lookup table used to batch the scans passed to update()
+ * @return a handle to the state of the visualizer
+ */
+std::shared_ptr<VizHandle> init_viz(const OS1::xyz_lut& lut);
+
 /**
  * Update the lidar scan being displayed by the visualizer
  * @param vh a handle to a visualizer returned by init_viz()
- * @param lidar_scan the lidar scan to visualize on the next frame
+ * @param lidar_scan the lidar scan to visualize on the next frame; must hold
+ * xyz unless the visualizer was initialized with a lookup table. Swapped with
+ * the previous scan, which can be reused for the next frame
  */
-void update(viz::VizHandle& vh, std::unique_ptr<ouster::LidarScan>& lidar_scan);
+void update(viz::VizHandle& vh,
+            std::unique_ptr<ouster::CompactLidarScan>& lidar_scan);
 
 /**
  * Run visualizer render loop
@@ -0,0 +1,147 @@
+/**
+ * @file
+ * @brief Benchmarks of the per-frame work of the visualizer
+ *
+ * Times copying the points and computing the color keys of a scan for every
+ * color mode, and filling the range, intensity and noise images, on random
+ * scans of each lidar mode. Each iteration processes one complete scan, as
+ * the preparation stage of the visualizer does for every frame shown.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ouster/lidar_scan.h"
+#include "ouster/os1.h"
+#include "ouster/os1_util.h"
+#include "viz_color.h"
+
+namespace OS1 = ouster::OS1;
+namespace viz = ouster::viz;
+
+namespace {
+
+// a scan with random channels and its points, by mode
+struct fixture {
+    std::string name;
+    int W;
+    int H;
+    ouster::CompactLidarScan ls;
+    viz::Points xyz;
+    std::vector<int> px_offset;
+};
+
+// about a tenth of returns are missing, as in the benchmarks of ouster_client
+std::shared_ptr<const fixture> make_fixture(OS1::lidar_mode mode) {
+    const int W = OS1::n_cols_of_lidar_mode(mode);
+    const int H = OS1::pixels_per_column;
+    std::shared_ptr<fixture> fx{new fixture{OS1::to_string(mode), W, H,
+                                            ouster::CompactLidarScan(W, H),
+                                            viz::Points(W * H, 3),
+                                            OS1::get_px_offset(W)}};
+
+    std::mt19937 gen{1};
+    for (int i = 0; i < W * H; i++) {
+        fx->ls.range()(i) = gen() % 10 ? gen() % 120000 : 0;
+        fx->ls.intensity()(i) = gen() % 4096;
+        fx->ls.reflectivity()(i) = gen() % 4096;
+        fx->ls.noise()(i) = gen() % 1024;
+    }
+
+    const auto lut =
+        OS1::make_xyz_lut(W, H, OS1::beam_azimuth_angles,
+                          OS1::beam_altitude_angles,
+                          OS1::lidar_to_sensor_transform);
+    fx->ls.project(lut);
+    viz::lidar_scan_to_point_cloud(fx->ls.x().data(), fx->ls.y().data(),
+                                   fx->ls.z().data(), 0, W * H, fx->xyz);
+    return fx;
+}
+
+// defaults of the visualizer, coloring by the given mode
+viz::VisualizerConfig make_config(int color_mode) {
+    viz::VisualizerConfig cfg{};
+    cfg.color_mode = color_mode;
+    cfg.image_noise = true;
+    cfg.intensity_scale = 0.002;
+    cfg.range_scale = 0.005;
+    cfg.noise_scale = 1.0;
+    return cfg;
+}
+
+void set_points_rate(benchmark::State& state, const fixture& fx) {
+    state.counters["points/s"] = benchmark::Counter(
+        double(fx.W) * fx.H, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void bm_lidar_scan_to_point_cloud(benchmark::State& state,
+                                  const fixture& fx) {
+    viz::Points xyz(fx.W * fx.H, 3);
+    for (auto _ : state) {
+        viz::lidar_scan_to_point_cloud(fx.ls.x().data(), fx.ls.y().data(),
+                                       fx.ls.z().data(), 0, fx.W * fx.H, xyz);
+        benchmark::ClobberMemory();
+    }
+    set_points_rate(state, fx);
+}
+
+void bm_update_color_key(benchmark::State& state, const fixture& fx,
+                         int color_mode) {
+    const auto cfg = make_config(color_mode);
+    std::vector<float> key(fx.W * fx.H);
+    for (auto _ : state) {
+        viz::update_color_key(cfg, fx.xyz, fx.ls.intensity(), fx.ls.range(),
+                              key, 0, fx.W * fx.H);
+        benchmark::ClobberMemory();
+    }
+    set_points_rate(state, fx);
+}
+
+void bm_update_images(benchmark::State& state, const fixture& fx) {
+    const auto cfg = make_config(0);
+    viz::Image image = viz::Image::Zero(3 * fx.H, fx.W);
+    for (auto _ : state) {
+        viz::update_images(fx.ls, image, fx.px_offset, cfg, 0, fx.H);
+        benchmark::ClobberMemory();
+    }
+    set_points_rate(state, fx);
+}
+
+void register_benchmarks(std::shared_ptr<const fixture> fx) {
+    benchmark::RegisterBenchmark(
+        ("lidar_scan_to_point_cloud/" + fx->name).c_str(),
+        [fx](benchmark::State& state) {
+            bm_lidar_scan_to_point_cloud(state, *fx);
+        });
+    for (size_t m = 0; m < viz::color_modes.size(); m++)
+        benchmark::RegisterBenchmark(
+            ("update_color_key/" + viz::color_modes[m].first + "/" + fx->name)
+                .c_str(),
+            [fx, m](benchmark::State& state) {
+                bm_update_color_key(state, *fx, m);
+            });
+    benchmark::RegisterBenchmark(
+        ("update_images/" + fx->name).c_str(),
+        [fx](benchmark::State& state) { bm_update_images(state, *fx); });
+}
+}
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return EXIT_FAILURE;
+
+    const OS1::lidar_mode modes[] = {OS1::MODE_512x10, OS1::MODE_1024x10,
+                                     OS1::MODE_2048x10};
+    for (OS1::lidar_mode mode : modes) register_benchmarks(make_fixture(mode));
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return EXIT_SUCCESS;
+}
@@ -16,6 +16,7 @@
 
 #include "ouster/os1.h"
 #include "ouster/os1_packet.h"
+#include "ouster/os1_ring.h"
 #include "ouster/os1_util.h"
 #include "ouster/viz.h"
 
@@ -51,6 +52,51 @@ std::string read_metadata(const std::string& meta_file) {
     return buf.str();
 }
 
+/**
+ * Batch lidar packets from the receiver into scans and pass each completed
+ * scan to the visualizer until end_program is set
+ */
+template <int W>
+void batch_and_update(OS1::receiver& rcv, const OS1::xyz_lut& lut,
+                      viz::VizHandle& vh,
+                      std::unique_ptr<ouster::CompactLidarScan>& ls,
+                      const std::atomic_bool& end_program) {
+    auto it = ls->begin();
+
+    // called directly rather than through a std::function for every packet
+    auto batch = OS1::make_scan_batcher<W, OS1::pixels_per_column,
+                                        ouster::CompactLidarScan::iterator>(
+        lut, ouster::CompactLidarScan::Point{},
+        [](float x, float y, float z, uint16_t intensity, uint32_t t,
+           uint16_t reflectivity, uint8_t ring, uint16_t noise,
+           uint32_t range) {
+            return ouster::CompactLidarScan::make_val(
+                x, y, z, intensity, t, reflectivity, ring, noise, range);
+        },
+        [&](uint64_t) {
+            // swap lidar scan and point it to new buffer
+            viz::update(vh, ls);
+            it = ls->begin();
+        });
+
+    OS1::packet_ring& lidar = OS1::lidar_ring(rcv);
+    OS1::packet_ring& imu = OS1::imu_ring(rcv);
+
+    while (!end_program) {
+        // Wait for packets and add them to our lidar scan
+        OS1::client_state st = OS1::wait_receiver(rcv);
+        if (st & OS1::client_state::ERROR) {
+            std::cerr << "Client returned error state" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        while (const uint8_t* buf = lidar.front()) {
+            batch(buf, it);
+            lidar.pop();
+        }
+        while (imu.front()) imu.pop();
+    }
+}
+
 int main(int argc, char** argv) {
     int W = 1024;
     int H = OS1::pixels_per_column;
@@ -117,51 +163,39 @@ int main(int argc, char** argv) {
         std::exit(EXIT_FAILURE);
     }
 
-    uint8_t lidar_buf[OS1::lidar_packet_bytes + 1];
-    uint8_t imu_buf[OS1::imu_packet_bytes + 1];
-
-    auto ls = std::unique_ptr<ouster::LidarScan>(new ouster::LidarScan(W, H));
-
-    auto vh = viz::init_viz(W, H);
-
     if (do_config) metadata = OS1::get_metadata(*cli);
 
     auto info = OS1::parse_metadata(metadata);
 
-    auto xyz_lut = OS1::make_xyz_lut(W, H, info.beam_azimuth_angles,
-                                     info.beam_altitude_angles);
+    auto lut = OS1::make_xyz_lut(W, H, info.beam_azimuth_angles,
+                                 info.beam_altitude_angles, {});
+
+    // the visualizer computes points from ranges, so scans hold no xyz
+    auto ls = std::unique_ptr<ouster::CompactLidarScan>(
+        new ouster::CompactLidarScan(W, H));
+
+    auto vh = viz::init_viz(lut);
 
     // Use to signal termination
     std::atomic_bool end_program{false};
 
-    // auto it = std::back_inserter(*ls);
-    auto it = ls->begin();
-
-    // callback that calls update with filled lidar scan
-    auto batch_and_update = OS1::batch_to_iter<ouster::LidarScan::iterator>(
-        xyz_lut, W, H, ouster::LidarScan::Point::Zero(),
-        &ouster::LidarScan::make_val, [&](uint64_t) {
-            // swap lidar scan and point it to new buffer
-            viz::update(*vh, ls);
-            it = ls->begin();
-        });
+    // Receive on a dedicated thread so that stalls in parsing or rendering
+    // never delay reading from the sockets
+    auto rcv = OS1::start_receiver(cli);
+    if (!rcv) {
+        std::cerr << "Failed to start packet receiver" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
 
-    // Start poll thread
+    // Start parsing thread, with the batcher specialized for the scan width
     std::thread poll([&] {
-        while (!end_program) {
-            // Poll the client for data and add to our lidar scan
-            OS1::client_state st = OS1::poll_client(*cli);
-            if (st & OS1::client_state::ERROR) {
-                std::cerr << "Client returned error state" << std::endl;
-                std::exit(EXIT_FAILURE);
-            }
-            if (st & OS1::client_state::LIDAR_DATA) {
-                if (OS1::read_lidar_packet(*cli, lidar_buf))
-                    batch_and_update(lidar_buf, it);
-            }
-            if (st & OS1::client_state::IMU_DATA) {
-                OS1::read_imu_packet(*cli, imu_buf);
-            }
+        switch (W) {
+            case 512:
+                return batch_and_update<512>(*rcv, lut, *vh, ls, end_program);
+            case 1024:
+                return batch_and_update<1024>(*rcv, lut, *vh, ls, end_program);
+            default:
+                return batch_and_update<2048>(*rcv, lut, *vh, ls, end_program);
         }
     });
 
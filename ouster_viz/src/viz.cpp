@@ -1,18 +1,21 @@
 #include <Eigen/Eigen>
 #include <atomic>
 #include <cassert>
+#include <algorithm>
 #include <cmath>
+#include <condition_variable>
 #include <deque>
 #include <functional>
 #include <iostream>
 #include <mutex>
+#include <thread>
 #include <vector>
 
 #include <vtkActor.h>
 #include <vtkCallbackCommand.h>
 #include <vtkCamera.h>
 #include <vtkCellArray.h>
-#include <vtkDoubleArray.h>
+#include <vtkFloatArray.h>
 #include <vtkImageActor.h>
 #include <vtkImageChangeInformation.h>
 #include <vtkImageData.h>
@@ -25,6 +28,11 @@
 #include <vtkMath.h>
 #include <vtkMatrix4x4.h>
 #include <vtkObjectFactory.h>
+#ifdef OUSTER_VIZ_SHADERS
+#include <vtkOpenGLPolyDataMapper.h>
+#include <vtkShader.h>
+#include <vtkShaderProgram.h>
+#endif
 #include <vtkPointData.h>
 #include <vtkPointSource.h>
 #include <vtkPoints.h>
@@ -36,18 +44,16 @@
 #include <vtkRenderer.h>
 #include <vtkSmartPointer.h>
 #include <vtkTransform.h>
-#include <vtkVertexGlyphFilter.h>
 
 #include "colormaps.h"
 #include "ouster/lidar_scan.h"
 #include "ouster/os1_util.h"
 #include "ouster/viz.h"
+#include "viz_color.h"
 
 namespace ouster {
 namespace viz {
 
-using Points = Eigen::Array<double, Eigen::Dynamic, 3, Eigen::RowMajor>;
-
 /**
  * Helper function to create vtk lookup tables for the specific color palettes
  **/
@@ -67,41 +73,18 @@ const std::vector<std::pair<std::string, vtkSmartPointer<vtkLookupTable>>>
         {"Magma", palette_gen(magma)},   {"Rainbow", palette_gen(rainbow)},
         {"Autumn", palette_gen(autumn)}, {"Grey", palette_gen(grey)}};
 
-/**
- * Specify what quantity to color in the point cloud visualization
- **/
-enum ColorMode { COLOR_Z, COLOR_INTENSITY, COLOR_ZINTENSITY, COLOR_RANGE };
-
-const std::vector<std::pair<std::string, ColorMode>> color_modes = {
-    {"Z", COLOR_Z},
-    {"INTENSITY", COLOR_INTENSITY},
-    {"Z+INTENSITY", COLOR_ZINTENSITY},
-    {"RANGE", COLOR_RANGE}};
-
-/**
- * Visualizer options set through user controls
- **/
-struct VisualizerConfig {
-    int c_palette;     // cloud color palette
-    int point_size;    // cloud point size
-    int color_mode;    // cloud coloring mode
-    bool cycle_range;  // cycle range palette
-    bool parallel;     // use parallel projection
-
-    int palette;       // image color palette
-    bool image_noise;  // display noise image
-    double intensity_scale;
-    double range_scale;
-    double noise_scale;
-
-    int fraction_3d;  // percent of window displaying cloud
-};
+#ifdef OUSTER_VIZ_SHADERS
+// colors of the palettes above, in the same order, for shaders
+const std::vector<const float (*)[3]> palette_colors = {
+    parula, viridis, magma, rainbow, autumn, grey};
+#endif
 
 struct LidarScanBuffer {
     std::mutex ls_mtx;
-    bool ls_dirty = true;  // false if the 'back' scan is new
-    std::unique_ptr<ouster::LidarScan> back;
-    std::unique_ptr<ouster::LidarScan> front;
+    std::condition_variable ls_cv;  // notified when the 'back' scan is new
+    bool ls_dirty = true;           // false if the 'back' scan is new
+    std::unique_ptr<ouster::CompactLidarScan> back;
+    std::unique_ptr<ouster::CompactLidarScan> front;
 };
 
 /**
@@ -112,135 +95,25 @@ struct VizHandle {
     LidarScanBuffer lsb;
     int W;
     int H;
+    OS1::xyz_lut lut;  // empty unless points are computed from ranges
     std::atomic_bool exit;
 };
 
 /**
  * Update data being displayed
  **/
-void update(viz::VizHandle& vh, std::unique_ptr<ouster::LidarScan>& ls) {
+void update(viz::VizHandle& vh,
+            std::unique_ptr<ouster::CompactLidarScan>& ls) {
     assert(ls->W * ls->H == vh.W * vh.H);
+    assert(ls->has_xyz() || !vh.lut.x.empty());
 
     std::unique_lock<std::mutex> ls_guard(vh.lsb.ls_mtx);
     ls.swap(vh.lsb.back);
     vh.lsb.ls_dirty = false;
     ls_guard.unlock();
+    vh.lsb.ls_cv.notify_one();
 }
 
-/**
- * Applies filter for scaling the intensity scaling factor based on their
- * intensity
- **/
-void color_intensity(Eigen::Ref<Eigen::ArrayXd> key_eigen,
-                     const VisualizerConfig& config) {
-    key_eigen *= config.intensity_scale;
-    key_eigen = key_eigen.max(0.0).sqrt();
-}
-
-/**
- * Applies filter for scaling the intensity scaling factor based on their range
- **/
-void color_range(Eigen::Ref<Eigen::ArrayXd> range,
-                 const VisualizerConfig& config) {
-    range *= config.range_scale;
-    if (config.cycle_range) {
-        // range = 0.005 * range + 0.5 * (1.0 - (0.015 * M_PI * range).cos());
-        range = 0.5 * (1.0 - (0.018 * M_PI * range).cos());
-    } else {
-        range = (range * 0.02).min(1.0).max(0.0);
-    }
-}
-
-void color_noise(Eigen::Ref<Eigen::ArrayXd> key_eigen,
-                 const VisualizerConfig& config) {
-    double noise_scale = config.image_noise ? config.noise_scale : 0.0;
-    key_eigen *= noise_scale * 0.002;
-    key_eigen = key_eigen.max(0.0).sqrt();
-}
-
-/**
- * Generates a point cloud from a lidar scan, by multiplying each pixel in the
- * lidar scan by a vector pointing radially outward
- **/
-void lidar_scan_to_point_cloud(ouster::LidarScan& ls, Points& xyz) {
-    assert(xyz.rows() == ls.W * ls.H);
-    assert(xyz.cols() == 3);
-
-    xyz.col(0) = ls.x();
-    xyz.col(1) = ls.y();
-    xyz.col(2) = ls.z();
-}
-
-/**
- * Update scalars used to color points
- **/
-void update_color_key(const VisualizerConfig& config, const Points& xyz,
-                      Eigen::Ref<Eigen::ArrayXd> intensity,
-                      Eigen::Ref<Eigen::ArrayXd> range,
-                      std::vector<double>& color_key) {
-    const int n = xyz.rows();
-    assert(intensity.size() == n);
-    assert(range.size() == n);
-    assert(color_key.size() == (size_t)n);
-
-    Eigen::Map<Eigen::ArrayXd> key_eigen(color_key.data(), n);
-
-    switch (color_modes[config.color_mode].second) {
-        case COLOR_Z:
-            key_eigen = ((1.5 + xyz.col(2)) * 0.1).abs().sqrt();
-            break;
-        case COLOR_INTENSITY:
-            key_eigen = Eigen::Map<const Eigen::ArrayXd>(intensity.data(), n);
-            color_intensity(key_eigen, config);
-            break;
-        case COLOR_ZINTENSITY:
-            key_eigen = Eigen::Map<const Eigen::ArrayXd>(intensity.data(), n);
-            color_intensity(key_eigen, config);
-            key_eigen += ((1.5 + xyz.col(2)) * 0.05).abs().sqrt();
-            break;
-        case COLOR_RANGE:
-            key_eigen = Eigen::Map<const Eigen::ArrayXd>(range.data(), n);
-            color_range(key_eigen, config);
-            break;
-        default:
-            cerr << "Invalid render mode" << endl;
-    }
-}
-
-/**
- * Inserts lidar scan into frame so that it can be rendered
- **/
-void update_images(
-    ouster::LidarScan& ls,
-    Eigen::Array<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>& arr,
-    const std::vector<int>& px_offset, const VisualizerConfig& config) {
-    using MapXXd = Eigen::Map<Eigen::ArrayXXd>;
-    using MapXXdr = Eigen::Map<
-        Eigen::Array<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>;
-
-    MapXXd r{ls.range().data(), ls.H, ls.W};
-    MapXXd i{ls.intensity().data(), ls.H, ls.W};
-    MapXXd n{ls.noise().data(), ls.H, ls.W};
-
-    MapXXdr dst{arr.data(), 3 * ls.H, ls.W};
-
-    // de-stagger and covert to row-major
-    for (int u = 0; u < ls.H; u++) {
-        const int ofs = px_offset[u];
-        dst.row(1 * ls.H - u - 1) << r.row(u).tail(ls.W - ofs),
-            r.row(u).head(ofs);
-        dst.row(2 * ls.H - u - 1) << i.row(u).tail(ls.W - ofs),
-            i.row(u).head(ofs);
-        dst.row(3 * ls.H - u - 1) << n.row(u).tail(ls.W - ofs),
-            n.row(u).head(ofs);
-    }
-
-    const int N = ls.W * ls.H;
-    color_range(Eigen::Map<Eigen::ArrayXd>{arr.data(), N}, config);
-    color_intensity(Eigen::Map<Eigen::ArrayXd>{arr.data() + N, N}, config);
-    color_noise(Eigen::Map<Eigen::ArrayXd>{arr.data() + 2 * N, N}, config);
-};
-
 class KeyPressInteractorStyle : public vtkInteractorStyleTrackballCamera {
    public:
     static KeyPressInteractorStyle* New();
@@ -318,20 +191,32 @@ class KeyPressInteractorStyle : public vtkInteractorStyleTrackballCamera {
 };
 vtkStandardNewMacro(KeyPressInteractorStyle);
 
-vtkSmartPointer<vtkActor> init_cloud_actor(
-    vtkSmartPointer<vtkPoints>& points,
-    vtkSmartPointer<vtkDoubleArray>& color) {
+/**
+ * Make a cloud with a vertex for each point, so that no vtkVertexGlyphFilter
+ * pass has to run again whenever the points change
+ **/
+vtkSmartPointer<vtkPolyData> init_cloud(vtkSmartPointer<vtkPoints>& points) {
+    auto verts = vtkSmartPointer<vtkCellArray>::New();
+    for (vtkIdType i = 0; i < points->GetNumberOfPoints(); i++) {
+        verts->InsertNextCell(1);
+        verts->InsertCellPoint(i);
+    }
+
     auto vtk_cloud = vtkSmartPointer<vtkPolyData>::New();
     vtk_cloud->SetPoints(points);
+    vtk_cloud->SetVerts(verts);
+    return vtk_cloud;
+}
+
+vtkSmartPointer<vtkActor> init_cloud_actor(
+    vtkSmartPointer<vtkPoints>& points,
+    vtkSmartPointer<vtkFloatArray>& color) {
+    auto vtk_cloud = init_cloud(points);
     vtk_cloud->GetPointData()->SetScalars(color);
     vtk_cloud->GetPointData()->SetActiveScalars("DepthArray");
 
-    auto vfilter = vtkSmartPointer<vtkVertexGlyphFilter>::New();
-    vfilter->AddInputData(vtk_cloud);
-    vfilter->Update();
-
     auto mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
-    mapper->SetInputConnection(vfilter->GetOutputPort());
+    mapper->SetInputData(vtk_cloud);
     mapper->SetColorModeToDefault();
     mapper->SetScalarRange(0.0, 1.0);
 
@@ -341,6 +226,111 @@ vtkSmartPointer<vtkActor> init_cloud_actor(
     return actor;
 }
 
+#ifdef OUSTER_VIZ_SHADERS
+/**
+ * The vertices of a cloud rendered with shaders are the directions of the
+ * lookup table scaled to returns at 120 m, so that the bounds used for camera
+ * resets and clipping ranges match a full scan
+ **/
+const float lut_scale = 120000.0f;
+
+static_assert(palette_n == 256, "palette size is fixed in the shaders");
+
+/**
+ * Vertex shader code computing the position of each point from its range
+ * and vertex, and the value used to color it as update_color_key does. Each
+ * snippet starts with the tag it replaces, so the mapper still expands its
+ * own code there and the snippet only adds to or overrides it
+ **/
+const char* cloud_vs_dec = R"glsl(//VTK::Normal::Dec
+in float point_range;
+in float point_intensity;
+uniform float range_to_vertex;
+uniform vec3 lut_offset;
+uniform int color_mode;
+uniform int cycle_range;
+uniform float intensity_scale;
+uniform float range_scale;
+out float color_key;
+)glsl";
+
+const char* cloud_vs_impl = R"glsl(//VTK::PositionVC::Impl
+  vec3 xyz = vertexMC.xyz * (point_range * range_to_vertex);
+  if (point_range > 0.0) xyz += lut_offset;
+
+  if (color_mode == 0) {  // COLOR_Z
+    color_key = sqrt(abs((1.5 + xyz.z) * 0.1));
+  } else if (color_mode == 3) {  // COLOR_RANGE
+    float r = point_range * range_scale;
+    color_key = cycle_range != 0 ? 0.5 * (1.0 - cos(0.018 * 3.14159265 * r))
+                                 : clamp(r * 0.02, 0.0, 1.0);
+  } else {  // COLOR_INTENSITY or COLOR_ZINTENSITY
+    color_key = sqrt(max(point_intensity * intensity_scale, 0.0));
+    if (color_mode == 2) color_key += sqrt(abs((1.5 + xyz.z) * 0.05));
+  }
+
+  gl_Position = MCDCMatrix * vec4(xyz, 1.0);
+)glsl";
+
+/**
+ * Fragment shader code looking up the color of each point in the palette,
+ * overriding the colors and opacity computed from the uniforms of the mapper
+ **/
+const char* cloud_fs_dec = R"glsl(//VTK::Color::Dec
+in float color_key;
+uniform vec3 palette[256];
+)glsl";
+
+const char* cloud_fs_impl = R"glsl(//VTK::Color::Impl
+  ambientColor = vec3(0.0);
+  diffuseColor = palette[min(int(clamp(color_key, 0.0, 1.0) * 256.0), 255)];
+  opacity = 1.0;
+)glsl";
+
+/**
+ * Make an actor computing point positions and colors in shaders from the
+ * lookup table directions in the vertices, which are only uploaded once, and
+ * the range and intensity arrays, which are the only data uploaded per frame
+ * @param set_uniforms observer of vtkCommand::UpdateShaderEvent setting the
+ * uniforms of the shaders
+ **/
+vtkSmartPointer<vtkActor> init_shader_cloud_actor(
+    vtkSmartPointer<vtkPoints>& points, vtkSmartPointer<vtkFloatArray>& range,
+    vtkSmartPointer<vtkFloatArray>& intensity, vtkCommand* set_uniforms) {
+    auto vtk_cloud = init_cloud(points);
+    vtk_cloud->GetPointData()->AddArray(range);
+    vtk_cloud->GetPointData()->AddArray(intensity);
+
+    auto mapper = vtkSmartPointer<vtkOpenGLPolyDataMapper>::New();
+    mapper->SetInputData(vtk_cloud);
+    mapper->ScalarVisibilityOff();
+    mapper->MapDataArrayToVertexAttribute(
+        "point_range", range->GetName(),
+        vtkDataObject::FIELD_ASSOCIATION_POINTS, -1);
+    mapper->MapDataArrayToVertexAttribute(
+        "point_intensity", intensity->GetName(),
+        vtkDataObject::FIELD_ASSOCIATION_POINTS, -1);
+
+    // add to the default declarations, position and color code, which still
+    // declares and uses the uniforms the mapper sets
+    mapper->AddShaderReplacement(vtkShader::Vertex, "//VTK::Normal::Dec", true,
+                                 cloud_vs_dec, false);
+    mapper->AddShaderReplacement(vtkShader::Vertex, "//VTK::PositionVC::Impl",
+                                 true, cloud_vs_impl, false);
+    mapper->AddShaderReplacement(vtkShader::Fragment, "//VTK::Color::Dec",
+                                 true, cloud_fs_dec, false);
+    mapper->AddShaderReplacement(vtkShader::Fragment, "//VTK::Color::Impl",
+                                 true, cloud_fs_impl, false);
+    mapper->AddObserver(vtkCommand::UpdateShaderEvent, set_uniforms);
+
+    auto actor = vtkSmartPointer<vtkActor>::New();
+    actor->SetMapper(mapper);
+    actor->GetProperty()->LightingOff();
+
+    return actor;
+}
+#endif
+
 void fill_viewport(vtkSmartPointer<vtkRenderer> renderer,
                    vtkSmartPointer<vtkImageData> image) {
     auto camera = renderer->GetActiveCamera();
@@ -362,36 +352,267 @@ void fill_viewport(vtkSmartPointer<vtkRenderer> renderer,
     camera->SetViewUp(0, 1, 0);
 }
 
+/**
+ * Threads running a job split into slices, with the thread calling run()
+ * working on the first slice
+ **/
+class SliceWorkers {
+   public:
+    /**
+     * @param n number of slices, each run on its own thread
+     * @param job function called with the index of a slice and n
+     */
+    SliceWorkers(int n, std::function<void(int, int)> job)
+        : n_{n}, job_{std::move(job)} {
+        for (int k = 1; k < n_; k++) threads_.emplace_back([=] { work(k); });
+    }
+
+    ~SliceWorkers() {
+        {
+            std::lock_guard<std::mutex> lock{mtx_};
+            exit_ = true;
+        }
+        start_cv_.notify_all();
+        for (auto& t : threads_) t.join();
+    }
+
+    /**
+     * Run every slice of the job, returning when all are done
+     */
+    void run() {
+        {
+            std::lock_guard<std::mutex> lock{mtx_};
+            gen_++;
+            pending_ = n_ - 1;
+        }
+        start_cv_.notify_all();
+        job_(0, n_);
+
+        std::unique_lock<std::mutex> lock{mtx_};
+        done_cv_.wait(lock, [this] { return pending_ == 0; });
+    }
+
+   private:
+    void work(int k) {
+        uint64_t gen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock{mtx_};
+                start_cv_.wait(lock, [&] { return exit_ || gen_ != gen; });
+                if (exit_) return;
+                gen = gen_;
+            }
+            job_(k, n_);
+            {
+                std::lock_guard<std::mutex> lock{mtx_};
+                if (--pending_ == 0) done_cv_.notify_one();
+            }
+        }
+    }
+
+    const int n_;
+    const std::function<void(int, int)> job_;
+    std::mutex mtx_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    uint64_t gen_{0};
+    int pending_{0};
+    bool exit_{false};
+    std::vector<std::thread> threads_;
+};
+
+/**
+ * Data backing the visualization of one frame. Positions and color keys are
+ * computed on the cpu without shaders; ranges and intensities are uploaded
+ * instead with shaders
+ **/
+struct FrameBuffers {
+    FrameBuffers(int W, int H, bool shaders)
+        : image_data{Image::Zero(3 * H, W)},
+          pc_render{Points::Zero(shaders ? 0 : W * H, 3)},
+          color_key(shaders ? 0 : W * H, 0.0f),
+          range_key(shaders ? W * H : 0, 0.0f),
+          intensity_key(shaders ? W * H : 0, 0.0f) {}
+
+    Image image_data;
+    Points pc_render;
+    std::vector<float> color_key;
+    std::vector<float> range_key;
+    std::vector<float> intensity_key;
+};
+
+/**
+ * Frames passed from the preparation stage to the render callback. Pointers
+ * are swapped under the lock of the LidarScanBuffer, like its scans
+ **/
+struct FrameBufferSet {
+    FrameBufferSet(int W, int H, bool shaders)
+        : bufs{{W, H, shaders}, {W, H, shaders}, {W, H, shaders}},
+          shown{&bufs[0]},
+          ready{&bufs[1]},
+          prep{&bufs[2]} {}
+
+    FrameBuffers bufs[3];
+    FrameBuffers* shown;  // backing the vtk arrays, only used by the renderer
+    FrameBuffers* ready;  // last prepared frame
+    FrameBuffers* prep;   // only used by the preparation stage
+    bool ready_dirty = true;  // false if the 'ready' frame is new
+    bool exit = false;        // stops the preparation stage
+    VisualizerConfig config;  // config used by the preparation stage
+};
+
+/**
+ * Number of threads preparing frames. The render and receive threads need
+ * cores of their own, and the work doesn't split usefully much further
+ **/
+int n_prep_threads() {
+    const int n = std::thread::hardware_concurrency();
+    return std::max(1, std::min(4, n - 2));
+}
+
 /**
  * Run visualizer rendering loop
  **/
 void run_viz(VizHandle& vh) {
     const size_t n_points = vh.W * vh.H;
 
-    Eigen::Array<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-        image_data{3 * vh.H, vh.W};
+#ifdef OUSTER_VIZ_SHADERS
+    const bool shaders = !vh.lut.x.empty();
+#else
+    const bool shaders = false;
+#endif
 
-    Points pc_render{n_points, 3};
-    std::vector<double> color_key(n_points, 0.0);
+    // filled by the preparation stage while the previous frame is rendered
+    FrameBufferSet frames{vh.W, vh.H, shaders};
+    frames.config = vh.config;
 
     std::vector<int> px_offset = OS1::get_px_offset(vh.W);
 
     auto points = vtkSmartPointer<vtkPoints>::New();
-    points->SetDataTypeToDouble();
-    vtkDoubleArray::SafeDownCast(points->GetData())
-        ->SetArray(pc_render.data(), n_points * 3, 1);
+    points->SetDataTypeToFloat();
 
-    auto color = vtkSmartPointer<vtkDoubleArray>::New();
+    auto color = vtkSmartPointer<vtkFloatArray>::New();
     color->SetName("DepthArray");
-    color->SetArray(color_key.data(), n_points, 1);
 
-    auto cloud_actor = init_cloud_actor(points, color);
+#ifdef OUSTER_VIZ_SHADERS
+    // with shaders, the points hold the directions of the lookup table and
+    // only ranges and intensities change
+    Points lut_points{shaders ? n_points : 0, 3};
+
+    auto range = vtkSmartPointer<vtkFloatArray>::New();
+    range->SetName("RangeArray");
+    auto intensity = vtkSmartPointer<vtkFloatArray>::New();
+    intensity->SetName("IntensityArray");
+
+    std::function<void(vtkShaderProgram*)> set_uniforms =
+        [&](vtkShaderProgram* program) {
+            const VisualizerConfig& cfg = vh.config;
+            program->SetUniformf("range_to_vertex", 1.0f / lut_scale);
+            program->SetUniform3f("lut_offset", vh.lut.offset.data());
+            program->SetUniformi("color_mode",
+                                 color_modes[cfg.color_mode].second);
+            program->SetUniformi("cycle_range", cfg.cycle_range);
+            program->SetUniformf("intensity_scale", cfg.intensity_scale);
+            program->SetUniformf("range_scale", cfg.range_scale);
+            program->SetUniform3fv("palette", palette_n,
+                                   palette_colors[cfg.c_palette]);
+        };
+    auto shader_cb = vtkSmartPointer<vtkCallbackCommand>::New();
+    shader_cb->SetCallback(
+        [](vtkObject*, long unsigned int, void* clientData, void* callData) {
+            (*static_cast<std::function<void(vtkShaderProgram*)>*>(
+                clientData))(static_cast<vtkShaderProgram*>(callData));
+        });
+    shader_cb->SetClientData(&set_uniforms);
+
+    if (shaders) {
+        lut_points.col(0) = Eigen::Map<const Eigen::ArrayXf>(
+                                vh.lut.x.data(), n_points) * lut_scale;
+        lut_points.col(1) = Eigen::Map<const Eigen::ArrayXf>(
+                                vh.lut.y.data(), n_points) * lut_scale;
+        lut_points.col(2) = Eigen::Map<const Eigen::ArrayXf>(
+                                vh.lut.z.data(), n_points) * lut_scale;
+        vtkFloatArray::SafeDownCast(points->GetData())
+            ->SetArray(lut_points.data(), n_points * 3, 1);
+    }
+#endif
 
     auto image = vtkSmartPointer<vtkImageData>::New();
     image->SetDimensions(vh.W, 3 * vh.H, 1);
-    image->AllocateScalars(VTK_DOUBLE, 1);
-    vtkDoubleArray::SafeDownCast(image->GetPointData()->GetScalars())
-        ->SetArray(image_data.data(), 3 * n_points, 1);
+    image->AllocateScalars(VTK_FLOAT, 1);
+
+    // point the vtk arrays at the buffers of a frame without copying
+    auto show_frame = [&](FrameBuffers& f) {
+        vtkFloatArray::SafeDownCast(image->GetPointData()->GetScalars())
+            ->SetArray(f.image_data.data(), 3 * n_points, 1);
+        image->Modified();
+#ifdef OUSTER_VIZ_SHADERS
+        if (shaders) {
+            range->SetArray(f.range_key.data(), n_points, 1);
+            intensity->SetArray(f.intensity_key.data(), n_points, 1);
+            range->Modified();
+            intensity->Modified();
+            return;
+        }
+#endif
+        vtkFloatArray::SafeDownCast(points->GetData())
+            ->SetArray(f.pc_render.data(), n_points * 3, 1);
+        color->SetArray(f.color_key.data(), n_points, 1);
+        points->Modified();
+        color->Modified();
+    };
+    show_frame(*frames.shown);
+
+#ifdef OUSTER_VIZ_SHADERS
+    auto cloud_actor =
+        shaders ? init_shader_cloud_actor(points, range, intensity, shader_cb)
+                : init_cloud_actor(points, color);
+#else
+    auto cloud_actor = init_cloud_actor(points, color);
+#endif
+
+    // coordinates of scans without xyz, projected by the preparation stage
+    const size_t n_projected = shaders || vh.lut.x.empty() ? 0 : n_points;
+    std::vector<float> x(n_projected);
+    std::vector<float> y(n_projected);
+    std::vector<float> z(n_projected);
+
+    // fill one slice of rows of the images and of columns of the points of
+    // the frame being prepared
+    VisualizerConfig prep_config;
+    auto prepare = [&](int k, int n) {
+        const CompactLidarScan& ls = *vh.lsb.front;
+        FrameBuffers& f = *frames.prep;
+        const VisualizerConfig& cfg = prep_config;
+
+        const int u0 = vh.H * k / n, u1 = vh.H * (k + 1) / n;
+        update_images(ls, f.image_data, px_offset, cfg, u0, u1 - u0);
+
+        const int j0 = vh.W * k / n, j1 = vh.W * (k + 1) / n;
+        const int first = vh.H * j0, count = vh.H * (j1 - j0);
+        if (shaders) {
+            Eigen::Map<Eigen::ArrayXf>(f.range_key.data() + first, count) =
+                ls.range().segment(first, count).cast<float>();
+            Eigen::Map<Eigen::ArrayXf>(f.intensity_key.data() + first,
+                                       count) =
+                ls.intensity().segment(first, count).cast<float>();
+            return;
+        }
+
+        if (ls.has_xyz()) {
+            lidar_scan_to_point_cloud(ls.x().data(), ls.y().data(),
+                                      ls.z().data(), first, count,
+                                      f.pc_render);
+        } else {
+            OS1::project_xyz(vh.lut, ls.range().data(), j0, j1 - j0, 0, vh.H,
+                             x.data() + first, y.data() + first,
+                             z.data() + first);
+            lidar_scan_to_point_cloud(x.data(), y.data(), z.data(), first,
+                                      count, f.pc_render);
+        }
+        update_color_key(cfg, f.pc_render, ls.intensity(), ls.range(),
+                         f.color_key, first, count);
+    };
 
     auto image_color = vtkSmartPointer<vtkImageMapToColors>::New();
     image_color->SetLookupTable(palettes[vh.config.palette].second);
@@ -440,25 +661,16 @@ void run_viz(VizHandle& vh) {
         // check if we're exiting
         if (vh.exit) render_window_interactor->ExitCallback();
 
-        // swap in new frame
+        // swap in the last prepared frame
         {
             std::unique_lock<std::mutex> ls_guard(vh.lsb.ls_mtx);
             // already rendered this data
-            if (vh.lsb.ls_dirty) return;
-            vh.lsb.front.swap(vh.lsb.back);
-            vh.lsb.ls_dirty = true;
+            if (frames.ready_dirty) return;
+            std::swap(frames.shown, frames.ready);
+            frames.ready_dirty = true;
         }
 
-        // update data backing visualization: pc_render, color_key, image_data
-        lidar_scan_to_point_cloud(*vh.lsb.front, pc_render);
-        update_color_key(vh.config, pc_render, vh.lsb.front->intensity(),
-                         vh.lsb.front->range(), color_key);
-        update_images(*vh.lsb.front, image_data, px_offset, vh.config);
-
-        points->Modified();
-        color->Modified();
-        image->Modified();
-
+        show_frame(*frames.shown);
         render_window->Render();
     };
 
@@ -472,6 +684,10 @@ void run_viz(VizHandle& vh) {
     style->renderer = renderer;
     style->SetCurrentRenderer(renderer);
     style->config_updated = [&]() {
+        {
+            std::lock_guard<std::mutex> ls_guard(vh.lsb.ls_mtx);
+            frames.config = vh.config;
+        }
         image_color->SetLookupTable(palettes[vh.config.palette].second);
 
         cloud_actor->GetProperty()->SetPointSize(vh.config.point_size);
@@ -501,7 +717,38 @@ void run_viz(VizHandle& vh) {
 
     style->config_updated();
 
+    // preparation stage: swap in each new scan and fill the next frame in
+    // parallel while the render callback shows the previous one
+    std::thread prep_thread{[&] {
+        SliceWorkers workers{n_prep_threads(), prepare};
+        while (true) {
+            {
+                std::unique_lock<std::mutex> ls_guard(vh.lsb.ls_mtx);
+                vh.lsb.ls_cv.wait(ls_guard, [&] {
+                    return !vh.lsb.ls_dirty || frames.exit;
+                });
+                if (frames.exit) return;
+                vh.lsb.front.swap(vh.lsb.back);
+                vh.lsb.ls_dirty = true;
+                prep_config = frames.config;
+            }
+
+            workers.run();
+
+            std::lock_guard<std::mutex> ls_guard(vh.lsb.ls_mtx);
+            std::swap(frames.prep, frames.ready);
+            frames.ready_dirty = false;
+        }
+    }};
+
     render_window_interactor->Start();
+
+    {
+        std::lock_guard<std::mutex> ls_guard(vh.lsb.ls_mtx);
+        frames.exit = true;
+    }
+    vh.lsb.ls_cv.notify_all();
+    prep_thread.join();
 }
 
 /**
@@ -533,13 +780,23 @@ std::shared_ptr<VizHandle> init_viz(int W, int H) {
     vh->config.range_scale = 0.005;
     vh->config.noise_scale = 1.0;
 
-    vh->lsb.back =
-        std::unique_ptr<ouster::LidarScan>(new ouster::LidarScan(W, H));
+    vh->lsb.back = std::unique_ptr<ouster::CompactLidarScan>(
+        new ouster::CompactLidarScan(W, H, true));
 
-    vh->lsb.front =
-        std::unique_ptr<ouster::LidarScan>(new ouster::LidarScan(W, H));
+    vh->lsb.front = std::unique_ptr<ouster::CompactLidarScan>(
+        new ouster::CompactLidarScan(W, H, true));
 
     return vh;
 }
+/**
+ * Initializes the visualizer to compute points from ranges
+ **/
+std::shared_ptr<VizHandle> init_viz(const OS1::xyz_lut& lut) {
+    auto vh = init_viz(lut.W, lut.H);
+    vh->lut = lut;
+    vh->lsb.back.reset(new ouster::CompactLidarScan(lut.W, lut.H));
+    vh->lsb.front.reset(new ouster::CompactLidarScan(lut.W, lut.H));
+    return vh;
+}
 }
 }
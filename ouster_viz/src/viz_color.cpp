@@ -0,0 +1,130 @@
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ouster/os1_util.h"
+#include "viz_color.h"
+
+namespace ouster {
+namespace viz {
+
+const std::vector<std::pair<std::string, ColorMode>> color_modes = {
+    {"Z", COLOR_Z},
+    {"INTENSITY", COLOR_INTENSITY},
+    {"Z+INTENSITY", COLOR_ZINTENSITY},
+    {"RANGE", COLOR_RANGE}};
+
+namespace {
+
+/**
+ * Applies filter for scaling the intensity scaling factor based on their
+ * intensity
+ **/
+void color_intensity(Eigen::Ref<Eigen::ArrayXf> key_eigen,
+                     const VisualizerConfig& config) {
+    key_eigen *= config.intensity_scale;
+    key_eigen = key_eigen.max(0.0f).sqrt();
+}
+
+/**
+ * Applies filter for scaling the intensity scaling factor based on their range
+ **/
+void color_range(Eigen::Ref<Eigen::ArrayXf> range,
+                 const VisualizerConfig& config) {
+    range *= config.range_scale;
+    if (config.cycle_range) {
+        // range = 0.005 * range + 0.5 * (1.0 - (0.015 * M_PI * range).cos());
+        range = 0.5f * (1.0f - (float(0.018 * M_PI) * range).cos());
+    } else {
+        range = (range * 0.02f).min(1.0f).max(0.0f);
+    }
+}
+
+void color_noise(Eigen::Ref<Eigen::ArrayXf> key_eigen,
+                 const VisualizerConfig& config) {
+    double noise_scale = config.image_noise ? config.noise_scale : 0.0;
+    key_eigen *= noise_scale * 0.002;
+    key_eigen = key_eigen.max(0.0f).sqrt();
+}
+
+/**
+ * De-staggers row u of a channel of a lidar scan into a row of pixels, widening
+ * to the vtk image type
+ **/
+template <typename T>
+void destagger_row(const T* src, int W, int H, int u, int ofs, float* dst) {
+    OS1::destagger_row(src, W, H, u, ofs, dst,
+                       [](T v) { return static_cast<float>(v); });
+}
+}
+
+void lidar_scan_to_point_cloud(const float* x, const float* y, const float* z,
+                               int first, int n, Points& xyz) {
+    assert(xyz.cols() == 3);
+    assert(first + n <= xyz.rows());
+
+    using MapXf = Eigen::Map<const Eigen::ArrayXf>;
+    xyz.col(0).segment(first, n) = MapXf(x + first, n);
+    xyz.col(1).segment(first, n) = MapXf(y + first, n);
+    xyz.col(2).segment(first, n) = MapXf(z + first, n);
+}
+
+void update_color_key(const VisualizerConfig& config, const Points& xyz,
+                      const CompactLidarScan::Plane<uint16_t>& intensity,
+                      const CompactLidarScan::Plane<uint32_t>& range,
+                      std::vector<float>& color_key, int first, int n) {
+    assert(intensity.size() == xyz.rows());
+    assert(range.size() == xyz.rows());
+    assert(color_key.size() == (size_t)xyz.rows());
+    assert(first + n <= xyz.rows());
+
+    Eigen::Map<Eigen::ArrayXf> key_eigen(color_key.data() + first, n);
+    auto z = xyz.col(2).segment(first, n);
+
+    switch (color_modes[config.color_mode].second) {
+        case COLOR_Z:
+            key_eigen = ((1.5f + z) * 0.1f).abs().sqrt();
+            break;
+        case COLOR_INTENSITY:
+            key_eigen = intensity.segment(first, n).cast<float>();
+            color_intensity(key_eigen, config);
+            break;
+        case COLOR_ZINTENSITY:
+            key_eigen = intensity.segment(first, n).cast<float>();
+            color_intensity(key_eigen, config);
+            key_eigen += ((1.5f + z) * 0.05f).abs().sqrt();
+            break;
+        case COLOR_RANGE:
+            key_eigen = range.segment(first, n).cast<float>();
+            color_range(key_eigen, config);
+            break;
+        default:
+            std::cerr << "Invalid render mode" << std::endl;
+    }
+}
+
+void update_images(const ouster::CompactLidarScan& ls, Image& arr,
+                   const std::vector<int>& px_offset,
+                   const VisualizerConfig& config, int first_row,
+                   int n_rows) {
+    const int W = ls.W, H = ls.H;
+
+    // each channel is stored upside down in its own third of the image
+    for (int u = first_row; u < first_row + n_rows; u++) {
+        float* r = arr.data() + (1 * H - u - 1) * W;
+        float* i = arr.data() + (2 * H - u - 1) * W;
+        float* n = arr.data() + (3 * H - u - 1) * W;
+        destagger_row(ls.range().data(), W, H, u, px_offset[u], r);
+        destagger_row(ls.intensity().data(), W, H, u, px_offset[u], i);
+        destagger_row(ls.noise().data(), W, H, u, px_offset[u], n);
+
+        color_range(Eigen::Map<Eigen::ArrayXf>{r, W}, config);
+        color_intensity(Eigen::Map<Eigen::ArrayXf>{i, W}, config);
+        color_noise(Eigen::Map<Eigen::ArrayXf>{n, W}, config);
+    }
+}
+}
+}
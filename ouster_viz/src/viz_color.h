@@ -0,0 +1,75 @@
+/**
+ * @file
+ * @brief Coloring of the point cloud and images of the visualizer
+ *
+ * Kept apart from the vtk rendering, so the per-frame work of the visualizer
+ * can be benchmarked without a window
+ */
+
+#pragma once
+
+#include <Eigen/Eigen>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ouster/lidar_scan.h"
+
+namespace ouster {
+namespace viz {
+
+using Points = Eigen::Array<float, Eigen::Dynamic, 3, Eigen::RowMajor>;
+using Image =
+    Eigen::Array<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+/**
+ * Specify what quantity to color in the point cloud visualization
+ **/
+enum ColorMode { COLOR_Z, COLOR_INTENSITY, COLOR_ZINTENSITY, COLOR_RANGE };
+
+extern const std::vector<std::pair<std::string, ColorMode>> color_modes;
+
+/**
+ * Visualizer options set through user controls
+ **/
+struct VisualizerConfig {
+    int c_palette;     // cloud color palette
+    int point_size;    // cloud point size
+    int color_mode;    // cloud coloring mode
+    bool cycle_range;  // cycle range palette
+    bool parallel;     // use parallel projection
+
+    int palette;       // image color palette
+    bool image_noise;  // display noise image
+    double intensity_scale;
+    double range_scale;
+    double noise_scale;
+
+    int fraction_3d;  // percent of window displaying cloud
+};
+
+/**
+ * Copies n points starting at first of cartesian coordinates into a point
+ * cloud
+ **/
+void lidar_scan_to_point_cloud(const float* x, const float* y, const float* z,
+                               int first, int n, Points& xyz);
+
+/**
+ * Update scalars used to color n points starting at first
+ **/
+void update_color_key(const VisualizerConfig& config, const Points& xyz,
+                      const CompactLidarScan::Plane<uint16_t>& intensity,
+                      const CompactLidarScan::Plane<uint32_t>& range,
+                      std::vector<float>& color_key, int first, int n);
+
+/**
+ * Inserts n_rows rows of a lidar scan starting at first_row into frame so
+ * that it can be rendered
+ **/
+void update_images(const ouster::CompactLidarScan& ls, Image& arr,
+                   const std::vector<int>& px_offset,
+                   const VisualizerConfig& config, int first_row,
+                   int n_rows);
+}
+}